@@ -0,0 +1,161 @@
+/*
+Execution core benchmark
+
+  EastLangDispatchBench [scale]
+
+Runs small EastLang kernels with the tree-walker alone and the VM (--vm), the VM once with
+plain instructions only and once with superinstructions, then once more with hot callables
+compiled to machine code (jit.hpp), and last the default: tree-walked until things get hot
+(tiers.hpp). Reports the run time, how many VM instructions ran and what one instruction
+costs on average, which is mostly dispatch for the cheap ones.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../src/parsing/parser.hpp"
+#include "../src/optimization/optimizer.hpp"
+#include "../src/optimization/resolver.hpp"
+#include "../src/interpretation/GlobalEnv.hpp"
+#include "../src/interpretation/vm/compiler.hpp"
+#include "../src/interpretation/vm/vm.hpp"
+#include "../src/interpretation/vm/jit.hpp"
+#include "../src/interpretation/vm/tiers.hpp"
+
+/*
+WORKLOADS
+*/
+struct Workload {
+  std::string name;
+  std::string source;
+};
+
+static std::string counting_loop(int scale) {
+  return "i = 0\n"
+    "s = 0\n"
+    "while i < " + std::to_string(300000 * scale) + " { s = s + i * 2 i = i + 1 }\n";
+}
+
+static std::string recursive_calls(int scale) {
+  return "fib = callable(n) { if n < 2 { n } else { fib(n - 1) + fib(n - 2) } }\n"
+    "r = 0\n"
+    "k = 0\n"
+    "while k < " + std::to_string(scale) + " { r = r + fib(22) k = k + 1 }\n";
+}
+
+static std::string module_calls(int scale) {
+  return "const array = @import(\"<array>\")\n"
+    "xs = [1, 2, 3, 4]\n"
+    "i = 0\n"
+    "s = 0\n"
+    "while i < " + std::to_string(100000 * scale) + " { s = s + array.len(xs) + xs[i % 4] i = i + 1 }\n";
+}
+
+static std::string branches(int scale) {
+  return "i = 0\n"
+    "a = 0\n"
+    "b = 0\n"
+    "c = 0\n"
+    "while i < " + std::to_string(200000 * scale) + " {\n"
+    "  m = i % 3\n"
+    "  if m == 0 { a = a + 1 } else_if m == 1 { b = b + 1 } else { c = c + 1 }\n"
+    "  i = i + 1\n"
+    "}\n";
+}
+
+/*
+MEASURING
+*/
+enum class Mode {
+  TreeWalker,
+  Plain,
+  Super,
+  Jit,
+  Tiered,
+};
+
+// a fresh program for every run, callable bodies keep the chunk they were compiled to
+static void run(const std::string& source, Mode mode) {
+  set_vm_enabled(mode != Mode::TreeWalker && mode != Mode::Tiered);
+  set_superinstructions_enabled(mode != Mode::Plain);
+  set_jit_enabled(mode == Mode::Jit || mode == Mode::Tiered);
+  set_tier_thresholds(mode == Mode::TreeWalker ? TierThresholds{ 0, 0, 0 } : TierThresholds());
+
+  Program* program = Parser().parse_ast(source);
+  optimize_program(program);
+  resolve_program(program);
+  run_program(program, makeGlobalEnv());
+}
+
+// runs every mode in turn until each took at least ~0.3s in total, keeps the fastest run of each.
+// Taking turns means a noisy moment (or the heap the earlier runs left behind) can't land on
+// just one of the modes
+static std::vector<double> measure(const std::vector<std::function<void()>>& bodies) {
+  std::vector<double> best(bodies.size(), 1e300);
+  std::vector<double> total(bodies.size(), 0);
+  for (int run = 0; run < 20; run++) {
+    bool enough = run >= 3;
+    for (size_t i = 0; i < bodies.size(); i++) {
+      auto start = std::chrono::steady_clock::now();
+      bodies[i]();
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      total[i] += seconds;
+      best[i] = std::min(best[i], seconds);
+      enough = enough && total[i] >= 0.3;
+    }
+    if (enough) break;
+  }
+  return best;
+}
+
+static uint64_t count_instructions(const std::string& source, Mode mode) {
+  set_vm_instruction_counting(true);
+  uint64_t before = vm_instructions_run();
+  run(source, mode);
+  set_vm_instruction_counting(false);
+  return vm_instructions_run() - before;
+}
+
+int main(int argc, char * argv[]) {
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+  if (scale < 1) scale = 1;
+
+  std::vector<Workload> workloads = {
+    { "counting loop", counting_loop(scale) },
+    { "recursive calls", recursive_calls(scale) },
+    { "module calls", module_calls(scale) },
+    { "branches", branches(scale) },
+  };
+
+  std::printf("EastLang execution benchmark, VM dispatch: %s\n\n", vm_dispatch_name());
+  std::printf("%-16s %9s | %9s %12s %9s | %9s %12s %9s | %9s | %9s\n",
+    "workload", "tree ms", "plain ms", "instructions", "ns/instr", "super ms", "instructions", "ns/instr", "jit ms",
+    "tiered ms");
+
+  for (auto& workload : workloads) {
+    uint64_t plainCount = count_instructions(workload.source, Mode::Plain);
+    uint64_t superCount = count_instructions(workload.source, Mode::Super);
+
+    std::vector<double> times = measure({
+      [&]() { run(workload.source, Mode::TreeWalker); },
+      [&]() { run(workload.source, Mode::Plain); },
+      [&]() { run(workload.source, Mode::Super); },
+      [&]() { run(workload.source, Mode::Jit); },
+      [&]() { run(workload.source, Mode::Tiered); },
+    });
+    double tree = times[0], plain = times[1], super = times[2], jit = times[3], tiered = times[4];
+
+    std::printf("%-16s %9.1f | %9.1f %12llu %9.2f | %9.1f %12llu %9.2f | %9.1f | %9.1f\n",
+      workload.name.c_str(), tree * 1e3,
+      plain * 1e3, static_cast<unsigned long long>(plainCount), plain * 1e9 / plainCount,
+      super * 1e3, static_cast<unsigned long long>(superCount), super * 1e9 / superCount,
+      jit * 1e3, tiered * 1e3);
+  }
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+/*
+Front-end throughput benchmark
+
+  EastLangBench [scale]
+
+Generates synthetic EastLang sources and measures the lexer (Lexer::next until EOF)
+and the parser (Parser::parse_ast, which pulls its own tokens, so it includes lexing).
+Reports MB/s, tokens/s, AST nodes/s and heap allocations per KB of source for each phase.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "../src/parsing/lexer.hpp"
+#include "../src/parsing/parser.hpp"
+#include "../src/parsing/scan.hpp"
+
+/*
+ALLOCATION COUNTING
+*/
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+/*
+WORKLOADS
+*/
+struct Workload {
+  std::string name;
+  std::string source;
+};
+
+static std::string deep_expressions(int scale) {
+  std::string src;
+  for (int line = 0; line < 400 * scale; line++) {
+    std::string expr = "x" + std::to_string(line % 7);
+    for (int depth = 0; depth < 40; depth++) {
+      const char* ops[] = { " + ", " * ", " - ", " / ", " % ", " << " };
+      expr = "(" + expr + ops[depth % 6] + std::to_string(depth) + ")";
+    }
+    src += "r" + std::to_string(line) + " = " + expr + " == 1 and (not a" + std::to_string(line) + " < b)\n";
+  }
+  return src;
+}
+
+static std::string long_literals(int scale) {
+  std::string body(4096, 'a');
+  for (size_t i = 0; i < body.size(); i += 61) body[i] = ' ';
+  std::string src;
+  for (int i = 0; i < 200 * scale; i++) {
+    src += "s" + std::to_string(i) + " = \"" + body + "\\n\" + '" + body.substr(0, 512) + "'\n";
+    src += "`" + body + "`\n"; // long comments too
+  }
+  return src;
+}
+
+static std::string many_callables(int scale) {
+  std::string src;
+  for (int i = 0; i < 3000 * scale; i++) {
+    std::string n = std::to_string(i);
+    src += "const fn" + n + " = callable(alpha, beta, gamma) {\n";
+    src += "  local total = alpha * " + n + " + beta\n";
+    src += "  if total > gamma { total = total - gamma } else_if total == 0 { total = 1 } else { total = gamma }\n";
+    src += "  while total > 100 { total = total / 2 }\n";
+    src += "  helper.format(total, [alpha, beta], fn" + n + ")\n";
+    src += "}\n";
+  }
+  return src;
+}
+
+static std::string large_arrays(int scale) {
+  std::string src = "data = [\n";
+  for (int i = 0; i < 200000 * scale; i++) {
+    src += "  [" + std::to_string(i) + ", " + std::to_string(i * 0.5) + ", \"row" + std::to_string(i) + "\"],\n";
+  }
+  src += "  []\n]\n";
+  return src;
+}
+
+/*
+MEASURING
+*/
+static size_t count_nodes(Stmt* node) {
+  size_t count = 1;
+  for_each_child(node, [&](Stmt* child) { count += count_nodes(child); });
+  return count;
+}
+
+struct PhaseResult {
+  double seconds;
+  size_t items;
+  size_t allocs;
+};
+
+// repeats the phase until it ran for at least ~0.3s, keeps the fastest run
+static PhaseResult measure(const std::function<size_t()>& phase) {
+  PhaseResult best = { 1e300, 0, 0 };
+  double total = 0;
+  for (int run = 0; run < 50 && (run < 3 || total < 0.3); run++) {
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    size_t items = phase();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    total += seconds;
+    if (seconds < best.seconds) {
+      best = { seconds, items, allocations - before };
+    }
+  }
+  return best;
+}
+
+int main(int argc, char * argv[]) {
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+  if (scale < 1) scale = 1;
+
+  std::vector<Workload> workloads = {
+    { "deep expressions", deep_expressions(scale) },
+    { "long literals", long_literals(scale) },
+    { "many callables", many_callables(scale) },
+    { "large arrays", large_arrays(scale) },
+  };
+
+  std::printf("EastLang front-end benchmark, scan kernels: %s\n\n", scan_kernel_name());
+  std::printf("%-18s %9s | %9s %12s %10s | %9s %12s %10s\n",
+    "workload", "size KB", "lex MB/s", "tokens/s", "allocs/KB", "parse MB/s", "nodes/s", "allocs/KB");
+
+  for (auto& workload : workloads) {
+    std::string_view source = workload.source;
+    double kb = source.size() / 1024.0;
+    double mb = kb / 1024.0;
+
+    PhaseResult lex = measure([&]() {
+      Lexer lexer(source);
+      size_t tokens = 0;
+      while (lexer.next().type != TokenType::EndOfFile) tokens++;
+      return tokens;
+    });
+
+    Program* program = Parser().parse_ast(source);
+    size_t nodes = count_nodes(program);
+    delete program;
+    PhaseResult parse = measure([&]() {
+      delete Parser().parse_ast(source);
+      return nodes;
+    });
+
+    std::printf("%-18s %9.0f | %9.1f %12.3g %10.2f | %9.1f %12.3g %10.2f\n",
+      workload.name.c_str(), kb,
+      mb / lex.seconds, lex.items / lex.seconds, lex.allocs / kb,
+      mb / parse.seconds, parse.items / parse.seconds, parse.allocs / kb);
+  }
+
+  return 0;
+}
@@ -1,6 +1,23 @@
 #include "Errors.hpp"
 
+static thread_local int captureDepth = 0;
+
+ErrorCapture::ErrorCapture() {
+  captureDepth++;
+}
+
+ErrorCapture::~ErrorCapture() {
+  captureDepth--;
+}
+
+bool errors_captured() {
+  return captureDepth > 0;
+}
+
 [[ noreturn ]] void raise_error(std::string error) {
+  if (captureDepth > 0) {
+    throw EastError(error);
+  }
   std::cerr << "\033[31m" << error << "\033[0m\n";
   std::exit(1);
 }
\ No newline at end of file
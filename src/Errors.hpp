@@ -1,5 +1,23 @@
 #pragma once
 #include <string>
 #include <iostream>
+#include <stdexcept>
 
-[[ noreturn ]] void raise_error(std::string error);
\ No newline at end of file
+[[ noreturn ]] void raise_error(std::string error);
+
+// what raise_error throws instead of exiting while an ErrorCapture is alive on the thread
+class EastError: public std::runtime_error {
+  public:
+    EastError(const std::string& error): std::runtime_error(error) {}
+};
+
+// Background work (like parsing modules ahead of time) can't just kill the process,
+// the error only matters once the main thread actually needs the result
+class ErrorCapture {
+  public:
+    ErrorCapture();
+    ~ErrorCapture();
+};
+
+// true while raise_error throws on this thread instead of exiting
+bool errors_captured();
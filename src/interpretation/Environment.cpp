@@ -1,16 +1,76 @@
 #include <string>
-#include <set>
+#include <unordered_set>
 #include <unordered_map>
 #include "ValueTypes.hpp"
 #include "Environment.hpp"
 #include "../Errors.hpp"
 #include "GlobalEnv.hpp"
 
-Environment::Environment(Environment* pe) {
+Environment::Environment(Environment* pe, const ScopeLayout* scopeLayout) {
   parentEnv = pe;
+  layout = scopeLayout;
+  if (layout != nullptr) {
+    slots.resize(layout->slots.size());
+  }
+}
+
+void Environment::reuse(Environment* pe, const ScopeLayout* scopeLayout) {
+  parentEnv = pe;
+  layout = scopeLayout;
+  slots.assign(layout != nullptr ? layout->slots.size() : 0, VarSlot());
+  values.clear();
+  constants.clear();
+}
+
+void Environment::install(const ScopeLayout* scopeLayout) {
+  if (layout != nullptr || scopeLayout == nullptr) return; // the REPL runs many programs in one scope, the first one keeps it
+
+  layout = scopeLayout;
+  slots.resize(layout->slots.size());
+
+  // whatever was declared by name before (argv, @path, ...) moves into its slot
+  for (size_t i = 0; i < slots.size(); i++) {
+    Symbol varname = layout->slots[i].symbol;
+    auto value = values.find(varname);
+    if (value == values.end()) continue;
+
+    slots[i].value = value->second;
+    slots[i].constant = constants.erase(varname) > 0;
+    values.erase(value);
+  }
+}
+
+VarSlot* Environment::findSlot(Symbol varname) {
+  if (layout == nullptr) return nullptr;
+  uint32_t slot = layout->find(varname);
+  return slot == ScopeLayout::NO_SLOT ? nullptr : &slots[slot];
+}
+
+bool Environment::has(Symbol varname) {
+  VarSlot* slot = findSlot(varname);
+  if (slot != nullptr) return slot->value != nullptr;
+  return values.find(varname) != values.end();
+}
+
+Environment* Environment::ancestor(uint32_t depth) {
+  Environment* env = this;
+  while (depth-- > 0 && env != nullptr) {
+    env = env->parentEnv;
+  }
+  return env;
 }
 
-RuntimeVal* Environment::declareVar(std::string varname, RuntimeVal* value, bool constant) {
+RuntimeVal* Environment::declareVar(Symbol varname, RuntimeVal* value, bool constant) {
+  VarSlot* slot = findSlot(varname);
+  if (slot != nullptr) {
+    if (slot->value != nullptr) {
+      raise_error("Can't declare a value that already exists");
+    }
+    slot->value = value;
+    slot->constant = constant;
+    return value;
+  }
+
   if (values.find(varname) != values.end()) { // value exists
     raise_error("Can't declare a value that already exists");
   }
@@ -21,15 +81,21 @@ RuntimeVal* Environment::declareVar(std::string varname, RuntimeVal* value, bool
   return value;
 };
 
-RuntimeVal* Environment::overrideVar(std::string varname, RuntimeVal* value) {
+RuntimeVal* Environment::overrideVar(Symbol varname, RuntimeVal* value) {
   Environment* env = resolve(varname);
 
-  env->values[varname] = value;
+  VarSlot* slot = env->findSlot(varname);
+  if (slot != nullptr) {
+    slot->value = value;
+    slot->owned = false;
+  } else {
+    env->values[varname] = value;
+  }
 
   return value;
 };
 
-RuntimeVal* Environment::assignVar(std::string varname, RuntimeVal* value, bool local) {
+RuntimeVal* Environment::assignVar(Symbol varname, RuntimeVal* value, bool local) {
   Environment* env;
   if (local) {
     env = this;
@@ -37,21 +103,36 @@ RuntimeVal* Environment::assignVar(std::string varname, RuntimeVal* value, bool
     env = resolve(varname);
   }
 
-  if (env == nullptr || env->values.find(varname) == env->values.end()) { // if undefined
+  if (env == nullptr || !env->has(varname)) { // if undefined
     return this->declareVar(varname, value);
   }
-  if (env->constants.find(varname) != env->constants.end()) { // if defined AND constant
+
+  VarSlot* slot = env->findSlot(varname);
+  bool constant = slot != nullptr ? slot->constant : env->constants.find(varname) != env->constants.end();
+  if (constant) { // if defined AND constant
     raise_error("Attempted assignment on a constant variable");
   }
-  env->values[varname] = value;
+
+  if (slot != nullptr) {
+    slot->value = value;
+    slot->owned = false;
+  } else {
+    env->values[varname] = value;
+  }
 
   return value;
 };
 
-RuntimeVal* Environment::lookupVar(std::string varname) {
+RuntimeVal* Environment::lookupVar(Symbol varname) {
   auto env = this->resolve(varname);
   if (env == nullptr) {
-    raise_error("Variable " + varname + " doesn't exist");
+    raise_error("Variable " + symbol_name(varname) + " doesn't exist");
+  }
+
+  VarSlot* slot = env->findSlot(varname);
+  if (slot != nullptr) {
+    slot->owned = false; // it's out now, the next number needs a NumberVal of its own
+    return slot->value;
   }
 
   auto value = env->values.find(varname);
@@ -59,8 +140,8 @@ RuntimeVal* Environment::lookupVar(std::string varname) {
   return value->second;
 };
 
-Environment* Environment::resolve(std::string varname) {
-  if (values.find(varname) == values.end()) { // no value in this scope
+Environment* Environment::resolve(Symbol varname) {
+  if (!has(varname)) { // no value in this scope
     if (parentEnv != nullptr) {
       return parentEnv->resolve(varname); // look in the parent env
     } else {
@@ -68,4 +149,132 @@ Environment* Environment::resolve(std::string varname) {
     }
   }
   return this; // we found the variable in this scope so we return
-};
\ No newline at end of file
+};
+
+/*
+Resolved access. The ref says how many scopes up and in which slot to look first, an empty slot
+says where to look next. Whenever a scope doesn't have the layout the resolver expected (a program
+run in a scope some other program set up, like in the REPL) it's done the slow way by name.
+*/
+RuntimeVal* Environment::lookupRef(const VarRef& ref, Symbol varname) {
+  return findRef(ref, varname, true);
+}
+
+RuntimeVal* Environment::peekRef(const VarRef& ref, Symbol varname) {
+  return findRef(ref, varname, false);
+}
+
+RuntimeVal* Environment::findRef(const VarRef& ref, Symbol varname, bool giveAway) {
+  Environment* env = this;
+  const VarRef* at = &ref;
+  while (true) {
+    env = env->ancestor(at->depth);
+    if (env == nullptr) return lookupVar(varname);
+    if (at->layout == nullptr) return env->lookupVar(varname); // nothing closer can have it
+    if (env->layout != at->layout) return lookupVar(varname);
+
+    VarSlot& slot = env->slots[at->slot];
+    if (slot.value != nullptr) {
+      if (giveAway) slot.owned = false;
+      return slot.value;
+    }
+    at = &at->layout->slots[at->slot].outer;
+  }
+}
+
+RuntimeVal* Environment::assignRef(const VarRef& ref, Symbol varname, RuntimeVal* value, bool local) {
+  // an assignment always has a slot in its own scope, that's where it declares if nothing is found
+  if (ref.layout == nullptr || ref.depth != 0 || layout != ref.layout) {
+    return assignVar(varname, value, local);
+  }
+  VarSlot* target = &slots[ref.slot];
+
+  if (target->value == nullptr && !local) { // not here (yet), maybe further out
+    Environment* env = this;
+    const VarRef* at = &ref.layout->slots[ref.slot].outer;
+    while (true) {
+      env = env->ancestor(at->depth);
+      if (env == nullptr) return assignVar(varname, value, local);
+      if (at->layout == nullptr) {
+        Environment* owner = env->resolve(varname);
+        if (owner != nullptr) return owner->assignVar(varname, value, true);
+        break;
+      }
+      if (env->layout != at->layout) return assignVar(varname, value, local);
+
+      VarSlot& slot = env->slots[at->slot];
+      if (slot.value != nullptr) {
+        target = &slot;
+        break;
+      }
+      at = &at->layout->slots[at->slot].outer;
+    }
+  }
+
+  if (target->value != nullptr && target->constant) {
+    raise_error("Attempted assignment on a constant variable");
+  }
+  target->value = value;
+  target->owned = false;
+  return value;
+}
+
+/*
+Numbers the optimizer proved a variable holds (AssignmentExpr::unboxed) go into one NumberVal
+the slot owns. It stays owned while only peekRef looks at it, anything that could keep it
+(lookupRef, lookupVar) takes the ownership away and the next number gets a new one.
+Whatever isn't a plain resolved slot is left to assignRef.
+*/
+RuntimeVal* Environment::assignNumber(const VarRef& ref, Symbol varname, double value, bool local) {
+  VarSlot* target = nullptr;
+  if (ref.layout != nullptr && ref.depth == 0 && layout == ref.layout) {
+    target = &slots[ref.slot];
+    Environment* env = this;
+    const VarRef* at = &ref.layout->slots[ref.slot].outer;
+    while (target != nullptr && target->value == nullptr && !local) {
+      env = env->ancestor(at->depth);
+      if (env == nullptr || at->layout == nullptr || env->layout != at->layout) {
+        target = nullptr;
+      } else {
+        target = &env->slots[at->slot];
+        at = &at->layout->slots[at->slot].outer;
+      }
+    }
+  }
+  if (target == nullptr || target->value == nullptr || target->constant) {
+    return assignRef(ref, varname, MK_NUM(value), local);
+  }
+
+  if (target->owned) {
+    static_cast<NumberVal*>(target->value)->value = value;
+  } else {
+    target->value = MK_NUM(value);
+    target->owned = true;
+  }
+  return target->value;
+}
+
+RuntimeVal* Environment::declareRef(const VarRef& ref, Symbol varname, RuntimeVal* value, bool constant) {
+  if (ref.layout == nullptr || ref.depth != 0 || layout != ref.layout) {
+    return declareVar(varname, value, constant);
+  }
+
+  VarSlot& slot = slots[ref.slot];
+  if (slot.value != nullptr) {
+    raise_error("Can't declare a value that already exists");
+  }
+  slot.value = value;
+  slot.constant = constant;
+  return value;
+}
+
+std::vector<Symbol> Environment::names() {
+  std::vector<Symbol> declared;
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (slots[i].value != nullptr) declared.push_back(layout->slots[i].symbol);
+  }
+  for (auto var : values) {
+    declared.push_back(var.first);
+  }
+  return declared;
+}
@@ -1,21 +1,66 @@
 #pragma once
 #include <string>
-#include <set>
+#include <string_view>
+#include <vector>
+#include <unordered_set>
 #include <unordered_map>
 #include "ValueTypes.hpp"
 
+struct VarSlot {
+  RuntimeVal* value = nullptr; // nullptr = not declared (yet)
+  bool constant = false;
+  bool owned = false; // value is a NumberVal made for this slot that nothing else has, assignNumber writes into it
+};
+
+/*
+A scope. Names the resolver knew about live in `slots`, laid out by the scope's ScopeLayout,
+anything else (built-ins, names from the REPL, ...) is kept by name in `values`.
+The by-name methods look at both, the *Ref ones take the resolver's shortcut when it applies.
+*/
 class Environment {
   private:
     Environment* parentEnv;
+    const ScopeLayout* layout = nullptr;
+    std::vector<VarSlot> slots;
+
+    VarSlot* findSlot(Symbol varname);
+    bool has(Symbol varname);
+    Environment* ancestor(uint32_t depth);
+    RuntimeVal* findRef(const VarRef& ref, Symbol varname, bool giveAway);
   public:
     // for build-ins
-    std::set<std::string> constants;
-    std::unordered_map<std::string, RuntimeVal*> values;
-
-    Environment(Environment* pe = nullptr);
-    RuntimeVal* declareVar(std::string varname, RuntimeVal* value, bool constant = false);
-    RuntimeVal* overrideVar(std::string varname, RuntimeVal* value);
-    RuntimeVal* assignVar(std::string varname, RuntimeVal* value, bool local = false);
-    RuntimeVal* lookupVar(std::string varname);
-    Environment* resolve(std::string varname);
-};
\ No newline at end of file
+    std::unordered_set<Symbol> constants;
+    std::unordered_map<Symbol, RuntimeVal*> values;
+
+    Environment(Environment* pe = nullptr, const ScopeLayout* scopeLayout = nullptr);
+    Environment* parent() const { return parentEnv; }
+    // gives a scope made outside the interpreter (global env, module env) the layout of the program running in it
+    void install(const ScopeLayout* scopeLayout);
+    // starts over as a new scope, for a tail call that takes the place of the call that made it
+    void reuse(Environment* pe, const ScopeLayout* scopeLayout);
+
+    RuntimeVal* declareVar(Symbol varname, RuntimeVal* value, bool constant = false);
+    RuntimeVal* overrideVar(Symbol varname, RuntimeVal* value);
+    RuntimeVal* assignVar(Symbol varname, RuntimeVal* value, bool local = false);
+    RuntimeVal* lookupVar(Symbol varname);
+    Environment* resolve(Symbol varname);
+
+    RuntimeVal* lookupRef(const VarRef& ref, Symbol varname);
+    RuntimeVal* assignRef(const VarRef& ref, Symbol varname, RuntimeVal* value, bool local = false);
+    RuntimeVal* declareRef(const VarRef& ref, Symbol varname, RuntimeVal* value, bool constant = false);
+
+    // lookupRef for an operand that's only looked at and never kept (arithmetic, comparisons),
+    // a number the variable owns stays its own
+    RuntimeVal* peekRef(const VarRef& ref, Symbol varname);
+    // assignRef of a number, written into the NumberVal the variable owns instead of a new one
+    // each time. What it gives back is that NumberVal, only for callers that drop it
+    RuntimeVal* assignNumber(const VarRef& ref, Symbol varname, double value, bool local = false);
+
+    // every name declared directly in this scope
+    std::vector<Symbol> names();
+
+    // by-name helpers for setting up the built-ins
+    RuntimeVal* declareVar(std::string_view varname, RuntimeVal* value, bool constant = false) {
+      return declareVar(intern(varname), value, constant);
+    }
+};
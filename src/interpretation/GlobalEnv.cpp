@@ -48,7 +48,7 @@ void print_runtime_val(RuntimeVal* var) {
       FunctionVal* Func = static_cast<FunctionVal*>(var);
       std::cout << "callable(";
       for (auto param : Func->parameters) {
-        std::cout << param << ", ";
+        std::cout << symbol_name(param) << ", ";
       }
       std::cout << ")";
       break;
@@ -202,8 +202,8 @@ NATIVE_FN(dir) {
   ModuleVal* _module = static_cast<ModuleVal*>(args[0]);
 
   std::vector<RuntimeVal*> values;
-  for (auto var : _module->moduleEnv->values) {
-    values.push_back(MK_STRING(var.first));
+  for (Symbol var : _module->moduleEnv->names()) {
+    values.push_back(MK_STRING(symbol_name(var)));
   }
   return MK_ARRAY(values);
 }
@@ -221,16 +221,16 @@ Environment* makeGlobalEnv() {
   env->declareVar("pi", MK_NUM(CONST_PI), true);
   env->declareVar("e", MK_NUM(CONST_E), true);
 
-  env->declareVar("print", MK_NATIVE_FUNC(print), true);
-  env->declareVar("type", MK_NATIVE_FUNC(type), true);
-  env->declareVar("sleep", MK_NATIVE_FUNC(sleep2), true);
-  env->declareVar("input", MK_NATIVE_FUNC(input), true);
+  env->declareVar("print", MK_NATIVE_FUNC(print, Purity::Effectful), true);
+  env->declareVar("type", MK_NATIVE_FUNC(type, Purity::Pure), true);
+  env->declareVar("sleep", MK_NATIVE_FUNC(sleep2, Purity::Effectful), true);
+  env->declareVar("input", MK_NATIVE_FUNC(input, Purity::Effectful), true);
 
-  env->declareVar("dir", MK_NATIVE_FUNC(dir), true);
-  env->declareVar("ord", MK_NATIVE_FUNC(ord), true);
-  env->declareVar("chr", MK_NATIVE_FUNC(chr), true);
+  env->declareVar("dir", MK_NATIVE_FUNC(dir, Purity::Effectful), true);
+  env->declareVar("ord", MK_NATIVE_FUNC(ord, Purity::Pure), true);
+  env->declareVar("chr", MK_NATIVE_FUNC(chr, Purity::Pure), true);
 
-  env->declareVar("DEBUG_list_all", MK_NATIVE_FUNC(DEBUG_list_all), true);
+  env->declareVar("DEBUG_list_all", MK_NATIVE_FUNC(DEBUG_list_all, Purity::Effectful), true);
 
   return env;
 }
\ No newline at end of file
@@ -11,6 +11,7 @@ enum class ValueType {
   Empty,
   Break, // for breaking out of the loops
   Continue, // continue out of the loops
+  TailCall, // a call in tail position on its way back to the call it replaces (call_function)
   Array,
   Number,
   String,
@@ -62,6 +63,17 @@ class ContinueVal: public RuntimeVal{
     ContinueVal(): RuntimeVal(ValueType::Continue) { }
 };
 
+class FunctionVal;
+
+// there's only ever one on its way, the tree-walker keeps reusing the same
+class TailCallVal: public RuntimeVal{
+  public:
+    TailCallVal(): RuntimeVal(ValueType::TailCall) { }
+    FunctionVal* func;
+    std::vector<RuntimeVal*> args;
+    bool reuseScope; // the caller's scope can become the callee's
+};
+
 class ArrayVal: public RuntimeVal{
   public:
     ArrayVal(): RuntimeVal(ValueType::Array) { }
@@ -134,18 +146,28 @@ inline RegexPattern* MK_REGEX(std::string str) {
   return newRegex;
 }
 
+// what a native function does besides returning a value, loop invariant code motion relies on it
+enum class Purity {
+  Mutating, // may change the values it gets (array.append)
+  Effectful, // does something outside the program (print, input) but leaves values alone
+  Pure, // the result only depends on the arguments
+};
+
 class NativeFnVal: public RuntimeVal{
   public:
     NativeFnVal(): RuntimeVal(ValueType::NativeFn) { }
     std::function<RuntimeVal*(std::vector<RuntimeVal*>)> call;
+    Purity purity = Purity::Mutating;
 };
 
 inline NativeFnVal* MK_NATIVE_FUNC(
-  std::function<RuntimeVal*(std::vector<RuntimeVal*>)> call
+  std::function<RuntimeVal*(std::vector<RuntimeVal*>)> call,
+  Purity purity = Purity::Mutating
 ) {
   NativeFnVal* newNativeFunc = new NativeFnVal();
 
   newNativeFunc->call = call;
+  newNativeFunc->purity = purity;
 
   return newNativeFunc;
 }
@@ -153,7 +175,9 @@ inline NativeFnVal* MK_NATIVE_FUNC(
 class FunctionVal: public RuntimeVal{
   public:
     FunctionVal(): RuntimeVal(ValueType::Function) { }
-    std::vector<std::string> parameters;
+    NodeList<Symbol> parameters; // both point into the arena of the program that declared it
     Environment* declarationEnv;
-    std::vector<Stmt*> body;
+    StmtList body;
+    const ScopeLayout* layout = nullptr;
+    FunctionDeclaration* declaration = nullptr;
 };
\ No newline at end of file
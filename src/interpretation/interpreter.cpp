@@ -1,11 +1,128 @@
 #include "interpreter.hpp"
 #include "../Errors.hpp"
 #include "../util.hpp"
-#include "../parsing/parser.hpp" // @import()
+#include "../parsing/loader.hpp" // @import()
 #include "GlobalEnv.hpp"
+#include "vm/vm.hpp"
+#include "vm/runtime.hpp"
+#include "vm/tiers.hpp"
 #include <cmath>
+#include <optional>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include <string_view>
+#include <unordered_map>
 #include "modules/main.hpp"
 
+/*
+Values of InvariantExprs (src/optimization/licm.hpp). Every running loop that has some gets a
+LoopFrame with a slot for each. A kept value is good while `heapEpoch` stays the same, it moves
+whenever something runs that could change what a value was computed from: a callable, a native
+that changes values, an array element assignment, another program (@import, @include).
+*/
+struct InvariantSlot {
+  RuntimeVal* value = nullptr;
+  uint64_t epoch = 0;
+};
+
+class LoopFrame;
+static LoopFrame* loopFrames = nullptr; // innermost first
+uint64_t heapEpoch = 1;
+uint64_t uncachedCalls = 0;
+
+class LoopFrame {
+  public:
+    const WhileStatement* loop;
+    std::vector<InvariantSlot> slots;
+    LoopFrame* outer;
+
+    LoopFrame(const WhileStatement* whileExpr): loop(whileExpr), slots(whileExpr->invariants), outer(loopFrames) {
+      loopFrames = this;
+    }
+    ~LoopFrame() {
+      loopFrames = outer;
+    }
+};
+
+/*
+Operands that are only looked at (arithmetic, comparisons, indexes, not) read their variable
+with peekRef, so a number the variable owns stays its own (Environment::assignNumber). Whatever
+runs between the read and the use could write into that NumberVal, so a left operand only
+peeks when the right one can't run any code.
+*/
+static bool quiet(Expr* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::Identifier:
+      return true;
+    case NodeType::BinaryExpr:
+      return quiet(static_cast<BinaryExpr*>(node)->left) && quiet(static_cast<BinaryExpr*>(node)->right);
+    case NodeType::BitShiftExpr:
+      return quiet(static_cast<BitShiftExpr*>(node)->left) && quiet(static_cast<BitShiftExpr*>(node)->right);
+    default:
+      return false;
+  }
+}
+
+static RuntimeVal* eval_operand(Expr* node, Environment* env) {
+  if (node->kind == NodeType::Identifier) {
+    Identifier* iden = static_cast<Identifier*>(node);
+    return env->peekRef(iden->ref, iden->symbol);
+  }
+  return evaluate(node, env);
+}
+
+static RuntimeVal* eval_left(Expr* left, Expr* right, Environment* env) {
+  return quiet(right) ? eval_operand(left, env) : evaluate(left, env);
+}
+
+// the value of an unboxed assignment (src/optimization/types.hpp) without a NumberVal for each
+// step, false when something isn't a number after all and it has to be evaluated the usual way
+static bool eval_number(Expr* node, Environment* env, double& out) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+      out = static_cast<NumberLiteral*>(node)->value;
+      return true;
+    case NodeType::Identifier: {
+      RuntimeVal* value = eval_operand(node, env);
+      if (value->type != ValueType::Number) return false;
+      out = static_cast<NumberVal*>(value)->value;
+      return true;
+    }
+    case NodeType::InvariantExpr: {
+      RuntimeVal* value = eval_invariant_expr(static_cast<InvariantExpr*>(node), env);
+      if (value->type != ValueType::Number) return false;
+      out = static_cast<NumberVal*>(value)->value;
+      return true;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      double left, right;
+      if (!eval_number(binary->left, env, left) || !eval_number(binary->right, env, right)) return false;
+      switch (binary->expr_operator) {
+        case OperatorType::add: out = left + right; return true;
+        case OperatorType::substract: out = left - right; return true;
+        case OperatorType::multiply: out = left * right; return true;
+        case OperatorType::divide: out = left / right; return true;
+        case OperatorType::modulo: out = std::fmod(left, right); return true;
+      }
+      return false;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      double left, right;
+      if (!eval_number(shift->left, env, left) || !eval_number(shift->right, env, right)) return false;
+      out = shift->shiftRight ? (int)left >> (int)right : (int)left << (int)right;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
 
 RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
   switch (astNode->kind) {
@@ -19,7 +136,14 @@ RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
       return eval_binary_expr(static_cast<BinaryExpr*>(astNode), env);
     }
     case NodeType::NumberLiteral: {
-      return MK_NUM(static_cast<NumberLiteral*>(astNode)->value);
+      NumberLiteral* numLit = static_cast<NumberLiteral*>(astNode);
+      if (numLit->cached == nullptr) numLit->cached = MK_NUM(numLit->value);
+      return numLit->cached;
+    }
+    case NodeType::BooleanLiteral: {
+      BooleanLiteral* boolLit = static_cast<BooleanLiteral*>(astNode);
+      if (boolLit->cached == nullptr) boolLit->cached = MK_BOOL(boolLit->value);
+      return boolLit->cached;
     }
     case NodeType::ArrayLiteral: {
       ArrayLiteral* arrayExpr = static_cast<ArrayLiteral*>(astNode);
@@ -32,10 +156,13 @@ RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
       return array;
     }
     case NodeType::StringLiteral: {
-      return MK_STRING(static_cast<StringLiteral*>(astNode)->value);
+      StringLiteral* strLit = static_cast<StringLiteral*>(astNode);
+      if (strLit->cached == nullptr) strLit->cached = MK_STRING(std::string(strLit->value));
+      return strLit->cached;
     }
     case NodeType::Identifier: {
-      return env->lookupVar(static_cast<Identifier*>(astNode)->value);
+      Identifier* iden = static_cast<Identifier*>(astNode);
+      return env->lookupRef(iden->ref, iden->symbol);
     }
     case NodeType::CallExpr: {
       return eval_call_expr(static_cast<CallExpr*>(astNode), env);
@@ -46,6 +173,12 @@ RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
     case NodeType::WhileStatement: {
       return eval_while_expr(static_cast<WhileStatement*>(astNode), env);
     }
+    case NodeType::ForStatement: {
+      return eval_for_expr(static_cast<ForStatement*>(astNode), env);
+    }
+    case NodeType::BlockExpr: {
+      return eval_block_expr(static_cast<BlockExpr*>(astNode), env);
+    }
     case NodeType::FunctionDeclaration: {
       FunctionDeclaration* funcDec = static_cast<FunctionDeclaration*>(astNode);
 
@@ -54,17 +187,19 @@ RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
       func->declarationEnv = env;
       func->parameters = funcDec->parameters;
       func->body = funcDec->body;
+      func->layout = funcDec->layout;
+      func->declaration = funcDec;
 
       return func;
     }
     case NodeType::VariableDeclaration: {
       VariableDeclaration* varDec = static_cast<VariableDeclaration*>(astNode);
-      return env->declareVar(varDec->identifier, evaluate(varDec->value, env), varDec->constant);
+      return env->declareRef(varDec->ref, varDec->identifier, evaluate(varDec->value, env), varDec->constant);
     }
     case NodeType::NegateExpr: {
       NegateExpr* negExpr = static_cast<NegateExpr*>(astNode);
 
-      RuntimeVal* ret = evaluate(negExpr->expr, env);
+      RuntimeVal* ret = eval_operand(negExpr->expr, env);
 
       if (ret->type == ValueType::Boolean) {
         BooleanVal* boolVal = static_cast<BooleanVal*>(ret);
@@ -80,70 +215,22 @@ RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
       return MK_BOOL(false);
     }
     case NodeType::ComparisonExpr: {
-      ComparisonExpr* compExpr = static_cast<ComparisonExpr*>(astNode);
-
-      auto* left = evaluate(compExpr->left, env);
-      auto* right = evaluate(compExpr->right, env);
-      auto op = compExpr->op;
-
-      return eval_comparison_expr(left, right, op);
+      return eval_comparison_node(static_cast<ComparisonExpr*>(astNode), env);
     }
     case NodeType::LogicalExpr: {
-      LogicalExpr* logExpr = static_cast<LogicalExpr*>(astNode);
-
-      auto* left = evaluate(logExpr->left, env);
-      auto* right = evaluate(logExpr->right, env);
-      auto op = logExpr->op;
-
-      return eval_logical_expr(left, right, op);
+      return eval_logical_node(static_cast<LogicalExpr*>(astNode), env);
     }
     case NodeType::SubscriptExpr: {
       SubscriptExpr* subExpr = static_cast<SubscriptExpr*>(astNode);
 
       RuntimeVal* left = evaluate(subExpr->left, env);
 
-      RuntimeVal* index = evaluate(subExpr->value, env);
-
-      switch (left->type) {
-        case ValueType::Array: {
-          ArrayVal* arrayExpr = static_cast<ArrayVal*>(left);
+      RuntimeVal* index = eval_operand(subExpr->value, env);
 
-          if (index->type != ValueType::Number) raise_error("array index must be a number");
-
-          int arrayIndex = (int)(static_cast<NumberVal*>(index)->value);
-
-          return arrayExpr->elements[arrayIndex];
-        }
-        case ValueType::String: {
-          StringVal* stringExpr = static_cast<StringVal*>(left);
-
-          if (index->type != ValueType::Number) raise_error("string index must be a number");
-
-          int stringIndex = (int)(static_cast<NumberVal*>(index)->value);
-
-          return MK_STRING(std::string(1, stringExpr->value.at(stringIndex)));
-        }
-        default:
-          raise_error("can't substring this type");
-      }
+      return subscript(left, index); // the VM's, so both check indexes the same way
     }
     case NodeType::BitShiftExpr: {
-      BitShiftExpr* bitShift = static_cast<BitShiftExpr*>(astNode);
-
-      RuntimeVal* left = evaluate(bitShift->left, env);
-      RuntimeVal* right = evaluate(bitShift->right, env);
-
-      if (left->type != ValueType::Number || left->type != ValueType::Number)
-        raise_error("can't use bitshift with non-number values");
-
-      auto* leftCast = static_cast<NumberVal*>(left);
-      auto* rightCast = static_cast<NumberVal*>(right);
-
-      if (bitShift->shiftRight) {
-        return MK_NUM((int)leftCast->value >> (int)rightCast->value);
-      } else {
-        return MK_NUM((int)leftCast->value << (int)rightCast->value);
-      }
+      return eval_bitshift_expr(static_cast<BitShiftExpr*>(astNode), env);
     }
     case NodeType::SpecialExpr: {
       return eval_special_expr(static_cast<SpecialExpr*>(astNode), env);
@@ -151,6 +238,12 @@ RuntimeVal* evaluate(Stmt* astNode, Environment* env) {
     case NodeType::MemberExpr: {
       return eval_member_expr(static_cast<MemberExpr*>(astNode), env);
     }
+    case NodeType::InvariantExpr: {
+      return eval_invariant_expr(static_cast<InvariantExpr*>(astNode), env);
+    }
+    case NodeType::MatchExpr: {
+      return eval_match_expr(static_cast<MatchExpr*>(astNode), env);
+    }
     default:
       print_node_type(astNode->kind);
       raise_error("invalid Node Type");
@@ -179,7 +272,7 @@ ModuleName strToModuleName(std::string name) {
 }
 
 RuntimeVal* eval_special_expr(SpecialExpr* specialExpr, Environment* env) {
-  if (specialExpr->identifier == "import") {
+  if (specialExpr->identifier == SYM_IMPORT) {
     if (!specialExpr->isFunction) { raise_error("Special expression 'import' needs to be a function"); }
 
     if (specialExpr->args.size() == 0) { raise_error("Expected at least one argument to @import"); }
@@ -201,18 +294,17 @@ RuntimeVal* eval_special_expr(SpecialExpr* specialExpr, Environment* env) {
       argv.push_back(evaluate(specialExpr->args[argc], env));
     }
 
-    moduleVal->moduleEnv->declareVar("argv", MK_ARRAY(argv), true);
-    moduleVal->moduleEnv->declareVar("@name", MK_STRING("module"));
+    moduleVal->moduleEnv->declareVar(SYM_ARGV, MK_ARRAY(argv), true);
+    moduleVal->moduleEnv->declareVar(SYM_AT_NAME, MK_STRING("module"));
 
-    std::string newModulePath = static_cast<StringVal*>(env->lookupVar("@path"))->value + "/" + moduleName;
-    moduleVal->moduleEnv->declareVar("@path", MK_STRING(path_of_file(newModulePath)), true);
-    std::string sourceCode = read_file((newModulePath).c_str());
+    std::string newModulePath = static_cast<StringVal*>(env->lookupVar(SYM_AT_PATH))->value + "/" + moduleName;
+    moduleVal->moduleEnv->declareVar(SYM_AT_PATH, MK_STRING(path_of_file(newModulePath)), true);
 
-    evaluate(Parser().parse_ast(sourceCode), moduleVal->moduleEnv);
+    run_program(load_module(newModulePath, path_of_file(newModulePath)), moduleVal->moduleEnv);
 
     return moduleVal;
 
-  } else if (specialExpr->identifier == "include") {
+  } else if (specialExpr->identifier == SYM_INCLUDE) {
     if (!specialExpr->isFunction) { raise_error("Special expression 'import' needs to be a function"); }
 
     if (specialExpr->args.size() == 0) { raise_error("Expected at least one argument to @import"); }
@@ -229,17 +321,17 @@ RuntimeVal* eval_special_expr(SpecialExpr* specialExpr, Environment* env) {
     ModuleVal* moduleVal = new ModuleVal();
     moduleVal->moduleEnv = new Environment(env);
     
-    moduleVal->moduleEnv->declareVar("@name", MK_STRING("inserted"));
+    moduleVal->moduleEnv->declareVar(SYM_AT_NAME, MK_STRING("inserted"));
 
-    std::string sourceCode = read_file((static_cast<StringVal*>(env->lookupVar("@path"))->value + "/" + moduleName).c_str());
+    std::string currentPath = static_cast<StringVal*>(env->lookupVar(SYM_AT_PATH))->value;
 
-    evaluate(Parser().parse_ast(sourceCode), moduleVal->moduleEnv);
+    run_program(load_module(currentPath + "/" + moduleName, currentPath), moduleVal->moduleEnv);
 
     return moduleVal;
-  } else if (specialExpr->identifier == "name") {
-    return env->lookupVar("@name");
-  } else if (specialExpr->identifier == "path") {
-    return env->lookupVar("@path");
+  } else if (specialExpr->identifier == SYM_NAME) {
+    return env->lookupVar(SYM_AT_NAME);
+  } else if (specialExpr->identifier == SYM_PATH) {
+    return env->lookupVar(SYM_AT_PATH);
   } else {
     raise_error("Invalid special Expr identifier");
   }
@@ -364,42 +456,81 @@ RuntimeVal* eval_logical_expr(RuntimeVal* left, RuntimeVal* right, LogicalOperat
   }
 }
 
+// one is enough, call_function takes it as soon as it comes back
+static TailCallVal tailCall;
+
+/*
+The tree-walker recurses on the native stack. Calls stop with an error while a quarter of it
+is still left instead of crashing once it's gone, going deeper takes the VM (vm.hpp).
+*/
+static size_t native_stack_size() {
+#ifndef _WIN32
+  rlimit limit;
+  if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) return limit.rlim_cur;
+  return 8 << 20;
+#else
+  return 1 << 20;
+#endif
+}
+
+void check_native_stack() {
+  static uintptr_t limit = 0;
+  char here;
+  uintptr_t at = reinterpret_cast<uintptr_t>(&here);
+  if (limit == 0) limit = at - native_stack_size() / 4 * 3;
+  if (at < limit) raise_error("Stack overflow: recursion too deep for the native stack");
+}
+
+RuntimeVal* call_function(FunctionVal* func, Environment* scope) {
+  check_native_stack();
+  StackCharge charge(scope_bytes(func)); // tail calls reuse it, they don't go deeper
+  for (;;) {
+    if (RuntimeVal* result = tiered_call(func, scope)) return result;
+
+    RuntimeVal* last_returned = new EmptyVal();
+    for (auto stmt : func->body) {
+      last_returned = evaluate(stmt, scope);
+    }
+    if (last_returned->type != ValueType::TailCall) return last_returned;
+
+    // the tail call takes this one's place instead of going a level deeper
+    func = tailCall.func;
+    scope = call_scope(func, tailCall.args.data(), tailCall.args.size(), tailCall.reuseScope ? scope : nullptr);
+  }
+}
+
 RuntimeVal* eval_call_expr(CallExpr* callexpr, Environment* env) {
   RuntimeVal* caller = evaluate(callexpr->caller, env);
 
   if (caller->type == ValueType::NativeFn) {
     NativeFnVal* nativefn = static_cast<NativeFnVal*>(caller);
-    return nativefn->call(eval_args(callexpr->args, env));
+    std::vector<RuntimeVal*> args = eval_args(callexpr->args, env);
+    if (nativefn->purity != Purity::Pure) uncachedCalls++;
+    if (nativefn->purity == Purity::Mutating) heapEpoch++;
+    return nativefn->call(args);
   }
   if (caller->type == ValueType::Function) {
     FunctionVal* func = static_cast<FunctionVal*>(caller);
+    uncachedCalls++;
+    heapEpoch++;
 
-    Environment* scope = new Environment(func->declarationEnv);
     std::vector<RuntimeVal*> args = eval_args(callexpr->args, env);
-
-    for (int i = 0; i < func->parameters.size(); i++) {
-      scope->declareVar(func->parameters[i], args[i], false);
+    if (callexpr->tail) {
+      // made by the call_function this body runs in, once the body is out of the way
+      tailCall.func = func;
+      tailCall.args = std::move(args);
+      tailCall.reuseScope = callexpr->reuseScope;
+      return &tailCall;
     }
-
-    RuntimeVal* last_returned = new EmptyVal();
-    for (auto stmt : func->body) {
-      last_returned = evaluate(stmt, scope);
-    }
-    return last_returned;
+    return call_function(func, call_scope(func, args.data(), args.size()));
   }
   raise_error("Cannot call a non-callable value");
 }
 
 RuntimeVal* eval_if_expr(IfStatement* ifExpr, Environment* env) {
 
-  Environment* scope = new Environment(env);
-  RuntimeVal* checkRet = evaluate(ifExpr->check, env);
-
-  if (checkRet->type != ValueType::Boolean) {
-    raise_error("if checks only support boolean values");
-  }
-  bool passed = static_cast<BooleanVal*>(checkRet)->value;
-  if (passed) {
+  Environment* scope = new Environment(env, ifExpr->layout);
+  if (eval_condition(ifExpr->check, env)) {
     RuntimeVal* last_returned = new EmptyVal();
     for (auto stmt : ifExpr->body) {
       last_returned = evaluate(stmt, scope);
@@ -408,13 +539,10 @@ RuntimeVal* eval_if_expr(IfStatement* ifExpr, Environment* env) {
   }
 
   // else if's
-  for (auto check_body_pair : ifExpr->else_if_chain) {
-    RuntimeVal* elseIfCheckRet = evaluate(check_body_pair.first, env);
-
-    bool elseIfpassed = static_cast<BooleanVal*>(elseIfCheckRet)->value;
-    if (elseIfpassed) {
+  for (const ElseIfBranch& branch : ifExpr->else_if_chain) {
+    if (eval_condition(branch.check, env)) {
       RuntimeVal* elseIfLast_returned = new EmptyVal();
-      for (auto stmt : check_body_pair.second) {
+      for (auto stmt : branch.body) {
         elseIfLast_returned = evaluate(stmt, scope);
       }
       return elseIfLast_returned;
@@ -429,15 +557,172 @@ RuntimeVal* eval_if_expr(IfStatement* ifExpr, Environment* env) {
   return last_returned;
 }
 
-RuntimeVal* eval_while_expr(WhileStatement* whileExpr, Environment* env) {
+RuntimeVal* eval_block_expr(BlockExpr* block, Environment* env) {
+  Environment* scope = new Environment(env, block->layout);
+
+  RuntimeVal* last_returned = new EmptyVal();
+  for (auto stmt : block->body) {
+    last_returned = evaluate(stmt, scope);
+  }
+  return last_returned;
+}
+
+/*
+Decision tree of a match: the type of the value picks the table, the table picks the case.
+Dense whole numbers index a jump table, other numbers and strings go through a hash map, arrays
+are bucketed by length and only the patterns of that length are tried. Earlier cases win,
+so every table keeps the first case a value appears in.
+*/
+struct MatchTable {
+  static constexpr int32_t NO_CASE = -1;
+
+  double jumpBase = 0;
+  std::vector<int32_t> jump; // case for jumpBase + i
+  std::unordered_map<double, int32_t> numbers; // what's not in the jump table
+  std::unordered_map<std::string_view, int32_t> strings;
+  std::unordered_map<size_t, std::vector<std::pair<int32_t, const MatchPattern*>>> arrays; // in case order
+};
+
+static bool is_whole(double number) {
+  return number == std::floor(number) && std::abs(number) < 1e9;
+}
+
+static MatchTable* build_match_table(MatchExpr* match) {
+  MatchTable* table = new MatchTable();
+
+  std::vector<std::pair<double, int32_t>> whole;
+  double low = 0;
+  double high = 0;
+  for (size_t i = 0; i < match->cases.size(); i++) {
+    int32_t index = static_cast<int32_t>(i);
+    for (const MatchPattern& pattern : match->cases[i].patterns) {
+      switch (pattern.kind) {
+        case PatternKind::Number:
+          if (is_whole(pattern.number)) {
+            if (whole.empty() || pattern.number < low) low = pattern.number;
+            if (whole.empty() || pattern.number > high) high = pattern.number;
+            whole.push_back({ pattern.number, index });
+          } else {
+            table->numbers.emplace(pattern.number, index);
+          }
+          break;
+        case PatternKind::String:
+          table->strings.emplace(pattern.string, index);
+          break;
+        case PatternKind::Array:
+          table->arrays[pattern.elements.size()].push_back({ index, &pattern });
+          break;
+        case PatternKind::Bind:
+          break;
+      }
+    }
+  }
+
+  // a jump table only pays off when most of its entries are cases
+  size_t span = whole.empty() ? 0 : static_cast<size_t>(high - low) + 1;
+  if (!whole.empty() && span <= whole.size() * 4 + 16) {
+    table->jumpBase = low;
+    table->jump.assign(span, MatchTable::NO_CASE);
+    for (auto [number, index] : whole) {
+      int32_t& slot = table->jump[static_cast<size_t>(number - low)];
+      if (slot == MatchTable::NO_CASE) slot = index;
+    }
+  } else {
+    for (auto [number, index] : whole) table->numbers.emplace(number, index);
+  }
+
+  return table;
+}
+
+static bool match_pattern(const MatchPattern& pattern, RuntimeVal* value, std::vector<std::pair<Symbol, RuntimeVal*>>& bindings) {
+  switch (pattern.kind) {
+    case PatternKind::Number:
+      return value->type == ValueType::Number && static_cast<NumberVal*>(value)->value == pattern.number;
+    case PatternKind::String:
+      return value->type == ValueType::String && static_cast<StringVal*>(value)->value == pattern.string;
+    case PatternKind::Bind:
+      bindings.push_back({ pattern.binding, value });
+      return true;
+    case PatternKind::Array: {
+      if (value->type != ValueType::Array) return false;
+      ArrayVal* array = static_cast<ArrayVal*>(value);
+      if (array->elements.size() != pattern.elements.size()) return false;
+      for (size_t i = 0; i < pattern.elements.size(); i++) {
+        if (!match_pattern(pattern.elements[i], array->elements[i], bindings)) return false;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+static int32_t find_match_case(MatchTable* table, RuntimeVal* value, std::vector<std::pair<Symbol, RuntimeVal*>>& bindings) {
+  switch (value->type) {
+    case ValueType::Number: {
+      double number = static_cast<NumberVal*>(value)->value;
+      double offset = number - table->jumpBase;
+      if (!table->jump.empty() && is_whole(number) && offset >= 0 && offset < table->jump.size()) {
+        return table->jump[static_cast<size_t>(offset)];
+      }
+      auto found = table->numbers.find(number);
+      return found == table->numbers.end() ? MatchTable::NO_CASE : found->second;
+    }
+    case ValueType::String: {
+      auto found = table->strings.find(static_cast<StringVal*>(value)->value);
+      return found == table->strings.end() ? MatchTable::NO_CASE : found->second;
+    }
+    case ValueType::Array: {
+      auto bucket = table->arrays.find(static_cast<ArrayVal*>(value)->elements.size());
+      if (bucket == table->arrays.end()) return MatchTable::NO_CASE;
+      for (auto [index, pattern] : bucket->second) {
+        if (match_pattern(*pattern, value, bindings)) return index;
+        bindings.clear();
+      }
+      return MatchTable::NO_CASE;
+    }
+    default:
+      return MatchTable::NO_CASE;
+  }
+}
+
+Environment* match_scope(MatchExpr* match, RuntimeVal* value, Environment* env, size_t& index) {
+  if (match->table == nullptr) match->table = build_match_table(match);
 
-  Environment* scope = new Environment(env);
-  RuntimeVal* checkRet = evaluate(whileExpr->check, env);
+  std::vector<std::pair<Symbol, RuntimeVal*>> bindings;
+  int32_t found = find_match_case(match->table, value, bindings);
+  if (found == MatchTable::NO_CASE) {
+    index = match->cases.size();
+    return new Environment(env, match->else_layout);
+  }
 
-  if (checkRet->type != ValueType::Boolean) {
-    raise_error("if checks only support boolean values");
+  index = static_cast<size_t>(found);
+  Environment* scope = new Environment(env, match->cases[index].layout);
+  for (auto [name, bound] : bindings) {
+    scope->declareVar(name, bound);
   }
-  bool passed = static_cast<BooleanVal*>(checkRet)->value;
+  return scope;
+}
+
+RuntimeVal* eval_match_expr(MatchExpr* match, Environment* env) {
+  RuntimeVal* value = evaluate(match->value, env);
+  size_t index;
+  Environment* scope = match_scope(match, value, env, index);
+  StmtList body = index < match->cases.size() ? match->cases[index].body : match->else_body;
+
+  RuntimeVal* last_returned = new EmptyVal();
+  for (auto stmt : body) {
+    last_returned = evaluate(stmt, scope);
+  }
+  return last_returned;
+}
+
+RuntimeVal* eval_while_expr(WhileStatement* whileExpr, Environment* env) {
+
+  Environment* scope = new Environment(env, whileExpr->layout);
+  std::optional<LoopFrame> frame;
+  if (whileExpr->invariants > 0) frame.emplace(whileExpr);
+
+  bool passed = eval_condition(whileExpr->check, env);
   RuntimeVal* last_returned = new EmptyVal();
   bool break_flag = false;
   while (passed) {
@@ -448,12 +733,71 @@ RuntimeVal* eval_while_expr(WhileStatement* whileExpr, Environment* env) {
       last_returned = returned;
     }
     if (break_flag) {break;}
-    passed = static_cast<BooleanVal*>(evaluate(whileExpr->check, env))->value;
+    if (RuntimeVal* rest = tiered_loop(whileExpr, scope, last_returned)) return rest;
+    passed = eval_condition(whileExpr->check, env);
   }
   return last_returned;
 }
 
-std::vector<RuntimeVal*> eval_args(std::vector<Expr*> args, Environment* env) {
+Range make_range(RuntimeVal* start, RuntimeVal* end, RuntimeVal* step) {
+  Range range;
+  for (RuntimeVal* bound : { start, end, step }) {
+    if (bound != nullptr && bound->type != ValueType::Number) raise_error("range only takes numbers");
+  }
+  if (start != nullptr) range.start = static_cast<NumberVal*>(start)->value;
+  range.end = static_cast<NumberVal*>(end)->value;
+  if (step != nullptr) range.step = static_cast<NumberVal*>(step)->value;
+  if (range.step == 0) raise_error("range can't count with a step of 0");
+  return range;
+}
+
+ArrayVal* for_array(RuntimeVal* value) {
+  if (value->type != ValueType::Array) raise_error("for only goes over arrays and range()");
+  return static_cast<ArrayVal*>(value);
+}
+
+// one iteration of a loop body, false when it hit a break
+static bool run_iteration(StmtList body, Environment* scope, RuntimeVal*& last_returned) {
+  for (auto stmt : body) {
+    RuntimeVal* returned = evaluate(stmt, scope);
+    if (returned->type == ValueType::Break) return false;
+    if (returned->type == ValueType::Continue) return true;
+    last_returned = returned;
+  }
+  return true;
+}
+
+/*
+A range counts in a double of its own and writes each value into the NumberVal the variable
+owns (Environment::assignNumber), so assigning the variable in the body doesn't change the
+count. An array is gone over by index, its length is looked at again before every iteration.
+Like a while, all the iterations run in the same scope.
+*/
+RuntimeVal* eval_for_expr(ForStatement* forStmt, Environment* env) {
+  Environment* scope = new Environment(env, forStmt->layout);
+  RuntimeVal* last_returned = new EmptyVal();
+
+  if (forStmt->iterable != nullptr) {
+    ArrayVal* array = for_array(evaluate(forStmt->iterable, env));
+    for (size_t i = 0; i < array->elements.size(); i++) {
+      scope->assignRef(forStmt->ref, forStmt->identifier, array->elements[i], true);
+      if (!run_iteration(forStmt->body, scope, last_returned)) break;
+    }
+    return last_returned;
+  }
+
+  RuntimeVal* start = forStmt->start != nullptr ? evaluate(forStmt->start, env) : nullptr;
+  RuntimeVal* end = evaluate(forStmt->end, env);
+  RuntimeVal* step = forStmt->step != nullptr ? evaluate(forStmt->step, env) : nullptr;
+  Range range = make_range(start, end, step);
+  for (double i = range.start; range.has(i); i += range.step) {
+    scope->assignNumber(forStmt->ref, forStmt->identifier, i, true);
+    if (!run_iteration(forStmt->body, scope, last_returned)) break;
+  }
+  return last_returned;
+}
+
+std::vector<RuntimeVal*> eval_args(ExprList args, Environment* env) {
   std::vector<RuntimeVal*> ret;
   for (auto arg : args) {
     ret.push_back(evaluate(arg, env));
@@ -461,8 +805,31 @@ std::vector<RuntimeVal*> eval_args(std::vector<Expr*> args, Environment* env) {
   return ret;
 }
 
+// the first time an iteration needs the value it's computed, later ones reuse it if they can
+RuntimeVal* eval_invariant_expr(InvariantExpr* invariant, Environment* env) {
+  LoopFrame* frame = loopFrames;
+  while (frame != nullptr && frame->loop != invariant->loop) frame = frame->outer;
+  if (frame == nullptr) return evaluate(invariant->expr, env);
+
+  InvariantSlot& slot = frame->slots[invariant->slot];
+  if (slot.value != nullptr && slot.epoch == heapEpoch) return slot.value;
+
+  uint64_t epoch = heapEpoch;
+  uint64_t calls = uncachedCalls;
+  RuntimeVal* value = evaluate(invariant->expr, env);
+
+  // arrays can be changed through the value itself, every iteration needs its own
+  if (heapEpoch == epoch && uncachedCalls == calls && value->type != ValueType::Array) {
+    slot.value = value;
+    slot.epoch = epoch;
+  }
+  return value;
+}
+
 RuntimeVal* eval_program(Program* program, Environment* env) {
   RuntimeVal* lastEvaluated = new EmptyVal();
+  heapEpoch++;
+  env->install(program->layout);
 
 	for (auto stmt : program->body) {
 		lastEvaluated = evaluate(stmt, env);
@@ -474,8 +841,13 @@ RuntimeVal* eval_program(Program* program, Environment* env) {
 RuntimeVal* eval_assignment(AssignmentExpr* assign, Environment* env) {
   Expr* name = assign->identifier;
   if (name->kind == NodeType::Identifier) {
+    Identifier* iden = static_cast<Identifier*>(name);
+    double number;
+    if (assign->unboxed && eval_number(assign->value, env, number)) {
+      return env->assignNumber(iden->ref, iden->symbol, number, assign->local);
+    }
     RuntimeVal* val = evaluate(assign->value, env);
-    return env->assignVar(static_cast<Identifier*>(name)->value, val, assign->local);
+    return env->assignRef(iden->ref, iden->symbol, val, assign->local);
 
   } else if (name->kind == NodeType::SubscriptExpr) {
     SubscriptExpr* subs = static_cast<SubscriptExpr*>(name);
@@ -484,21 +856,15 @@ RuntimeVal* eval_assignment(AssignmentExpr* assign, Environment* env) {
     if (left->type != ValueType::Array)
       raise_error("cannot subscript assing a non-array");
 
-    RuntimeVal* num = evaluate(subs->value, env);
+    // the value could write into a peeked index before it's used
+    RuntimeVal* num = quiet(assign->value) ? eval_operand(subs->value, env) : evaluate(subs->value, env);
     if (num->type != ValueType::Number)
       raise_error("cannot subscript using a non-number");
 
     auto value = evaluate(assign->value, env);
 
-    ArrayVal* leftArray = static_cast<ArrayVal*>(left);
-    int index = (int)(static_cast<NumberVal*>(num)->value);
-
-    if (leftArray->elements.size() < index)
-      raise_error("array index out of range");
-
-    leftArray->elements[index] = value;
     if (subs->left->kind == NodeType::Identifier) {
-      env->overrideVar(static_cast<Identifier*>(subs->left)->value, leftArray);
+      store_subscript(env, value, left, num, static_cast<Identifier*>(subs->left)->symbol);
       return value;
     }
 
@@ -532,15 +898,13 @@ NumberVal* eval_binary_math(NumberVal* a, NumberVal* b, OperatorType op) {
   return result;
 }
 
-RuntimeVal* eval_binary_expr(BinaryExpr* binary, Environment* env) {
-  RuntimeVal* left = evaluate(binary->left, env);
-  RuntimeVal* right = evaluate(binary->right, env);
-
+// what eval_binary_expr gives for any two values
+static RuntimeVal* binary_values(RuntimeVal* left, RuntimeVal* right, OperatorType op) {
   if (left->type == ValueType::Number && right->type == ValueType::Number) {
     return eval_binary_math(
       static_cast<NumberVal*>(left),
       static_cast<NumberVal*>(right),
-      binary->expr_operator
+      op
     );
   }
   if (left->type == ValueType::String && right->type == ValueType::String) {
@@ -550,4 +914,242 @@ RuntimeVal* eval_binary_expr(BinaryExpr* binary, Environment* env) {
   }
 
   return new EmptyVal();
-}
\ No newline at end of file
+}
+
+/*
+Quickening: an operator node picks a specialized form the first time it runs, from the
+operand types it got. From then on it only checks that the operands still have those types
+(the guard) and skips the generic type checks and operator switch. When the guard fails the
+node deoptimizes, runs the generic code and picks again next time. After MAX_DEOPTS it stays
+generic, for nodes that really see mixed types.
+*/
+static constexpr uint8_t MAX_DEOPTS = 4;
+
+static BooleanVal* const quickTrue = MK_BOOL(true);
+static BooleanVal* const quickFalse = MK_BOOL(false);
+
+static bool both(RuntimeVal* left, RuntimeVal* right, ValueType type) {
+  return left->type == type && right->type == type;
+}
+
+static double num(RuntimeVal* value) {
+  return static_cast<NumberVal*>(value)->value;
+}
+
+static const std::string& str(RuntimeVal* value) {
+  return static_cast<StringVal*>(value)->value;
+}
+
+static BooleanVal* quick_bool(bool value) {
+  return value ? quickTrue : quickFalse;
+}
+
+static void quicken(QuickState& quick, Quick form) {
+  quick.form = quick.deopts >= MAX_DEOPTS ? Quick::Generic : form;
+}
+
+static void deoptimize(QuickState& quick) {
+  quick.deopts++;
+  quick.form = Quick::Unseen;
+}
+
+static Quick binary_form(RuntimeVal* left, RuntimeVal* right, OperatorType op) {
+  if (both(left, right, ValueType::String)) return Quick::StringConcat;
+  if (!both(left, right, ValueType::Number)) return Quick::Generic;
+  switch (op) {
+    case OperatorType::add: return Quick::NumberAdd;
+    case OperatorType::substract: return Quick::NumberSubtract;
+    case OperatorType::multiply: return Quick::NumberMultiply;
+    case OperatorType::divide: return Quick::NumberDivide;
+    case OperatorType::modulo: return Quick::NumberModulo;
+  }
+  return Quick::Generic;
+}
+
+static Quick comparison_form(RuntimeVal* left, RuntimeVal* right, ComparisonOperatorType op) {
+  if (both(left, right, ValueType::String)) {
+    if (op == ComparisonOperatorType::equal) return Quick::StringEqual;
+    if (op == ComparisonOperatorType::not_equal) return Quick::StringNotEqual;
+    return Quick::Generic;
+  }
+  if (!both(left, right, ValueType::Number)) return Quick::Generic;
+  switch (op) {
+    case ComparisonOperatorType::equal: return Quick::NumberEqual;
+    case ComparisonOperatorType::not_equal: return Quick::NumberNotEqual;
+    case ComparisonOperatorType::greater_equal: return Quick::NumberGreaterEqual;
+    case ComparisonOperatorType::greater: return Quick::NumberGreater;
+    case ComparisonOperatorType::less_equal: return Quick::NumberLessEqual;
+    case ComparisonOperatorType::less: return Quick::NumberLess;
+  }
+  return Quick::Generic;
+}
+
+RuntimeVal* eval_binary_expr(BinaryExpr* binary, Environment* env) {
+  RuntimeVal* left = eval_left(binary->left, binary->right, env);
+  RuntimeVal* right = eval_operand(binary->right, env);
+
+  switch (binary->quick.form) {
+    case Quick::NumberAdd:
+      if (both(left, right, ValueType::Number)) return MK_NUM(num(left) + num(right));
+      break;
+    case Quick::NumberSubtract:
+      if (both(left, right, ValueType::Number)) return MK_NUM(num(left) - num(right));
+      break;
+    case Quick::NumberMultiply:
+      if (both(left, right, ValueType::Number)) return MK_NUM(num(left) * num(right));
+      break;
+    case Quick::NumberDivide:
+      if (both(left, right, ValueType::Number)) return MK_NUM(num(left) / num(right));
+      break;
+    case Quick::NumberModulo:
+      if (both(left, right, ValueType::Number)) return MK_NUM(std::fmod(num(left), num(right)));
+      break;
+    case Quick::StringConcat:
+      if (both(left, right, ValueType::String)) return MK_STRING(str(left) + str(right));
+      break;
+    case Quick::Unseen:
+      quicken(binary->quick, binary_form(left, right, binary->expr_operator));
+      return binary_values(left, right, binary->expr_operator);
+    default:
+      return binary_values(left, right, binary->expr_operator);
+  }
+
+  deoptimize(binary->quick);
+  return binary_values(left, right, binary->expr_operator);
+}
+
+RuntimeVal* eval_comparison_node(ComparisonExpr* compExpr, Environment* env) {
+  RuntimeVal* left = eval_left(compExpr->left, compExpr->right, env);
+  RuntimeVal* right = eval_operand(compExpr->right, env);
+
+  switch (compExpr->quick.form) {
+    case Quick::NumberEqual:
+      if (both(left, right, ValueType::Number)) return quick_bool(num(left) == num(right));
+      break;
+    case Quick::NumberNotEqual:
+      if (both(left, right, ValueType::Number)) return quick_bool(num(left) != num(right));
+      break;
+    case Quick::NumberGreaterEqual:
+      if (both(left, right, ValueType::Number)) return quick_bool(num(left) >= num(right));
+      break;
+    case Quick::NumberGreater:
+      if (both(left, right, ValueType::Number)) return quick_bool(num(left) > num(right));
+      break;
+    case Quick::NumberLessEqual:
+      if (both(left, right, ValueType::Number)) return quick_bool(num(left) <= num(right));
+      break;
+    case Quick::NumberLess:
+      if (both(left, right, ValueType::Number)) return quick_bool(num(left) < num(right));
+      break;
+    case Quick::StringEqual:
+      if (both(left, right, ValueType::String)) return quick_bool(str(left) == str(right));
+      break;
+    case Quick::StringNotEqual:
+      if (both(left, right, ValueType::String)) return quick_bool(str(left) != str(right));
+      break;
+    case Quick::Unseen:
+      quicken(compExpr->quick, comparison_form(left, right, compExpr->op));
+      return eval_comparison_expr(left, right, compExpr->op);
+    default:
+      return eval_comparison_expr(left, right, compExpr->op);
+  }
+
+  deoptimize(compExpr->quick);
+  return eval_comparison_expr(left, right, compExpr->op);
+}
+
+/*
+Conditions: if and while checks, and what and/or/not work on, are only looked at as a bool.
+eval_condition gives that bool without a BooleanVal in between for the nodes that make one,
+and/or don't run their right side once the left one decided.
+*/
+static bool makes_bool(Expr* node) {
+  switch (node->kind) {
+    case NodeType::ComparisonExpr:
+    case NodeType::LogicalExpr:
+    case NodeType::NegateExpr:
+    case NodeType::BooleanLiteral:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// an operand of and/or, anything eval_runtimeval_to_bool takes
+static bool eval_truthy(Expr* node, Environment* env) {
+  if (makes_bool(node)) return eval_condition(node, env);
+  return eval_runtimeval_to_bool(eval_operand(node, env));
+}
+
+static bool eval_compare(ComparisonExpr* compExpr, Environment* env) {
+  RuntimeVal* left = eval_left(compExpr->left, compExpr->right, env);
+  RuntimeVal* right = eval_operand(compExpr->right, env);
+  return test(left, right, compExpr->op);
+}
+
+bool eval_condition(Expr* check, Environment* env) {
+  switch (check->kind) {
+    case NodeType::ComparisonExpr:
+      return eval_compare(static_cast<ComparisonExpr*>(check), env);
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logExpr = static_cast<LogicalExpr*>(check);
+      bool left = eval_truthy(logExpr->left, env);
+      switch (logExpr->op) {
+        case LogicalOperatorType::And: return left && eval_truthy(logExpr->right, env);
+        case LogicalOperatorType::Or: return left || eval_truthy(logExpr->right, env);
+        case LogicalOperatorType::Xor: return left != eval_truthy(logExpr->right, env);
+      }
+      raise_error("Invalid Logical operator");
+    }
+    case NodeType::NegateExpr: {
+      Expr* expr = static_cast<NegateExpr*>(check)->expr;
+      if (makes_bool(expr)) return !eval_condition(expr, env);
+
+      RuntimeVal* ret = eval_operand(expr, env);
+      if (ret->type == ValueType::Boolean) return !static_cast<BooleanVal*>(ret)->value;
+      if (ret->type == ValueType::Number) return !num(ret);
+      return ret->type == ValueType::Empty;
+    }
+    case NodeType::BooleanLiteral:
+      return static_cast<BooleanLiteral*>(check)->value;
+    default: {
+      RuntimeVal* ret = evaluate(check, env);
+      if (ret->type != ValueType::Boolean) raise_error("if checks only support boolean values");
+      return static_cast<BooleanVal*>(ret)->value;
+    }
+  }
+}
+
+RuntimeVal* eval_logical_node(LogicalExpr* logExpr, Environment* env) {
+  return quick_bool(eval_condition(logExpr, env));
+}
+
+RuntimeVal* eval_bitshift_expr(BitShiftExpr* bitShift, Environment* env) {
+  RuntimeVal* left = eval_left(bitShift->left, bitShift->right, env);
+  RuntimeVal* right = eval_operand(bitShift->right, env);
+
+  switch (bitShift->quick.form) {
+    case Quick::NumberShiftLeft:
+      if (both(left, right, ValueType::Number)) return MK_NUM((int)num(left) << (int)num(right));
+      break;
+    case Quick::NumberShiftRight:
+      if (both(left, right, ValueType::Number)) return MK_NUM((int)num(left) >> (int)num(right));
+      break;
+    case Quick::Unseen:
+      if (both(left, right, ValueType::Number)) {
+        quicken(bitShift->quick, bitShift->shiftRight ? Quick::NumberShiftRight : Quick::NumberShiftLeft);
+      }
+      break;
+    default:
+      break;
+  }
+
+  if (!both(left, right, ValueType::Number))
+    raise_error("can't use bitshift with non-number values");
+
+  if (bitShift->shiftRight) {
+    return MK_NUM((int)num(left) >> (int)num(right));
+  } else {
+    return MK_NUM((int)num(left) << (int)num(right));
+  }
+}
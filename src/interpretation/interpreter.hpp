@@ -1,6 +1,10 @@
 #include "../parsing/ast.hpp"
 #include "Environment.hpp"
 
+// kept loop invariant values are good while heapEpoch stays the same, see eval_invariant_expr
+extern uint64_t heapEpoch;
+extern uint64_t uncachedCalls; // calls whose result can't be kept, pure natives don't count
+
 RuntimeVal* evaluate(Stmt* astNode, Environment* env);
 
 RuntimeVal* eval_member_expr(MemberExpr* specialExpr, Environment* env);
@@ -15,11 +19,47 @@ RuntimeVal* eval_logical_expr(RuntimeVal* left, RuntimeVal* right, LogicalOperat
 
 RuntimeVal* eval_call_expr(CallExpr* callexpr, Environment* env);
 
+// raises a stack overflow once three quarters of the native stack are used up. The
+// tree-walker's calls and every VM that starts check it, the ones nested in each other recurse there
+void check_native_stack();
+
+// runs a callable whose arguments are in `scope`, on whichever tier it's at. Calls in tail
+// position (CallExpr::tail) come back here as a TailCallVal and take the place of the call
+// that made them, so tail recursion doesn't go any deeper
+RuntimeVal* call_function(FunctionVal* func, Environment* scope);
+
 RuntimeVal* eval_if_expr(IfStatement* ifExpr, Environment* env);
 
+RuntimeVal* eval_block_expr(BlockExpr* block, Environment* env);
+
 RuntimeVal* eval_while_expr(WhileStatement* whileExpr, Environment* env);
 
-std::vector<RuntimeVal*> eval_args(std::vector<Expr*> args, Environment* env);
+RuntimeVal* eval_for_expr(ForStatement* forStmt, Environment* env);
+
+// what `for i in range(start, end, step)` counts over, checked the same way on every tier
+struct Range {
+  double start = 0;
+  double end = 0;
+  double step = 1;
+
+  bool has(double i) const { return step > 0 ? i < end : i > end; }
+};
+
+// nullptr for a start or a step that was left out
+Range make_range(RuntimeVal* start, RuntimeVal* end, RuntimeVal* step);
+
+// what `for x in ...` goes over
+ArrayVal* for_array(RuntimeVal* value);
+
+RuntimeVal* eval_match_expr(MatchExpr* match, Environment* env);
+
+// the scope the body of the case `value` matches runs in, with the names its pattern binds.
+// `index` is the case, match->cases.size() for else
+Environment* match_scope(MatchExpr* match, RuntimeVal* value, Environment* env, size_t& index);
+
+std::vector<RuntimeVal*> eval_args(ExprList args, Environment* env);
+
+RuntimeVal* eval_invariant_expr(InvariantExpr* invariant, Environment* env);
 
 RuntimeVal* eval_program(Program* program, Environment* env);
 
@@ -27,4 +67,15 @@ RuntimeVal* eval_assignment(AssignmentExpr* assign, Environment* env);
 
 NumberVal* eval_binary_math(NumberVal* a, NumberVal* b, OperatorType op);
 
-RuntimeVal* eval_binary_expr(BinaryExpr* binary, Environment* env);
\ No newline at end of file
+RuntimeVal* eval_binary_expr(BinaryExpr* binary, Environment* env);
+
+RuntimeVal* eval_comparison_node(ComparisonExpr* compExpr, Environment* env);
+
+// and/or short-circuit, the right side only runs when the left one doesn't decide
+RuntimeVal* eval_logical_node(LogicalExpr* logExpr, Environment* env);
+
+// an if or while check as a plain bool. Comparisons, and/or/not and boolean literals don't
+// make a BooleanVal for it, anything else has to give a boolean
+bool eval_condition(Expr* check, Environment* env);
+
+RuntimeVal* eval_bitshift_expr(BitShiftExpr* bitShift, Environment* env);
\ No newline at end of file
@@ -45,7 +45,7 @@ NATIVE_FN(pop) {
 Environment* makeArrayModule() {
   Environment* _module = new Environment();
 
-  _module->declareVar("len", MK_NATIVE_FUNC(len), true);
+  _module->declareVar("len", MK_NATIVE_FUNC(len, Purity::Pure), true);
   _module->declareVar("append", MK_NATIVE_FUNC(append), true);
   _module->declareVar("pop", MK_NATIVE_FUNC(pop), true);
 
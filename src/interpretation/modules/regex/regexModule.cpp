@@ -73,9 +73,9 @@ NATIVE_FN(replace) {
 Environment* makeRegexModule() {
   Environment* _module = new Environment();
 
-  _module->declareVar("compile", MK_NATIVE_FUNC(compile), true);
-  _module->declareVar("match", MK_NATIVE_FUNC(match), true);
-  _module->declareVar("replace", MK_NATIVE_FUNC(replace), true);
+  _module->declareVar("compile", MK_NATIVE_FUNC(compile, Purity::Pure), true);
+  _module->declareVar("match", MK_NATIVE_FUNC(match, Purity::Pure), true);
+  _module->declareVar("replace", MK_NATIVE_FUNC(replace, Purity::Pure), true);
 
   return _module;
 }
\ No newline at end of file
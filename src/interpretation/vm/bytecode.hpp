@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../../parsing/ast.hpp"
+
+class RuntimeVal;
+
+/*
+Instruction set of the register VM (vm.hpp). Code is a flat array of 32 bit words, an opcode
+followed by its operands. Every frame has a window of registers: the chunk's temporaries
+first, then a copy of its constants, so a literal operand is just another register and
+needs no instruction of its own. Other operands index one of the chunk's pools or the code.
+
+  dst, a, b, src    registers
+  ref               refs[ref], a variable
+  k                 a register holding a constant
+  to, end, ...      positions in the code
+*/
+#define EAST_OPCODES(X) \
+  X(Move, 2)             /* dst src */ \
+  X(Empty, 1)            /* dst */ \
+  X(Load, 2)             /* dst ref */ \
+  X(LoadOuter, 2)        /* dst ref            from the scope around the current one (while checks) */ \
+  X(Peek, 2)             /* dst ref            Load of an operand that's only looked at, a number the variable owns stays its own */ \
+  X(PeekOuter, 2)        /* dst ref */ \
+  X(Store, 3)            /* dst ref local      assigns dst to the variable, dst gets what the assignment gives */ \
+  X(StoreNumber, 5)      /* dst ref a b op     x = a op b when it was inferred to be a number (src/optimization/types.hpp), dst is only for dropping */ \
+  X(Declare, 3)          /* dst ref constant */ \
+  X(Array, 3)            /* dst first count    array of registers first..first+count */ \
+  X(Function, 2)         /* dst f              callable closing over the current scope, nodes[f] is its declaration */ \
+  X(Call, 4)             /* dst callee first count */ \
+  X(TailCall, 5)         /* dst callee first count up   Call in tail position, a callable takes over the frame. Its scope is `up` Leaves away, NO_REUSE if it can't be reused */ \
+  X(Member, 3)           /* dst a symbol       a has to be a module */ \
+  X(Subscript, 3)        /* dst a b */ \
+  X(ExpectArray, 1)      /* a                  checks a is something StoreSubscript can take */ \
+  X(ExpectIndex, 1)      /* a */ \
+  X(StoreSubscript, 4)   /* dst a b ref        a[b] = dst, ref names the array */ \
+  X(Add, 3)              /* dst a b */ \
+  X(Subtract, 3)         /* dst a b */ \
+  X(Multiply, 3)         /* dst a b */ \
+  X(Divide, 3)           /* dst a b */ \
+  X(Modulo, 3)           /* dst a b */ \
+  X(Compare, 4)          /* dst a b op         ComparisonOperatorType */ \
+  X(Logical, 4)          /* dst a b op         LogicalOperatorType */ \
+  X(Negate, 2)           /* dst a */ \
+  X(Shift, 4)            /* dst a b right */ \
+  X(Enter, 1)            /* layout             new scope with layouts[layout] around what follows */ \
+  X(Leave, 0)            /* */ \
+  X(Jump, 1)             /* to */ \
+  X(JumpIfFalse, 2)      /* a to               a has to be a boolean */ \
+  X(JumpIfFalsy, 2)      /* a to               a can be anything and/or take (eval_runtimeval_to_bool) */ \
+  X(LoopResult, 4)       /* dst src break continue   keeps src as the loop's value in dst unless it's break/continue */ \
+  X(RangeStart, 6)       /* c a b step ref end   for over range(a, b, step): c gets the loop's counter, jump to end if there's nothing to count */ \
+  X(RangeNext, 5)        /* c b step ref to    counts c on, jump back to `to` while it's still in the range */ \
+  X(ArrayStart, 4)       /* c a ref end        for over the array a, c counts the index */ \
+  X(ArrayNext, 4)        /* c a ref to */ \
+  X(Invariants, 1)       /* count              slots for the loop invariant values of a loop that starts */ \
+  X(DropInvariants, 1)   /* count */ \
+  X(InvariantStart, 3)   /* dst at end         slot `at` from the top of the invariant slots, dst = the value and jump to end if it's kept */ \
+  X(InvariantEnd, 2)     /* dst at             keeps dst in the slot if nothing could have changed it */ \
+  X(Match, 3)            /* a node table       enter the scope of the case of match nodes[node] that a matches, jump to tables[table][case] (else last) */ \
+  X(Node, 2)             /* dst node           evaluate nodes[node] with the tree-walker */ \
+  X(NodeOuter, 2)        /* dst node           same, in the scope around the current one */ \
+  X(Return, 1)           /* src */ \
+  /* superinstructions, for what scripts do all the time */ \
+  X(BranchCompare, 4)    /* a b op to          jump unless `a op b` */ \
+  X(BranchCompareVar, 5) /* ref k op outer to  jump unless `variable op constant`, outer like LoadOuter */ \
+  X(IncrementVar, 4)     /* dst ref source k   x = x + constant, read from refs[source] and assigned to refs[ref] */ \
+  X(CallMember, 5)       /* dst a symbol first count   module.callable(...) */
+
+enum class OpCode : uint32_t {
+#define EAST_OPCODE_ENUM(name, operands) name,
+  EAST_OPCODES(EAST_OPCODE_ENUM)
+#undef EAST_OPCODE_ENUM
+};
+
+// TailCall's `up` when the caller's scope has to stay as it is
+constexpr uint32_t NO_REUSE = UINT32_MAX;
+
+// how many words follow the opcode
+inline uint32_t operand_count(OpCode op) {
+  static const uint8_t counts[] = {
+#define EAST_OPCODE_COUNT(name, operands) operands,
+    EAST_OPCODES(EAST_OPCODE_COUNT)
+#undef EAST_OPCODE_COUNT
+  };
+  return counts[static_cast<uint32_t>(op)];
+}
+
+struct NamedRef {
+  VarRef ref;
+  Symbol symbol;
+};
+
+// compiled code of a program or a callable body
+struct Chunk {
+  std::vector<uint32_t> code;
+  std::vector<RuntimeVal*> constants; // in the registers after the temporaries
+  std::vector<NamedRef> refs;
+  std::vector<const ScopeLayout*> layouts;
+  std::vector<Stmt*> nodes;
+  std::vector<std::vector<uint32_t>> tables; // Match: where the body of each case starts
+  uint32_t temporaries = 0;
+
+  uint32_t frame_size() const { return temporaries + static_cast<uint32_t>(constants.size()); }
+};
@@ -0,0 +1,739 @@
+#include "compiler.hpp"
+#include "../ValueTypes.hpp"
+#include "runtime.hpp"
+#include <unordered_map>
+
+static bool superinstructionsEnabled = true;
+
+void set_superinstructions_enabled(bool enabled) {
+  superinstructionsEnabled = enabled;
+}
+
+// a register, or a constant that only gets its register once the number of temporaries is known
+struct Operand {
+  uint32_t index;
+  bool constant = false;
+};
+
+static bool is_literal(Stmt* node) {
+  return node->kind == NodeType::NumberLiteral || node->kind == NodeType::StringLiteral || node->kind == NodeType::BooleanLiteral;
+}
+
+// the value can't be break or continue, a loop doesn't have to look at it
+static bool never_breaks(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::ArrayLiteral:
+    case NodeType::FunctionDeclaration:
+    case NodeType::BinaryExpr:
+    case NodeType::ComparisonExpr:
+    case NodeType::LogicalExpr:
+    case NodeType::NegateExpr:
+    case NodeType::BitShiftExpr:
+      return true;
+    case NodeType::AssignmentExpr:
+      return never_breaks(static_cast<AssignmentExpr*>(node)->value);
+    case NodeType::VariableDeclaration:
+      return never_breaks(static_cast<VariableDeclaration*>(node)->value);
+    case NodeType::InvariantExpr:
+      return never_breaks(static_cast<InvariantExpr*>(node)->expr);
+    default:
+      return false;
+  }
+}
+
+// can't do anything besides giving a value (or an error), so evaluating it a bit later changes nothing
+static bool is_simple(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::Identifier:
+      return true;
+    case NodeType::ArrayLiteral:
+    case NodeType::BinaryExpr:
+    case NodeType::ComparisonExpr:
+    case NodeType::LogicalExpr:
+    case NodeType::NegateExpr:
+    case NodeType::BitShiftExpr:
+    case NodeType::SubscriptExpr:
+    case NodeType::MemberExpr:
+    case NodeType::InvariantExpr: {
+      bool simple = true;
+      for_each_child(node, [&](Stmt* child) { simple = simple && is_simple(child); });
+      return simple;
+    }
+    default:
+      return false;
+  }
+}
+
+class Compiler {
+  private:
+    Chunk* chunk;
+    // compiling a while check: it runs in the scope around the loop's own, which is already
+    // entered, so variables come from one scope further out
+    bool outer = false;
+    std::vector<const WhileStatement*> loops; // the ones we're in that keep invariant values, innermost last
+    uint32_t next = 0; // first free temporary
+    uint32_t entered = 0; // scopes entered since the chunk's own, for TailCall
+    std::vector<size_t> constantOperands; // where the code refers to a constant, fixed up at the end
+    std::unordered_map<RuntimeVal*, uint32_t> constantIndex;
+
+    uint32_t temporary() {
+      uint32_t reg = next++;
+      if (next > chunk->temporaries) chunk->temporaries = next;
+      return reg;
+    }
+
+    void put(uint32_t word) {
+      chunk->code.push_back(word);
+    }
+    void put(Operand operand) {
+      if (operand.constant) constantOperands.push_back(chunk->code.size());
+      put(operand.index);
+    }
+    template <typename... Operands>
+    void emit(OpCode op, Operands... operands) {
+      put(static_cast<uint32_t>(op));
+      (put(operands), ...);
+    }
+
+    // position of the last operand emitted, for jump targets that get patched later
+    size_t last() {
+      return chunk->code.size() - 1;
+    }
+    uint32_t here() {
+      return static_cast<uint32_t>(chunk->code.size());
+    }
+    void patch(size_t at) {
+      chunk->code[at] = here();
+    }
+
+    template <typename T>
+    static uint32_t add(std::vector<T>& pool, T item) {
+      pool.push_back(item);
+      return static_cast<uint32_t>(pool.size() - 1);
+    }
+    uint32_t ref(const VarRef& varRef, Symbol symbol) {
+      return add(chunk->refs, NamedRef{ varRef, symbol });
+    }
+
+    Operand constant(RuntimeVal* value);
+    Operand literal(Stmt* node);
+    Operand operand(Expr* node);
+    Operand look(Expr* node);
+    Operand look_left(Expr* left, Expr* right);
+
+    void compile(Stmt* node, uint32_t dst);
+    void compile_value(Stmt* node, uint32_t dst);
+    void compile_node(Stmt* node, uint32_t dst);
+    void compile_body(StmtList body, uint32_t dst);
+    void compile_scope(StmtList body, const ScopeLayout* layout, uint32_t dst);
+    void compile_condition(Expr* check, std::vector<size_t>& exits, bool truthy = false);
+    void compile_call(CallExpr* call, uint32_t dst);
+    void compile_assignment(AssignmentExpr* assign, uint32_t dst);
+    void compile_if(IfStatement* ifStmt, uint32_t dst);
+    void compile_while(WhileStatement* whileStmt, uint32_t dst);
+    void compile_iterations(WhileStatement* whileStmt, uint32_t dst);
+    void compile_for(ForStatement* forStmt, uint32_t dst);
+    void compile_invariant(InvariantExpr* invariant, uint32_t dst);
+    void compile_match(MatchExpr* match, uint32_t dst);
+
+    // constants sit right after the temporaries
+    void finish() {
+      for (size_t at : constantOperands) chunk->code[at] += chunk->temporaries;
+    }
+
+  public:
+    Compiler(Chunk* c): chunk(c) {}
+
+    void compile_chunk(StmtList body) {
+      uint32_t result = temporary();
+      compile_body(body, result);
+      emit(OpCode::Return, result);
+      finish();
+    }
+
+    // register 0 comes in holding the loop's value so far
+    void compile_loop(WhileStatement* whileStmt) {
+      uint32_t result = temporary();
+      if (whileStmt->invariants > 0) {
+        emit(OpCode::Invariants, whileStmt->invariants);
+        loops.push_back(whileStmt);
+      }
+      compile_iterations(whileStmt, result);
+      if (whileStmt->invariants > 0) emit(OpCode::DropInvariants, whileStmt->invariants);
+      emit(OpCode::Return, result);
+      finish();
+    }
+};
+
+Operand Compiler::constant(RuntimeVal* value) {
+  auto found = constantIndex.find(value);
+  if (found != constantIndex.end()) return { found->second, true };
+
+  uint32_t index = add(chunk->constants, value);
+  constantIndex.emplace(value, index);
+  return { index, true };
+}
+
+// the value the tree-walker would give, shared with it
+Operand Compiler::literal(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral: {
+      NumberLiteral* numLit = static_cast<NumberLiteral*>(node);
+      if (numLit->cached == nullptr) numLit->cached = MK_NUM(numLit->value);
+      return constant(numLit->cached);
+    }
+    case NodeType::StringLiteral: {
+      StringLiteral* strLit = static_cast<StringLiteral*>(node);
+      if (strLit->cached == nullptr) strLit->cached = MK_STRING(std::string(strLit->value));
+      return constant(strLit->cached);
+    }
+    default: {
+      BooleanLiteral* boolLit = static_cast<BooleanLiteral*>(node);
+      if (boolLit->cached == nullptr) boolLit->cached = MK_BOOL(boolLit->value);
+      return constant(boolLit->cached);
+    }
+  }
+}
+
+// where the value of `node` can be read from, a constant or a new temporary
+Operand Compiler::operand(Expr* node) {
+  if (is_literal(node)) return literal(node);
+  uint32_t reg = temporary();
+  compile(node, reg);
+  return { reg };
+}
+
+// operand() for a value that's only looked at (Peek), a number the variable owns stays its own
+Operand Compiler::look(Expr* node) {
+  if (node->kind != NodeType::Identifier) return operand(node);
+  Identifier* iden = static_cast<Identifier*>(node);
+  uint32_t reg = temporary();
+  emit(outer ? OpCode::PeekOuter : OpCode::Peek, reg, ref(iden->ref, iden->symbol));
+  return { reg };
+}
+
+// the right side could write into a peeked number before it's used, unless it can't run anything
+Operand Compiler::look_left(Expr* left, Expr* right) {
+  return is_simple(right) ? look(left) : operand(left);
+}
+
+// temporaries taken while compiling a node are free again after it
+void Compiler::compile(Stmt* node, uint32_t dst) {
+  uint32_t mark = next;
+  compile_value(node, dst);
+  next = mark;
+}
+
+// left to the tree-walker
+void Compiler::compile_node(Stmt* node, uint32_t dst) {
+  emit(outer ? OpCode::NodeOuter : OpCode::Node, dst, add(chunk->nodes, node));
+}
+
+void Compiler::compile_body(StmtList body, uint32_t dst) {
+  if (body.empty()) emit(OpCode::Empty, dst);
+  for (Stmt* stmt : body) compile(stmt, dst);
+}
+
+void Compiler::compile_scope(StmtList body, const ScopeLayout* layout, uint32_t dst) {
+  emit(OpCode::Enter, add(chunk->layouts, layout));
+  entered++;
+  compile_body(body, dst);
+  entered--;
+  emit(OpCode::Leave);
+}
+
+// and, or, not and comparisons give a boolean whatever their operands are
+static bool makes_bool(Expr* node) {
+  switch (node->kind) {
+    case NodeType::ComparisonExpr:
+    case NodeType::LogicalExpr:
+    case NodeType::NegateExpr:
+    case NodeType::BooleanLiteral:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/*
+Jumps unless the check is true, the positions of the jump targets go to `exits`. and/or/not
+become jumps instead of booleans, so the right side of an and/or only runs when the left one
+doesn't decide. Their operands only have to be `truthy` (JumpIfFalsy), a check has to be a
+boolean.
+*/
+void Compiler::compile_condition(Expr* check, std::vector<size_t>& exits, bool truthy) {
+  uint32_t mark = next;
+  switch (check->kind) {
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* compExpr = static_cast<ComparisonExpr*>(check);
+      uint32_t op = static_cast<uint32_t>(compExpr->op);
+      if (!superinstructionsEnabled) {
+        emit(OpCode::JumpIfFalse, operand(check), 0u);
+      } else if (compExpr->left->kind == NodeType::Identifier && compExpr->right->kind == NodeType::NumberLiteral) {
+        Identifier* iden = static_cast<Identifier*>(compExpr->left);
+        emit(OpCode::BranchCompareVar, ref(iden->ref, iden->symbol), literal(compExpr->right), op, outer, 0u);
+      } else {
+        Operand left = look_left(compExpr->left, compExpr->right);
+        Operand right = look(compExpr->right);
+        emit(OpCode::BranchCompare, left, right, op, 0u);
+      }
+      exits.push_back(last());
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logExpr = static_cast<LogicalExpr*>(check);
+      if (logExpr->op == LogicalOperatorType::And) {
+        compile_condition(logExpr->left, exits, true);
+        compile_condition(logExpr->right, exits, true);
+      } else if (logExpr->op == LogicalOperatorType::Or) {
+        std::vector<size_t> right;
+        compile_condition(logExpr->left, right, true);
+        emit(OpCode::Jump, 0u);
+        size_t passed = last();
+        for (size_t at : right) patch(at);
+        compile_condition(logExpr->right, exits, true);
+        patch(passed);
+      } else {
+        // xor needs both sides anyway
+        emit(OpCode::JumpIfFalse, operand(check), 0u);
+        exits.push_back(last());
+      }
+      break;
+    }
+    case NodeType::NegateExpr: {
+      Expr* expr = static_cast<NegateExpr*>(check)->expr;
+      if (!makes_bool(expr)) {
+        // not has its own idea of what's false (Negate)
+        emit(OpCode::JumpIfFalse, operand(check), 0u);
+        exits.push_back(last());
+        break;
+      }
+      std::vector<size_t> passed;
+      compile_condition(expr, passed);
+      emit(OpCode::Jump, 0u);
+      exits.push_back(last());
+      for (size_t at : passed) patch(at);
+      break;
+    }
+    default:
+      emit(truthy ? OpCode::JumpIfFalsy : OpCode::JumpIfFalse, look(check), 0u);
+      exits.push_back(last());
+  }
+  next = mark;
+}
+
+void Compiler::compile_call(CallExpr* call, uint32_t dst) {
+  // module.callable(...), the member is looked up after the arguments ran, so they can't have done anything
+  bool member = superinstructionsEnabled && !call->tail && call->caller->kind == NodeType::MemberExpr;
+  for (Expr* arg : call->args) member = member && is_simple(arg);
+
+  if (member) {
+    MemberExpr* memberExpr = static_cast<MemberExpr*>(call->caller);
+    Operand module = operand(memberExpr->left);
+    uint32_t first = next;
+    for (Expr* arg : call->args) compile(arg, temporary());
+    emit(OpCode::CallMember, dst, module, memberExpr->identifier, first, call->args.size());
+    return;
+  }
+
+  Operand callee = operand(call->caller);
+  uint32_t first = next;
+  for (Expr* arg : call->args) compile(arg, temporary());
+  if (call->tail) {
+    emit(OpCode::TailCall, dst, callee, first, call->args.size(), call->reuseScope ? entered : NO_REUSE);
+  } else {
+    emit(OpCode::Call, dst, callee, first, call->args.size());
+  }
+}
+
+void Compiler::compile_assignment(AssignmentExpr* assign, uint32_t dst) {
+  Expr* target = assign->identifier;
+  if (target->kind == NodeType::Identifier) {
+    Identifier* iden = static_cast<Identifier*>(target);
+    BinaryExpr* binary = assign->value->kind == NodeType::BinaryExpr ? static_cast<BinaryExpr*>(assign->value) : nullptr;
+
+    // a number into the NumberVal the variable owns
+    if (assign->unboxed && !assign->local && binary != nullptr) {
+      Operand left = look_left(binary->left, binary->right);
+      Operand right = look(binary->right);
+      emit(OpCode::StoreNumber, dst, ref(iden->ref, iden->symbol), left, right, static_cast<uint32_t>(binary->expr_operator));
+      return;
+    }
+
+    // x = x + 1, x = x - 1
+    if (
+      superinstructionsEnabled && !assign->local && binary != nullptr
+      && (binary->expr_operator == OperatorType::add || binary->expr_operator == OperatorType::substract)
+      && binary->left->kind == NodeType::Identifier && binary->right->kind == NodeType::NumberLiteral
+      && static_cast<Identifier*>(binary->left)->symbol == iden->symbol
+    ) {
+      Identifier* source = static_cast<Identifier*>(binary->left);
+      double step = static_cast<NumberLiteral*>(binary->right)->value;
+      Operand k = binary->expr_operator == OperatorType::add ? literal(binary->right) : constant(MK_NUM(-step));
+      emit(OpCode::IncrementVar, dst, ref(iden->ref, iden->symbol), ref(source->ref, source->symbol), k);
+      return;
+    }
+
+    compile(assign->value, dst);
+    emit(OpCode::Store, dst, ref(iden->ref, iden->symbol), assign->local);
+    return;
+  }
+
+  SubscriptExpr* subs = target->kind == NodeType::SubscriptExpr ? static_cast<SubscriptExpr*>(target) : nullptr;
+  if (subs == nullptr || subs->left->kind != NodeType::Identifier) {
+    compile_node(assign, dst); // errors out the same way
+    return;
+  }
+  Identifier* array = static_cast<Identifier*>(subs->left);
+  Operand left = operand(subs->left);
+  emit(OpCode::ExpectArray, left);
+  Operand index = is_simple(assign->value) ? look(subs->value) : operand(subs->value);
+  emit(OpCode::ExpectIndex, index);
+  compile(assign->value, dst);
+  emit(OpCode::StoreSubscript, dst, left, index, ref(array->ref, array->symbol));
+}
+
+/*
+  check, jump to next unless it's true
+  Enter, body, Leave, Jump end
+next:
+  ...the else_ifs the same way
+  Enter, else body, Leave
+end:
+*/
+void Compiler::compile_if(IfStatement* ifStmt, uint32_t dst) {
+  std::vector<size_t> exits;
+  std::vector<size_t> next;
+  compile_condition(ifStmt->check, next);
+  compile_scope(ifStmt->body, ifStmt->layout, dst);
+  emit(OpCode::Jump, 0u);
+  exits.push_back(last());
+
+  for (const ElseIfBranch& branch : ifStmt->else_if_chain) {
+    for (size_t at : next) patch(at);
+    next.clear();
+    compile_condition(branch.check, next);
+    compile_scope(branch.body, ifStmt->layout, dst);
+    emit(OpCode::Jump, 0u);
+    exits.push_back(last());
+  }
+
+  for (size_t at : next) patch(at);
+  compile_scope(ifStmt->else_body, ifStmt->layout, dst);
+  for (size_t exit : exits) patch(exit);
+}
+
+/*
+  Empty dst             the loop's value
+  Enter
+check:
+  check, jump to end unless it's true
+  statement, LoopResult end check (if it could give break/continue)
+  ...
+  Jump check
+end:
+  Leave
+*/
+void Compiler::compile_while(WhileStatement* whileStmt, uint32_t dst) {
+  emit(OpCode::Empty, dst);
+  if (whileStmt->invariants > 0) {
+    emit(OpCode::Invariants, whileStmt->invariants);
+    loops.push_back(whileStmt);
+  }
+  emit(OpCode::Enter, add(chunk->layouts, whileStmt->layout));
+  entered++;
+  compile_iterations(whileStmt, dst);
+  entered--;
+  emit(OpCode::Leave);
+  if (whileStmt->invariants > 0) {
+    emit(OpCode::DropInvariants, whileStmt->invariants);
+    loops.pop_back();
+  }
+}
+
+// check to end, in the loop's scope
+void Compiler::compile_iterations(WhileStatement* whileStmt, uint32_t dst) {
+  uint32_t check = here();
+  outer = true;
+  std::vector<size_t> exits;
+  compile_condition(whileStmt->check, exits);
+  outer = false;
+
+  uint32_t value = temporary();
+  for (Stmt* stmt : whileStmt->body) {
+    if (never_breaks(stmt)) {
+      compile(stmt, dst);
+      continue;
+    }
+    compile(stmt, value);
+    emit(OpCode::LoopResult, dst, value, 0u, check);
+    exits.push_back(last() - 1);
+  }
+  emit(OpCode::Jump, check);
+
+  for (size_t exit : exits) patch(exit);
+}
+
+/*
+  Empty dst             the loop's value
+  start, end, step      or the array
+  Enter
+  RangeStart/ArrayStart counter ... end
+body:
+  statement, LoopResult end next (if it could give break/continue)
+  ...
+next:
+  RangeNext/ArrayNext counter ... body
+end:
+  Leave
+*/
+void Compiler::compile_for(ForStatement* forStmt, uint32_t dst) {
+  emit(OpCode::Empty, dst);
+  uint32_t counter = temporary();
+  uint32_t var = ref(forStmt->ref, forStmt->identifier);
+  // loaded, not peeked, the body could write into a number a variable owns
+  bool range = forStmt->iterable == nullptr;
+  Operand start = range && forStmt->start == nullptr ? constant(MK_NUM(0)) : operand(range ? forStmt->start : forStmt->iterable);
+  Operand end = range ? operand(forStmt->end) : Operand{};
+  Operand step = range && forStmt->step != nullptr ? operand(forStmt->step) : constant(MK_NUM(1));
+
+  emit(OpCode::Enter, add(chunk->layouts, forStmt->layout));
+  entered++;
+  if (range) {
+    emit(OpCode::RangeStart, counter, start, end, step, var, 0u);
+  } else {
+    emit(OpCode::ArrayStart, counter, start, var, 0u);
+  }
+  std::vector<size_t> exits = { last() };
+  uint32_t body = here();
+
+  uint32_t value = temporary();
+  std::vector<size_t> continues;
+  for (Stmt* stmt : forStmt->body) {
+    if (never_breaks(stmt)) {
+      compile(stmt, dst);
+      continue;
+    }
+    compile(stmt, value);
+    emit(OpCode::LoopResult, dst, value, 0u, 0u);
+    exits.push_back(last() - 1);
+    continues.push_back(last());
+  }
+
+  for (size_t at : continues) patch(at);
+  if (range) {
+    emit(OpCode::RangeNext, counter, end, step, var, body);
+  } else {
+    emit(OpCode::ArrayNext, counter, start, var, body);
+  }
+  for (size_t exit : exits) patch(exit);
+  entered--;
+  emit(OpCode::Leave);
+}
+
+// the slots of the loops we're in are on top of each other, the innermost loop's last
+void Compiler::compile_invariant(InvariantExpr* invariant, uint32_t dst) {
+  uint32_t fromTop = 0;
+  for (size_t i = loops.size(); i-- > 0;) {
+    fromTop += loops[i]->invariants;
+    if (loops[i] != invariant->loop) continue;
+
+    uint32_t at = fromTop - invariant->slot;
+    emit(OpCode::InvariantStart, dst, at, 0u);
+    size_t end = last();
+    compile(invariant->expr, dst);
+    emit(OpCode::InvariantEnd, dst, at);
+    patch(end);
+    return;
+  }
+  compile(invariant->expr, dst); // not in its loop (anymore), nothing to keep it in
+}
+
+/*
+  Match value node table   the decision tree picks the case, enters its scope and jumps
+case:
+  body, Leave, Jump end
+  ...
+else:
+  else body, Leave
+end:
+*/
+void Compiler::compile_match(MatchExpr* match, uint32_t dst) {
+  Operand value = operand(match->value);
+  uint32_t table = add(chunk->tables, std::vector<uint32_t>());
+  emit(OpCode::Match, value, add(chunk->nodes, static_cast<Stmt*>(match)), table);
+
+  std::vector<size_t> exits;
+  entered++;
+  for (const MatchCase& matchCase : match->cases) {
+    chunk->tables[table].push_back(here());
+    compile_body(matchCase.body, dst);
+    emit(OpCode::Leave);
+    emit(OpCode::Jump, 0u);
+    exits.push_back(last());
+  }
+  chunk->tables[table].push_back(here());
+  compile_body(match->else_body, dst);
+  entered--;
+  emit(OpCode::Leave);
+  for (size_t exit : exits) patch(exit);
+}
+
+void Compiler::compile_value(Stmt* node, uint32_t dst) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral: {
+      emit(OpCode::Move, dst, literal(node));
+      break;
+    }
+    case NodeType::Identifier: {
+      Identifier* iden = static_cast<Identifier*>(node);
+      emit(outer ? OpCode::LoadOuter : OpCode::Load, dst, ref(iden->ref, iden->symbol));
+      break;
+    }
+    case NodeType::ArrayLiteral: {
+      ArrayLiteral* array = static_cast<ArrayLiteral*>(node);
+      uint32_t first = next;
+      for (Expr* elem : array->elements) compile(elem, temporary());
+      emit(OpCode::Array, dst, first, array->elements.size());
+      break;
+    }
+    case NodeType::CallExpr: {
+      compile_call(static_cast<CallExpr*>(node), dst);
+      break;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      emit(OpCode::Member, dst, operand(member->left), member->identifier);
+      break;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* subs = static_cast<SubscriptExpr*>(node);
+      Operand left = operand(subs->left);
+      Operand index = look(subs->value);
+      emit(OpCode::Subscript, dst, left, index);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      Operand left = look_left(binary->left, binary->right);
+      Operand right = look(binary->right);
+      OpCode op = OpCode::Add;
+      switch (binary->expr_operator) {
+        case OperatorType::add: op = OpCode::Add; break;
+        case OperatorType::substract: op = OpCode::Subtract; break;
+        case OperatorType::multiply: op = OpCode::Multiply; break;
+        case OperatorType::divide: op = OpCode::Divide; break;
+        case OperatorType::modulo: op = OpCode::Modulo; break;
+      }
+      emit(op, dst, left, right);
+      break;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* compExpr = static_cast<ComparisonExpr*>(node);
+      Operand left = look_left(compExpr->left, compExpr->right);
+      Operand right = look(compExpr->right);
+      emit(OpCode::Compare, dst, left, right, static_cast<uint32_t>(compExpr->op));
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logExpr = static_cast<LogicalExpr*>(node);
+      if (logExpr->op == LogicalOperatorType::Xor) {
+        Operand left = look_left(logExpr->left, logExpr->right);
+        Operand right = look(logExpr->right);
+        emit(OpCode::Logical, dst, left, right, static_cast<uint32_t>(logExpr->op));
+        break;
+      }
+      // and/or short-circuit, they're jumps like in a check
+      std::vector<size_t> failed;
+      compile_condition(logExpr, failed);
+      emit(OpCode::Move, dst, constant(trueValue));
+      emit(OpCode::Jump, 0u);
+      size_t end = last();
+      for (size_t at : failed) patch(at);
+      emit(OpCode::Move, dst, constant(falseValue));
+      patch(end);
+      break;
+    }
+    case NodeType::NegateExpr: {
+      emit(OpCode::Negate, dst, look(static_cast<NegateExpr*>(node)->expr));
+      break;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* bitShift = static_cast<BitShiftExpr*>(node);
+      Operand left = look_left(bitShift->left, bitShift->right);
+      Operand right = look(bitShift->right);
+      emit(OpCode::Shift, dst, left, right, bitShift->shiftRight);
+      break;
+    }
+    case NodeType::InvariantExpr: {
+      compile_invariant(static_cast<InvariantExpr*>(node), dst);
+      break;
+    }
+    // everything below makes or changes variables of the current scope
+    case NodeType::AssignmentExpr: {
+      if (outer) return compile_node(node, dst);
+      compile_assignment(static_cast<AssignmentExpr*>(node), dst);
+      break;
+    }
+    case NodeType::VariableDeclaration: {
+      if (outer) return compile_node(node, dst);
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      compile(varDec->value, dst);
+      emit(OpCode::Declare, dst, ref(varDec->ref, varDec->identifier), varDec->constant);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      if (outer) return compile_node(node, dst);
+      emit(OpCode::Function, dst, add(chunk->nodes, node));
+      break;
+    }
+    case NodeType::IfStatement: {
+      if (outer) return compile_node(node, dst);
+      compile_if(static_cast<IfStatement*>(node), dst);
+      break;
+    }
+    case NodeType::WhileStatement: {
+      if (outer) return compile_node(node, dst);
+      compile_while(static_cast<WhileStatement*>(node), dst);
+      break;
+    }
+    case NodeType::ForStatement: {
+      if (outer) return compile_node(node, dst);
+      compile_for(static_cast<ForStatement*>(node), dst);
+      break;
+    }
+    case NodeType::BlockExpr: {
+      if (outer) return compile_node(node, dst);
+      BlockExpr* block = static_cast<BlockExpr*>(node);
+      compile_scope(block->body, block->layout, dst);
+      break;
+    }
+    case NodeType::MatchExpr: {
+      if (outer) return compile_node(node, dst);
+      compile_match(static_cast<MatchExpr*>(node), dst);
+      break;
+    }
+    default: // @import/@include
+      compile_node(node, dst);
+  }
+}
+
+Chunk* compile_chunk(StmtList body) {
+  Chunk* chunk = new Chunk();
+  Compiler(chunk).compile_chunk(body);
+  return chunk;
+}
+
+Chunk* compile_loop(WhileStatement* whileStmt) {
+  Chunk* chunk = new Chunk();
+  Compiler(chunk).compile_loop(whileStmt);
+  return chunk;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "bytecode.hpp"
+
+/*
+Turns the statements of a program or a callable into a chunk. The result of the chunk is
+what evaluating the statements one after the other gives (the last value, empty if none).
+Nodes the VM has no instructions for (@import, @include) are compiled into a Node
+instruction that hands them to the tree-walker, so every program can be compiled.
+*/
+Chunk* compile_chunk(StmtList body);
+
+// the rest of a loop the tree-walker is already running, for on-stack replacement (tiers.hpp).
+// It runs in the loop's own scope, starting at the check, and register 0 has to come in
+// holding the loop's value so far
+Chunk* compile_loop(WhileStatement* whileStmt);
+
+// superinstructions are on by default, turning them off shows what they save (bench/dispatch.cpp)
+void set_superinstructions_enabled(bool enabled);
@@ -0,0 +1,815 @@
+#include "jit.hpp"
+#include "runtime.hpp"
+#include "vm.hpp"
+#include "../interpreter.hpp"
+#include "../../Errors.hpp"
+#include <cmath>
+#include <vector>
+
+static bool jitEnabled = EAST_JIT;
+
+void set_jit_enabled(bool enabled) {
+  jitEnabled = enabled && EAST_JIT;
+}
+
+bool jit_enabled() {
+  return jitEnabled;
+}
+
+#if EAST_JIT
+
+#include "x64.hpp"
+#include <sys/mman.h>
+
+static_assert(sizeof(ValueType) == 4, "the machine code compares types as dwords");
+
+// the JIT's own invariant slots, like the VM's
+static std::vector<KeptValue> keptValues;
+
+// machine code calls go on the C stack, deeper recursion is left to the interpreter
+// (the VM keeps its call frames on the heap)
+static constexpr uint32_t MAX_NATIVE_DEPTH = 4000;
+static uint32_t nativeDepth = 0;
+
+/*
+What the machine code calls. They take plain pointers and integers so every argument goes
+in a register. Generated code has no unwind info, so jit_run only enters it while raise_error
+exits the process. Under an ErrorCapture it throws, and the caller falls back to the VM then.
+*/
+
+static RuntimeVal* rt_number(double value) {
+  return MK_NUM(value);
+}
+
+static RuntimeVal* rt_load(Environment* env, const NamedRef* named) {
+  return env->lookupRef(named->ref, named->symbol);
+}
+
+static RuntimeVal* rt_load_outer(Environment* env, const NamedRef* named) {
+  return env->parent()->lookupRef(named->ref, named->symbol);
+}
+
+static RuntimeVal* rt_peek(Environment* env, const NamedRef* named) {
+  return env->peekRef(named->ref, named->symbol);
+}
+
+static RuntimeVal* rt_peek_outer(Environment* env, const NamedRef* named) {
+  return env->parent()->peekRef(named->ref, named->symbol);
+}
+
+static RuntimeVal* rt_store(Environment* env, const NamedRef* named, RuntimeVal* value, uint64_t local) {
+  return env->assignRef(named->ref, named->symbol, value, local);
+}
+
+static RuntimeVal* rt_assign_number(Environment* env, const NamedRef* named, double value) {
+  return env->assignNumber(named->ref, named->symbol, value);
+}
+
+static RuntimeVal* rt_store_number(Environment* env, const NamedRef* named, RuntimeVal* left, RuntimeVal* right, uint64_t op) {
+  return store_number(env, *named, left, right, static_cast<OperatorType>(op));
+}
+
+static RuntimeVal* rt_declare(Environment* env, const NamedRef* named, RuntimeVal* value, uint64_t constant) {
+  return env->declareRef(named->ref, named->symbol, value, constant);
+}
+
+static RuntimeVal* rt_array(RuntimeVal** first, uint64_t count) {
+  ArrayVal* array = new ArrayVal();
+  array->elements.assign(first, first + count);
+  return array;
+}
+
+static RuntimeVal* rt_function(Environment* env, FunctionDeclaration* funcDec) {
+  return make_function(funcDec, env);
+}
+
+static RuntimeVal* rt_call(RuntimeVal* callee, RuntimeVal** args, uint64_t argc) {
+  return call_value(callee, args, argc);
+}
+
+static RuntimeVal* rt_member(RuntimeVal* module, uint64_t symbol) {
+  if (module->type != ValueType::Module) raise_error("Unsuported type for member (dot) Expr");
+  return static_cast<ModuleVal*>(module)->moduleEnv->lookupVar(static_cast<Symbol>(symbol));
+}
+
+static RuntimeVal* rt_call_member(RuntimeVal* module, uint64_t symbol, RuntimeVal** args, uint64_t argc) {
+  return call_value(rt_member(module, symbol), args, argc);
+}
+
+static void rt_expect_array(RuntimeVal* value) {
+  if (value->type != ValueType::Array) raise_error("cannot subscript assing a non-array");
+}
+
+static void rt_expect_index(RuntimeVal* value) {
+  if (value->type != ValueType::Number) raise_error("cannot subscript using a non-number");
+}
+
+static void rt_store_subscript(Environment* env, RuntimeVal* value, RuntimeVal* array, RuntimeVal* index, const NamedRef* named) {
+  store_subscript(env, value, array, index, named->symbol);
+}
+
+static RuntimeVal* rt_modulo(RuntimeVal* left, RuntimeVal* right) {
+  return both_numbers(left, right) ? MK_NUM(std::fmod(number(left), number(right))) : binary_other(left, right);
+}
+
+static bool rt_test(RuntimeVal* left, RuntimeVal* right, uint64_t op) {
+  return test(left, right, static_cast<ComparisonOperatorType>(op));
+}
+
+static RuntimeVal* rt_compare(RuntimeVal* left, RuntimeVal* right, uint64_t op) {
+  return boolean(rt_test(left, right, op));
+}
+
+static RuntimeVal* rt_logical(RuntimeVal* left, RuntimeVal* right, uint64_t op) {
+  return eval_logical_expr(left, right, static_cast<LogicalOperatorType>(op));
+}
+
+static bool rt_truthy(RuntimeVal* value) {
+  return eval_runtimeval_to_bool(value);
+}
+
+static RuntimeVal* rt_shift(RuntimeVal* left, RuntimeVal* right, uint64_t shiftRight) {
+  if (!both_numbers(left, right)) raise_error("can't use bitshift with non-number values");
+  return MK_NUM(shiftRight ? (int)number(left) >> (int)number(right) : (int)number(left) << (int)number(right));
+}
+
+static Environment* rt_enter(Environment* env, const ScopeLayout* layout) {
+  return new Environment(env, layout);
+}
+
+static Environment* rt_leave(Environment* env) {
+  return env->parent();
+}
+
+static void rt_not_boolean() {
+  raise_error("if checks only support boolean values");
+}
+
+static bool rt_range_start(Environment* env, const NamedRef* named, RuntimeVal** counter, RuntimeVal* start, RuntimeVal* end, RuntimeVal* step) {
+  return range_start(env, *named, counter, start, end, step);
+}
+
+static bool rt_range_next(Environment* env, const NamedRef* named, RuntimeVal* counter, RuntimeVal* end, RuntimeVal* step) {
+  return range_next(env, *named, counter, end, step);
+}
+
+static bool rt_array_start(Environment* env, const NamedRef* named, RuntimeVal** counter, RuntimeVal* array) {
+  return array_start(env, *named, counter, array);
+}
+
+static bool rt_array_next(Environment* env, const NamedRef* named, RuntimeVal* counter, RuntimeVal* array) {
+  return array_next(env, *named, counter, array);
+}
+
+static void rt_invariants(uint64_t count) {
+  keptValues.resize(keptValues.size() + count);
+}
+
+static void rt_drop_invariants(uint64_t count) {
+  keptValues.resize(keptValues.size() - count);
+}
+
+static RuntimeVal* rt_invariant_start(uint64_t at) {
+  return kept_value(keptValues[keptValues.size() - at]);
+}
+
+static void rt_invariant_end(RuntimeVal* value, uint64_t at) {
+  keep_value(keptValues[keptValues.size() - at], value);
+}
+
+// which case rt_match picked, the code jumps on it right after
+static uint32_t matchedCase = 0;
+
+static Environment* rt_match(Environment* env, RuntimeVal* value, MatchExpr* match) {
+  size_t index;
+  Environment* scope = match_scope(match, value, env, index);
+  matchedCase = static_cast<uint32_t>(index);
+  return scope;
+}
+
+static RuntimeVal* rt_node(Stmt* node, Environment* env) {
+  return evaluate(node, env);
+}
+
+static RuntimeVal* rt_node_outer(Stmt* node, Environment* env) {
+  return evaluate(node, env->parent());
+}
+
+// where the fields the machine code reads are, taken from real objects
+static const NumberVal* numberProbe = MK_NUM(0);
+static const BooleanVal* booleanProbe = MK_BOOL(false);
+static const int32_t typeOffset = static_cast<int32_t>(reinterpret_cast<const char*>(&numberProbe->type) - reinterpret_cast<const char*>(numberProbe));
+static const int32_t numberOffset = static_cast<int32_t>(reinterpret_cast<const char*>(&numberProbe->value) - reinterpret_cast<const char*>(numberProbe));
+static const int32_t booleanOffset = static_cast<int32_t>(reinterpret_cast<const char*>(&booleanProbe->value) - reinterpret_cast<const char*>(booleanProbe));
+
+static int32_t type_id(ValueType type) {
+  return static_cast<int32_t>(type);
+}
+
+/*
+One chunk to machine code. The frame keeps the current scope in r12 and the temporaries on
+the stack at r13, constants are put straight into the code. Arguments go in rdi, rsi, rdx,
+rcx, r8 and results come back in rax, like for any other function.
+*/
+class NativeCompiler {
+  private:
+    using Label = X64Assembler::Label;
+    static constexpr Label NO_LABEL = UINT32_MAX; // the position is in the middle of an instruction
+    static constexpr uint32_t NOT_A_REGISTER = UINT32_MAX; // for a value that's already loaded
+
+    Chunk* chunk;
+    X64Assembler a;
+    std::vector<Label> positions; // a label for every instruction, by position in the code
+    Label notBoolean;
+    bool failed = false;
+
+    // a register of the chunk, temporary or constant
+    void get(Reg dst, uint32_t reg) {
+      if (reg < chunk->temporaries) {
+        a.load(dst, R13, static_cast<int32_t>(reg * 8));
+      } else {
+        a.mov(dst, chunk->constants[reg - chunk->temporaries]);
+      }
+    }
+
+    void put(uint32_t reg, Reg src) {
+      if (reg >= chunk->temporaries) {
+        failed = true;
+        return;
+      }
+      a.store(R13, static_cast<int32_t>(reg * 8), src);
+    }
+
+    void address(Reg dst, uint32_t first, uint32_t count) {
+      if (first + count > chunk->temporaries) failed = true;
+      a.lea(dst, R13, static_cast<int32_t>(first * 8));
+    }
+
+    // nullptr for temporaries and for NOT_A_REGISTER
+    RuntimeVal* constant(uint32_t reg) {
+      if (reg < chunk->temporaries || reg >= chunk->frame_size()) return nullptr;
+      return chunk->constants[reg - chunk->temporaries];
+    }
+
+    // whether the inline number path is worth emitting, a constant that isn't a number never takes it
+    bool may_be_number(uint32_t reg) {
+      RuntimeVal* value = constant(reg);
+      return value == nullptr || value->type == ValueType::Number;
+    }
+
+    // jumps to `other` unless `src` holds a number, constants are known already
+    void expect_number(Reg src, uint32_t reg, Label other) {
+      if (constant(reg) != nullptr) return;
+      a.cmp32(src, typeOffset, type_id(ValueType::Number));
+      a.j(CondNE, other);
+    }
+
+    Label at(uint32_t position) {
+      if (position >= positions.size() || positions[position] == NO_LABEL) {
+        failed = true;
+        return positions.back();
+      }
+      return positions[position];
+    }
+
+    void prologue(uint32_t temporaries);
+    void epilogue();
+    void arithmetic(const uint32_t* ip, void (X64Assembler::*op)(Xmm, Reg, int32_t));
+    void unless(ComparisonOperatorType op, Label target);
+    void compare(const uint32_t* ip);
+    void branch(uint32_t left, uint32_t right, ComparisonOperatorType op, Label target, Label next);
+    void increment(const uint32_t* ip);
+    void store_number(const uint32_t* ip);
+    void instruction(const uint32_t* ip, OpCode op, Label next);
+
+  public:
+    NativeCompiler(Chunk* c): chunk(c) {}
+
+    // the machine code, empty when the chunk has something the JIT doesn't know
+    std::vector<uint8_t> compile();
+};
+
+// entry(scope, first): register 0 starts as `first`, for loops entered halfway (compile_loop)
+void NativeCompiler::prologue(uint32_t temporaries) {
+  // rbp and two pushes keep rsp 16 byte aligned, so does a frame rounded to 16
+  a.push(RBP);
+  a.mov(RBP, RSP);
+  a.push(R12);
+  a.push(R13);
+  a.sub_rsp(static_cast<int32_t>((temporaries * 8 + 15) / 16 * 16));
+  a.mov(R12, RDI);
+  a.mov(R13, RSP);
+  if (temporaries > 0) a.store(R13, 0, RSI);
+}
+
+void NativeCompiler::epilogue() {
+  a.lea(RSP, RBP, -16);
+  a.pop(R13);
+  a.pop(R12);
+  a.pop(RBP);
+  a.ret();
+}
+
+// dst = a op b, the numbers inline and the rest through binary_other
+void NativeCompiler::arithmetic(const uint32_t* ip, void (X64Assembler::*op)(Xmm, Reg, int32_t)) {
+  get(RDI, ip[1]);
+  get(RSI, ip[2]);
+  if (may_be_number(ip[1]) && may_be_number(ip[2])) {
+    Label other = a.label();
+    Label done = a.label();
+    expect_number(RDI, ip[1], other);
+    expect_number(RSI, ip[2], other);
+    a.movsd(XMM0, RDI, numberOffset);
+    (a.*op)(XMM0, RSI, numberOffset);
+    a.call(reinterpret_cast<const void*>(&rt_number));
+    a.jmp(done);
+    a.bind(other);
+    a.call(reinterpret_cast<const void*>(&binary_other));
+    a.bind(done);
+  } else {
+    a.call(reinterpret_cast<const void*>(&binary_other));
+  }
+  put(ip[0], RAX);
+}
+
+// jumps to `target` unless `xmm0 op xmm1`, a NaN makes everything but != false
+void NativeCompiler::unless(ComparisonOperatorType op, Label target) {
+  switch (op) {
+    case ComparisonOperatorType::less:
+      a.ucomisd(XMM1, XMM0);
+      a.j(CondBE, target);
+      break;
+    case ComparisonOperatorType::less_equal:
+      a.ucomisd(XMM1, XMM0);
+      a.j(CondB, target);
+      break;
+    case ComparisonOperatorType::greater:
+      a.ucomisd(XMM0, XMM1);
+      a.j(CondBE, target);
+      break;
+    case ComparisonOperatorType::greater_equal:
+      a.ucomisd(XMM0, XMM1);
+      a.j(CondB, target);
+      break;
+    case ComparisonOperatorType::equal:
+      a.ucomisd(XMM0, XMM1);
+      a.j(CondP, target);
+      a.j(CondNE, target);
+      break;
+    case ComparisonOperatorType::not_equal: {
+      Label passed = a.label();
+      a.ucomisd(XMM0, XMM1);
+      a.j(CondP, passed);
+      a.j(CondE, target);
+      a.bind(passed);
+      break;
+    }
+  }
+}
+
+void NativeCompiler::compare(const uint32_t* ip) {
+  get(RDI, ip[1]);
+  get(RSI, ip[2]);
+  Label done = a.label();
+  if (may_be_number(ip[1]) && may_be_number(ip[2])) {
+    Label other = a.label();
+    Label isFalse = a.label();
+    expect_number(RDI, ip[1], other);
+    expect_number(RSI, ip[2], other);
+    a.movsd(XMM0, RDI, numberOffset);
+    a.movsd(XMM1, RSI, numberOffset);
+    unless(static_cast<ComparisonOperatorType>(ip[3]), isFalse);
+    a.mov(RAX, trueValue);
+    a.jmp(done);
+    a.bind(isFalse);
+    a.mov(RAX, falseValue);
+    a.jmp(done);
+    a.bind(other);
+  }
+  a.mov(RDX, static_cast<uint64_t>(ip[3]));
+  a.call(reinterpret_cast<const void*>(&rt_compare));
+  a.bind(done);
+  put(ip[0], RAX);
+}
+
+// jumps to `target` unless `left op right`, falls through to `next` otherwise. `left` is in rdi already
+void NativeCompiler::branch(uint32_t left, uint32_t right, ComparisonOperatorType op, Label target, Label next) {
+  get(RSI, right);
+  if (may_be_number(left) && may_be_number(right)) {
+    Label other = a.label();
+    expect_number(RDI, left, other);
+    expect_number(RSI, right, other);
+    a.movsd(XMM0, RDI, numberOffset);
+    a.movsd(XMM1, RSI, numberOffset);
+    unless(op, target);
+    a.jmp(next);
+    a.bind(other);
+  }
+  a.mov(RDX, static_cast<uint64_t>(op));
+  a.call(reinterpret_cast<const void*>(&rt_test));
+  a.test_al();
+  a.j(CondE, target);
+}
+
+void NativeCompiler::increment(const uint32_t* ip) {
+  a.mov(RDI, R12);
+  a.mov(RSI, &chunk->refs[ip[2]]);
+  a.call(reinterpret_cast<const void*>(&rt_peek));
+  a.mov(RDI, RAX);
+  get(RSI, ip[3]);
+
+  Label other = a.label();
+  Label done = a.label();
+  a.cmp32(RDI, typeOffset, type_id(ValueType::Number));
+  a.j(CondNE, other);
+  a.movsd(XMM0, RDI, numberOffset);
+  a.addsd(XMM0, RSI, numberOffset);
+  a.call(reinterpret_cast<const void*>(&rt_number));
+  a.jmp(done);
+  a.bind(other);
+  a.call(reinterpret_cast<const void*>(&binary_other));
+  a.bind(done);
+
+  a.mov(RDI, R12);
+  a.mov(RSI, &chunk->refs[ip[1]]);
+  a.mov(RDX, RAX);
+  a.mov(RCX, static_cast<uint64_t>(0));
+  a.call(reinterpret_cast<const void*>(&rt_store));
+  put(ip[0], RAX);
+}
+
+// two numbers are computed inline and written into the NumberVal the variable owns
+void NativeCompiler::store_number(const uint32_t* ip) {
+  void (X64Assembler::*op)(Xmm, Reg, int32_t) = nullptr;
+  switch (static_cast<OperatorType>(ip[4])) {
+    case OperatorType::add: op = &X64Assembler::addsd; break;
+    case OperatorType::substract: op = &X64Assembler::subsd; break;
+    case OperatorType::multiply: op = &X64Assembler::mulsd; break;
+    case OperatorType::divide: op = &X64Assembler::divsd; break;
+    default: break; // modulo
+  }
+
+  get(RDX, ip[2]);
+  get(RCX, ip[3]);
+  Label done = a.label();
+  if (op != nullptr && may_be_number(ip[2]) && may_be_number(ip[3])) {
+    Label other = a.label();
+    expect_number(RDX, ip[2], other);
+    expect_number(RCX, ip[3], other);
+    a.movsd(XMM0, RDX, numberOffset);
+    (a.*op)(XMM0, RCX, numberOffset);
+    a.mov(RDI, R12);
+    a.mov(RSI, &chunk->refs[ip[1]]);
+    a.call(reinterpret_cast<const void*>(&rt_assign_number));
+    a.jmp(done);
+    a.bind(other);
+  }
+  a.mov(RDI, R12);
+  a.mov(RSI, &chunk->refs[ip[1]]);
+  a.mov(R8, static_cast<uint64_t>(ip[4]));
+  a.call(reinterpret_cast<const void*>(&rt_store_number));
+  a.bind(done);
+  put(ip[0], RAX);
+}
+
+void NativeCompiler::instruction(const uint32_t* ip, OpCode op, Label next) {
+  switch (op) {
+    case OpCode::Move:
+      get(RAX, ip[1]);
+      put(ip[0], RAX);
+      break;
+    case OpCode::Empty:
+      a.mov(RAX, emptyValue);
+      put(ip[0], RAX);
+      break;
+    case OpCode::Load:
+    case OpCode::LoadOuter:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[1]]);
+      a.call(reinterpret_cast<const void*>(op == OpCode::Load ? &rt_load : &rt_load_outer));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Peek:
+    case OpCode::PeekOuter:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[1]]);
+      a.call(reinterpret_cast<const void*>(op == OpCode::Peek ? &rt_peek : &rt_peek_outer));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Store:
+    case OpCode::Declare:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[1]]);
+      get(RDX, ip[0]);
+      a.mov(RCX, static_cast<uint64_t>(ip[2]));
+      a.call(reinterpret_cast<const void*>(op == OpCode::Store ? &rt_store : &rt_declare));
+      put(ip[0], RAX);
+      break;
+    case OpCode::StoreNumber:
+      store_number(ip);
+      break;
+    case OpCode::Array:
+      address(RDI, ip[1], ip[2]);
+      a.mov(RSI, static_cast<uint64_t>(ip[2]));
+      a.call(reinterpret_cast<const void*>(&rt_array));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Function:
+      a.mov(RDI, R12);
+      a.mov(RSI, chunk->nodes[ip[1]]);
+      a.call(reinterpret_cast<const void*>(&rt_function));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Call:
+    case OpCode::TailCall: // a plain call, past MAX_NATIVE_DEPTH the VM takes over and reuses frames
+      get(RDI, ip[1]);
+      address(RSI, ip[2], ip[3]);
+      a.mov(RDX, static_cast<uint64_t>(ip[3]));
+      a.call(reinterpret_cast<const void*>(&rt_call));
+      put(ip[0], RAX);
+      break;
+    case OpCode::CallMember:
+      get(RDI, ip[1]);
+      a.mov(RSI, static_cast<uint64_t>(ip[2]));
+      address(RDX, ip[3], ip[4]);
+      a.mov(RCX, static_cast<uint64_t>(ip[4]));
+      a.call(reinterpret_cast<const void*>(&rt_call_member));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Return:
+      get(RAX, ip[0]);
+      epilogue();
+      break;
+    case OpCode::Member:
+      get(RDI, ip[1]);
+      a.mov(RSI, static_cast<uint64_t>(ip[2]));
+      a.call(reinterpret_cast<const void*>(&rt_member));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Subscript:
+      get(RDI, ip[1]);
+      get(RSI, ip[2]);
+      a.call(reinterpret_cast<const void*>(&subscript));
+      put(ip[0], RAX);
+      break;
+    case OpCode::ExpectArray:
+    case OpCode::ExpectIndex:
+      get(RDI, ip[0]);
+      a.call(reinterpret_cast<const void*>(op == OpCode::ExpectArray ? &rt_expect_array : &rt_expect_index));
+      break;
+    case OpCode::StoreSubscript:
+      a.mov(RDI, R12);
+      get(RSI, ip[0]);
+      get(RDX, ip[1]);
+      get(RCX, ip[2]);
+      a.mov(R8, &chunk->refs[ip[3]]);
+      a.call(reinterpret_cast<const void*>(&rt_store_subscript));
+      break;
+    case OpCode::Add:
+      arithmetic(ip, &X64Assembler::addsd);
+      break;
+    case OpCode::Subtract:
+      arithmetic(ip, &X64Assembler::subsd);
+      break;
+    case OpCode::Multiply:
+      arithmetic(ip, &X64Assembler::mulsd);
+      break;
+    case OpCode::Divide:
+      arithmetic(ip, &X64Assembler::divsd);
+      break;
+    case OpCode::Modulo:
+      get(RDI, ip[1]);
+      get(RSI, ip[2]);
+      a.call(reinterpret_cast<const void*>(&rt_modulo));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Compare:
+      compare(ip);
+      break;
+    case OpCode::Logical:
+    case OpCode::Shift:
+      get(RDI, ip[1]);
+      get(RSI, ip[2]);
+      a.mov(RDX, static_cast<uint64_t>(ip[3]));
+      a.call(reinterpret_cast<const void*>(op == OpCode::Logical ? &rt_logical : &rt_shift));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Negate:
+      get(RDI, ip[1]);
+      a.call(reinterpret_cast<const void*>(&negate));
+      put(ip[0], RAX);
+      break;
+    case OpCode::Enter:
+      a.mov(RDI, R12);
+      a.mov(RSI, chunk->layouts[ip[0]]);
+      a.call(reinterpret_cast<const void*>(&rt_enter));
+      a.mov(R12, RAX);
+      break;
+    case OpCode::Leave:
+      a.mov(RDI, R12);
+      a.call(reinterpret_cast<const void*>(&rt_leave));
+      a.mov(R12, RAX);
+      break;
+    case OpCode::Jump:
+      a.jmp(at(ip[0]));
+      break;
+    case OpCode::JumpIfFalse:
+      get(RAX, ip[0]);
+      a.cmp32(RAX, typeOffset, type_id(ValueType::Boolean));
+      a.j(CondNE, notBoolean);
+      a.cmp8(RAX, booleanOffset, 0);
+      a.j(CondE, at(ip[1]));
+      break;
+    case OpCode::JumpIfFalsy: {
+      Label other = a.label();
+      get(RAX, ip[0]);
+      a.cmp32(RAX, typeOffset, type_id(ValueType::Boolean));
+      a.j(CondNE, other);
+      a.cmp8(RAX, booleanOffset, 0);
+      a.j(CondE, at(ip[1]));
+      a.jmp(next);
+      a.bind(other);
+      a.mov(RDI, RAX);
+      a.call(reinterpret_cast<const void*>(&rt_truthy));
+      a.test_al();
+      a.j(CondE, at(ip[1]));
+      break;
+    }
+    case OpCode::LoopResult:
+      get(RAX, ip[1]);
+      a.cmp32(RAX, typeOffset, type_id(ValueType::Break));
+      a.j(CondE, at(ip[2]));
+      a.cmp32(RAX, typeOffset, type_id(ValueType::Continue));
+      a.j(CondE, at(ip[3]));
+      put(ip[0], RAX);
+      break;
+    case OpCode::RangeStart:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[4]]);
+      address(RDX, ip[0], 1);
+      get(RCX, ip[1]);
+      get(R8, ip[2]);
+      get(R9, ip[3]);
+      a.call(reinterpret_cast<const void*>(&rt_range_start));
+      a.test_al();
+      a.j(CondE, at(ip[5]));
+      break;
+    case OpCode::RangeNext:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[3]]);
+      get(RDX, ip[0]);
+      get(RCX, ip[1]);
+      get(R8, ip[2]);
+      a.call(reinterpret_cast<const void*>(&rt_range_next));
+      a.test_al();
+      a.j(CondNE, at(ip[4]));
+      break;
+    case OpCode::ArrayStart:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[2]]);
+      address(RDX, ip[0], 1);
+      get(RCX, ip[1]);
+      a.call(reinterpret_cast<const void*>(&rt_array_start));
+      a.test_al();
+      a.j(CondE, at(ip[3]));
+      break;
+    case OpCode::ArrayNext:
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[2]]);
+      get(RDX, ip[0]);
+      get(RCX, ip[1]);
+      a.call(reinterpret_cast<const void*>(&rt_array_next));
+      a.test_al();
+      a.j(CondNE, at(ip[3]));
+      break;
+    case OpCode::Invariants:
+    case OpCode::DropInvariants:
+      a.mov(RDI, static_cast<uint64_t>(ip[0]));
+      a.call(reinterpret_cast<const void*>(op == OpCode::Invariants ? &rt_invariants : &rt_drop_invariants));
+      break;
+    case OpCode::InvariantStart:
+      a.mov(RDI, static_cast<uint64_t>(ip[1]));
+      a.call(reinterpret_cast<const void*>(&rt_invariant_start));
+      a.test(RAX);
+      a.j(CondE, next);
+      put(ip[0], RAX);
+      a.jmp(at(ip[2]));
+      break;
+    case OpCode::InvariantEnd:
+      get(RDI, ip[0]);
+      a.mov(RSI, static_cast<uint64_t>(ip[1]));
+      a.call(reinterpret_cast<const void*>(&rt_invariant_end));
+      break;
+    case OpCode::Match: {
+      a.mov(RDI, R12);
+      get(RSI, ip[0]);
+      a.mov(RDX, chunk->nodes[ip[1]]);
+      a.call(reinterpret_cast<const void*>(&rt_match));
+      a.mov(R12, RAX);
+      a.mov(RAX, &matchedCase);
+      const std::vector<uint32_t>& cases = chunk->tables[ip[2]];
+      for (uint32_t i = 0; i + 1 < cases.size(); i++) {
+        a.cmp32(RAX, 0, static_cast<int32_t>(i));
+        a.j(CondE, at(cases[i]));
+      }
+      a.jmp(at(cases.back()));
+      break;
+    }
+    case OpCode::Node:
+    case OpCode::NodeOuter:
+      a.mov(RDI, chunk->nodes[ip[1]]);
+      a.mov(RSI, R12);
+      a.call(reinterpret_cast<const void*>(op == OpCode::Node ? &rt_node : &rt_node_outer));
+      put(ip[0], RAX);
+      break;
+    case OpCode::BranchCompare:
+      get(RDI, ip[0]);
+      branch(ip[0], ip[1], static_cast<ComparisonOperatorType>(ip[2]), at(ip[3]), next);
+      break;
+    case OpCode::BranchCompareVar: {
+      a.mov(RDI, R12);
+      a.mov(RSI, &chunk->refs[ip[0]]);
+      a.call(reinterpret_cast<const void*>(ip[3] ? &rt_peek_outer : &rt_peek));
+      a.mov(RDI, RAX);
+      branch(NOT_A_REGISTER, ip[1], static_cast<ComparisonOperatorType>(ip[2]), at(ip[4]), next);
+      break;
+    }
+    case OpCode::IncrementVar:
+      increment(ip);
+      break;
+    default:
+      failed = true;
+  }
+}
+
+std::vector<uint8_t> NativeCompiler::compile() {
+  const std::vector<uint32_t>& code = chunk->code;
+  positions.assign(code.size() + 1, NO_LABEL);
+  for (size_t i = 0; i < code.size(); i += 1 + operand_count(static_cast<OpCode>(code[i]))) {
+    positions[i] = a.label();
+  }
+  positions[code.size()] = a.label();
+  notBoolean = a.label();
+
+  prologue(chunk->temporaries);
+  for (size_t i = 0; i < code.size() && !failed; ) {
+    OpCode op = static_cast<OpCode>(code[i]);
+    size_t next = i + 1 + operand_count(op);
+    a.bind(positions[i]);
+    instruction(&code[i + 1], op, positions[next]);
+    i = next;
+  }
+  a.bind(positions[code.size()]);
+  a.mov(RAX, emptyValue);
+  epilogue();
+
+  a.bind(notBoolean);
+  a.call(reinterpret_cast<const void*>(&rt_not_boolean));
+
+  if (failed) return {};
+  return a.finish();
+}
+
+// copies the code into memory that can be run, nullptr if the system doesn't allow that
+static void* install(const std::vector<uint8_t>& code) {
+  size_t size = (code.size() + 4095) / 4096 * 4096;
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) return nullptr;
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return nullptr;
+  }
+  return memory;
+}
+
+JitCode* jit_compile(Chunk* chunk) {
+  JitCode* jit = new JitCode();
+  if (!jitEnabled) return jit;
+  std::vector<uint8_t> code = NativeCompiler(chunk).compile();
+  if (!code.empty()) {
+    jit->entry = reinterpret_cast<RuntimeVal* (*)(Environment*, RuntimeVal*)>(install(code));
+  }
+  return jit;
+}
+
+RuntimeVal* jit_run(JitCode* code, Environment* scope, RuntimeVal* first) {
+  if (code->entry == nullptr || nativeDepth >= MAX_NATIVE_DEPTH || errors_captured()) return nullptr;
+
+  nativeDepth++;
+  RuntimeVal* result = code->entry(scope, first);
+  nativeDepth--;
+  return result;
+}
+
+#else
+
+JitCode* jit_compile(Chunk* chunk) {
+  return new JitCode();
+}
+
+RuntimeVal* jit_run(JitCode* code, Environment* scope, RuntimeVal* first) {
+  return nullptr;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#include "../../parsing/ast.hpp"
+#include "../Environment.hpp"
+
+/*
+Baseline JIT for x86-64 Linux, the top tier (tiers.hpp). A hot callable's chunk (the VM's
+bytecode, compiler.hpp), or the rest of a hot loop, is turned into machine code, one
+instruction after the other. Number arithmetic and comparisons, branches and loops are
+done inline with a type check in front. Everything else, and whatever fails a check, calls
+into the same runtime functions the VM uses (runtime.hpp). Nodes the VM leaves to the
+tree-walker stay with it, so a callable never has to be refused for what it contains.
+--no-jit turns it off. Elsewhere (or built with -DEAST_JIT=0) nothing gets compiled.
+*/
+
+#ifndef EAST_JIT
+#if defined(__x86_64__) && defined(__linux__)
+#define EAST_JIT 1
+#else
+#define EAST_JIT 0
+#endif
+#endif
+
+// entry == nullptr when the chunk couldn't be compiled, it stays interpreted then
+struct JitCode {
+  RuntimeVal* (*entry)(Environment* scope, RuntimeVal* first) = nullptr;
+};
+
+void set_jit_enabled(bool enabled);
+bool jit_enabled();
+
+// machine code for a chunk, its entry stays empty when the chunk has something the JIT
+// doesn't know (or the JIT is off). When to compile what is up to tiers.hpp
+JitCode* jit_compile(Chunk* chunk);
+
+// runs compiled code in `scope` with register 0 starting as `first`. nullptr when it can't,
+// because it wasn't compiled, the C stack is deep enough already or errors are captured
+RuntimeVal* jit_run(JitCode* code, Environment* scope, RuntimeVal* first = nullptr);
@@ -0,0 +1,192 @@
+#include "runtime.hpp"
+#include "compiler.hpp"
+#include "../interpreter.hpp"
+#include "../../Errors.hpp"
+#include <cmath>
+
+EmptyVal* const emptyValue = new EmptyVal();
+BooleanVal* const trueValue = MK_BOOL(true);
+BooleanVal* const falseValue = MK_BOOL(false);
+
+RuntimeVal* binary_other(RuntimeVal* left, RuntimeVal* right) {
+  if (left->type == ValueType::String && right->type == ValueType::String) {
+    return MK_STRING(static_cast<StringVal*>(left)->value + static_cast<StringVal*>(right)->value);
+  }
+  return emptyValue;
+}
+
+RuntimeVal* store_number(Environment* env, const NamedRef& named, RuntimeVal* left, RuntimeVal* right, OperatorType op) {
+  if (!both_numbers(left, right)) return env->assignRef(named.ref, named.symbol, binary_other(left, right));
+
+  double a = number(left);
+  double b = number(right);
+  double result = 0;
+  switch (op) {
+    case OperatorType::add: result = a + b; break;
+    case OperatorType::substract: result = a - b; break;
+    case OperatorType::multiply: result = a * b; break;
+    case OperatorType::divide: result = a / b; break;
+    case OperatorType::modulo: result = std::fmod(a, b); break;
+  }
+  return env->assignNumber(named.ref, named.symbol, result);
+}
+
+bool range_start(Environment* env, const NamedRef& named, RuntimeVal** counter, RuntimeVal* start, RuntimeVal* end, RuntimeVal* step) {
+  Range range = make_range(start, end, step);
+  *counter = MK_NUM(range.start);
+  if (!range.has(range.start)) return false;
+  env->assignNumber(named.ref, named.symbol, range.start, true);
+  return true;
+}
+
+bool range_next(Environment* env, const NamedRef& named, RuntimeVal* counter, RuntimeVal* end, RuntimeVal* step) {
+  NumberVal* i = static_cast<NumberVal*>(counter);
+  i->value += number(step);
+  if (!Range{ 0, number(end), number(step) }.has(i->value)) return false;
+  env->assignNumber(named.ref, named.symbol, i->value, true);
+  return true;
+}
+
+// element `index` of the array to the variable, false past its end
+static bool array_element(Environment* env, const NamedRef& named, double index, RuntimeVal* array) {
+  const std::vector<RuntimeVal*>& elements = static_cast<ArrayVal*>(array)->elements;
+  if (index >= elements.size()) return false;
+  env->assignRef(named.ref, named.symbol, elements[static_cast<size_t>(index)], true);
+  return true;
+}
+
+bool array_start(Environment* env, const NamedRef& named, RuntimeVal** counter, RuntimeVal* array) {
+  for_array(array);
+  *counter = MK_NUM(0);
+  return array_element(env, named, 0, array);
+}
+
+bool array_next(Environment* env, const NamedRef& named, RuntimeVal* counter, RuntimeVal* array) {
+  NumberVal* index = static_cast<NumberVal*>(counter);
+  index->value++;
+  return array_element(env, named, index->value, array);
+}
+
+RuntimeVal* negate(RuntimeVal* value) {
+  switch (value->type) {
+    case ValueType::Boolean:
+      return boolean(!static_cast<BooleanVal*>(value)->value);
+    case ValueType::Number:
+      return boolean(!number(value));
+    case ValueType::Empty:
+      return trueValue;
+    default:
+      return falseValue;
+  }
+}
+
+RuntimeVal* subscript(RuntimeVal* left, RuntimeVal* index) {
+  switch (left->type) {
+    case ValueType::Array: {
+      if (index->type != ValueType::Number) raise_error("array index must be a number");
+      std::vector<RuntimeVal*>& elements = static_cast<ArrayVal*>(left)->elements;
+      int arrayIndex = (int)number(index);
+      if (arrayIndex < 0 || static_cast<size_t>(arrayIndex) >= elements.size()) raise_error("array index out of range");
+      return elements[arrayIndex];
+    }
+    case ValueType::String: {
+      if (index->type != ValueType::Number) raise_error("string index must be a number");
+      const std::string& string = static_cast<StringVal*>(left)->value;
+      int stringIndex = (int)number(index);
+      if (stringIndex < 0 || static_cast<size_t>(stringIndex) >= string.size()) raise_error("string index out of range");
+      return MK_STRING(std::string(1, string[stringIndex]));
+    }
+    default:
+      raise_error("can't substring this type");
+  }
+}
+
+void store_subscript(Environment* env, RuntimeVal* value, RuntimeVal* array, RuntimeVal* index, Symbol symbol) {
+  ArrayVal* arrayVal = static_cast<ArrayVal*>(array);
+  int at = (int)number(index);
+  if (at < 0 || static_cast<size_t>(at) >= arrayVal->elements.size()) raise_error("array index out of range");
+
+  arrayVal->elements[at] = value;
+  heapEpoch++;
+  env->overrideVar(symbol, arrayVal);
+}
+
+FunctionVal* make_function(FunctionDeclaration* funcDec, Environment* env) {
+  FunctionVal* func = new FunctionVal();
+  func->declarationEnv = env;
+  func->parameters = funcDec->parameters;
+  func->body = funcDec->body;
+  func->layout = funcDec->layout;
+  func->declaration = funcDec;
+  return func;
+}
+
+Environment* call_scope(FunctionVal* func, RuntimeVal** args, size_t argc, Environment* reuse) {
+  if (argc < func->parameters.size()) raise_error("Not enough arguments for the callable");
+
+  Environment* scope = reuse;
+  if (scope != nullptr) {
+    scope->reuse(func->declarationEnv, func->layout);
+  } else {
+    scope = new Environment(func->declarationEnv, func->layout);
+  }
+  const ScopeLayout* layout = func->layout;
+  for (uint32_t i = 0; i < func->parameters.size(); i++) {
+    if (layout != nullptr && layout->slots[i].symbol == func->parameters[i]) {
+      scope->declareRef(VarRef{layout, 0, i}, func->parameters[i], args[i], false);
+    } else {
+      scope->declareVar(func->parameters[i], args[i], false);
+    }
+  }
+  return scope;
+}
+
+bool test(RuntimeVal* left, RuntimeVal* right, ComparisonOperatorType op) {
+  if (!both_numbers(left, right)) {
+    if (left->type == ValueType::String && right->type == ValueType::String) {
+      const std::string& a = static_cast<StringVal*>(left)->value;
+      const std::string& b = static_cast<StringVal*>(right)->value;
+      if (op == ComparisonOperatorType::equal) return a == b;
+      if (op == ComparisonOperatorType::not_equal) return a != b;
+    }
+    return static_cast<BooleanVal*>(eval_comparison_expr(left, right, op))->value;
+  }
+  double a = number(left);
+  double b = number(right);
+  switch (op) {
+    case ComparisonOperatorType::equal: return a == b;
+    case ComparisonOperatorType::not_equal: return a != b;
+    case ComparisonOperatorType::greater: return a > b;
+    case ComparisonOperatorType::greater_equal: return a >= b;
+    case ComparisonOperatorType::less: return a < b;
+    case ComparisonOperatorType::less_equal: return a <= b;
+  }
+  raise_error("invalid operator");
+}
+
+RuntimeVal* call_native(NativeFnVal* nativefn, RuntimeVal** args, size_t argc) {
+  if (nativefn->purity != Purity::Pure) uncachedCalls++;
+  if (nativefn->purity == Purity::Mutating) heapEpoch++;
+  return nativefn->call(std::vector<RuntimeVal*>(args, args + argc));
+}
+
+Chunk* function_chunk(FunctionVal* func) {
+  FunctionDeclaration* funcDec = func->declaration;
+  if (funcDec->chunk == nullptr) funcDec->chunk = compile_chunk(funcDec->body);
+  return funcDec->chunk;
+}
+
+RuntimeVal* kept_value(KeptValue& kept) {
+  if (kept.value != nullptr && kept.epoch == heapEpoch) return kept.value;
+  kept.startEpoch = heapEpoch;
+  kept.startCalls = uncachedCalls;
+  return nullptr;
+}
+
+void keep_value(KeptValue& kept, RuntimeVal* value) {
+  // arrays can be changed through the value itself, every iteration needs its own
+  if (heapEpoch == kept.startEpoch && uncachedCalls == kept.startCalls && value->type != ValueType::Array) {
+    kept.value = value;
+    kept.epoch = heapEpoch;
+  }
+}
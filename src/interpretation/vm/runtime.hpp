@@ -0,0 +1,73 @@
+#pragma once
+#include "bytecode.hpp"
+#include "../Environment.hpp"
+
+// What the VM's instructions do once they have their operands, shared with the JIT (jit.hpp)
+// whose machine code calls these for everything it doesn't do inline
+
+// values are never changed once made, one of each is enough
+extern EmptyVal* const emptyValue;
+extern BooleanVal* const trueValue;
+extern BooleanVal* const falseValue;
+
+inline BooleanVal* boolean(bool value) {
+  return value ? trueValue : falseValue;
+}
+
+inline bool both_numbers(RuntimeVal* left, RuntimeVal* right) {
+  return left->type == ValueType::Number && right->type == ValueType::Number;
+}
+
+inline double number(RuntimeVal* value) {
+  return static_cast<NumberVal*>(value)->value;
+}
+
+// the rest of eval_binary_expr, for anything that isn't two numbers
+RuntimeVal* binary_other(RuntimeVal* left, RuntimeVal* right);
+
+// StoreNumber: two numbers go into the NumberVal the variable owns (Environment::assignNumber),
+// anything else is assigned like Store does
+RuntimeVal* store_number(Environment* env, const NamedRef& named, RuntimeVal* left, RuntimeVal* right, OperatorType op);
+
+// for loops (RangeStart, ArrayStart and their Next): `counter` is a NumberVal of the loop's
+// own holding the range's number or the array's index. They assign the loop's variable and
+// give false once there's nothing left
+bool range_start(Environment* env, const NamedRef& named, RuntimeVal** counter, RuntimeVal* start, RuntimeVal* end, RuntimeVal* step);
+bool range_next(Environment* env, const NamedRef& named, RuntimeVal* counter, RuntimeVal* end, RuntimeVal* step);
+bool array_start(Environment* env, const NamedRef& named, RuntimeVal** counter, RuntimeVal* array);
+bool array_next(Environment* env, const NamedRef& named, RuntimeVal* counter, RuntimeVal* array);
+
+RuntimeVal* negate(RuntimeVal* value);
+
+RuntimeVal* subscript(RuntimeVal* left, RuntimeVal* index);
+
+// array[index] = value, `array` is the variable's value and gets assigned back to it
+void store_subscript(Environment* env, RuntimeVal* value, RuntimeVal* array, RuntimeVal* index, Symbol symbol);
+
+FunctionVal* make_function(FunctionDeclaration* funcDec, Environment* env);
+
+// the callable's scope with the arguments bound. A tail call hands over its caller's scope in
+// `reuse` when nothing else can still see it (CallExpr::reuseScope)
+Environment* call_scope(FunctionVal* func, RuntimeVal** args, size_t argc, Environment* reuse = nullptr);
+
+// `left op right` without making a boolean when it can
+bool test(RuntimeVal* left, RuntimeVal* right, ComparisonOperatorType op);
+
+RuntimeVal* call_native(NativeFnVal* nativefn, RuntimeVal** args, size_t argc);
+
+// the callable's body as bytecode, compiled the first time it's needed
+Chunk* function_chunk(FunctionVal* func);
+
+// a loop invariant value, like the tree-walker's InvariantSlot
+struct KeptValue {
+  RuntimeVal* value = nullptr;
+  uint64_t epoch = 0;
+  uint64_t startEpoch = 0; // when the value started being computed
+  uint64_t startCalls = 0;
+};
+
+// the kept value while it's still good, otherwise nullptr and the value is about to be computed
+RuntimeVal* kept_value(KeptValue& kept);
+
+// keeps the computed value if nothing could have changed it in the meantime
+void keep_value(KeptValue& kept, RuntimeVal* value);
@@ -0,0 +1,222 @@
+#include "tiers.hpp"
+#include "compiler.hpp"
+#include "runtime.hpp"
+#include "jit.hpp"
+#include "vm.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static TierThresholds thresholds;
+static bool tierStats = false;
+
+// what moved up, for the summary
+static std::vector<FunctionDeclaration*> tieredCallables;
+static std::vector<WhileStatement*> tieredLoops;
+
+void set_tier_thresholds(const TierThresholds& t) {
+  thresholds = t;
+}
+
+const TierThresholds& tier_thresholds() {
+  return thresholds;
+}
+
+void set_tier_stats(bool enabled) {
+  tierStats = enabled;
+}
+
+/*
+NAMES FOR THE STATS
+*/
+static const char* tier_name(Tier tier) {
+  switch (tier) {
+    case Tier::TreeWalker: return "tree-walker";
+    case Tier::VM: return "vm";
+    case Tier::Native: return "machine code";
+  }
+  return "?";
+}
+
+static std::string callable_name(const FunctionDeclaration* funcDec) {
+  if (funcDec->name == SYM_EMPTY) return "(anonymous callable)";
+  return symbol_name(funcDec->name);
+}
+
+// the check written out again, loops have no names and nodes no line numbers
+static void describe(std::ostream& out, Expr* node) {
+  switch (node->kind) {
+    case NodeType::Identifier:
+      out << symbol_name(static_cast<Identifier*>(node)->symbol);
+      return;
+    case NodeType::NumberLiteral:
+      out << std::setprecision(15) << static_cast<NumberLiteral*>(node)->value;
+      return;
+    case NodeType::StringLiteral:
+      out << '"' << static_cast<StringLiteral*>(node)->value << '"';
+      return;
+    case NodeType::BooleanLiteral:
+      out << (static_cast<BooleanLiteral*>(node)->value ? "true" : "false");
+      return;
+    case NodeType::InvariantExpr:
+      describe(out, static_cast<InvariantExpr*>(node)->expr);
+      return;
+    case NodeType::NegateExpr:
+      out << "not ";
+      describe(out, static_cast<NegateExpr*>(node)->expr);
+      return;
+    case NodeType::BinaryExpr: {
+      static const char* ops[] = { " + ", " - ", " * ", " / ", " % " };
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      describe(out, binary->left);
+      out << ops[static_cast<int>(binary->expr_operator)];
+      describe(out, binary->right);
+      return;
+    }
+    case NodeType::ComparisonExpr: {
+      static const char* ops[] = { " == ", " != ", " >= ", " > ", " <= ", " < " };
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      describe(out, comparison->left);
+      out << ops[static_cast<int>(comparison->op)];
+      describe(out, comparison->right);
+      return;
+    }
+    case NodeType::LogicalExpr: {
+      static const char* ops[] = { " and ", " or ", " xor " };
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      describe(out, logical->left);
+      out << ops[static_cast<int>(logical->op)];
+      describe(out, logical->right);
+      return;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      describe(out, member->left);
+      out << '.' << symbol_name(member->identifier);
+      return;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* subscript = static_cast<SubscriptExpr*>(node);
+      describe(out, subscript->left);
+      out << '[';
+      describe(out, subscript->value);
+      out << ']';
+      return;
+    }
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(node);
+      describe(out, call->caller);
+      out << '(';
+      for (size_t i = 0; i < call->args.size(); i++) {
+        if (i > 0) out << ", ";
+        describe(out, call->args[i]);
+      }
+      out << ')';
+      return;
+    }
+    default:
+      out << "...";
+  }
+}
+
+static std::string loop_name(WhileStatement* whileStmt) {
+  std::ostringstream out;
+  out << "while ";
+  describe(out, whileStmt->check);
+  return out.str();
+}
+
+static void report(const std::string& message) {
+  if (tierStats) std::cerr << "[tier] " + message + "\n";
+}
+
+void print_tier_stats() {
+  if (!tierStats) return;
+  report("thresholds: vm after " + std::to_string(thresholds.vm) + " calls, machine code after " +
+    std::to_string(thresholds.native) + " calls, loops after " + std::to_string(thresholds.loop) +
+    " iterations (0 is never)");
+  for (FunctionDeclaration* funcDec : tieredCallables) {
+    report(callable_name(funcDec) + ": " + std::to_string(funcDec->calls) + " calls, " + tier_name(funcDec->tier));
+  }
+  for (WhileStatement* whileStmt : tieredLoops) {
+    report(loop_name(whileStmt) + ": " + tier_name(whileStmt->tier) + " from iteration " +
+      std::to_string(whileStmt->iterations + 1));
+  }
+}
+
+/*
+MOVING UP
+*/
+static void move_up(FunctionDeclaration* funcDec, Tier tier) {
+  if (std::find(tieredCallables.begin(), tieredCallables.end(), funcDec) == tieredCallables.end()) {
+    tieredCallables.push_back(funcDec);
+  }
+  funcDec->tier = tier;
+  report(callable_name(funcDec) + ": " + tier_name(tier) + " after " + std::to_string(funcDec->calls) + " calls");
+}
+
+// counts the call and moves the callable up when it's hot enough, gives the tier it's at
+static Tier count_call(FunctionVal* func) {
+  FunctionDeclaration* funcDec = func->declaration;
+  uint64_t calls = ++funcDec->calls;
+  if (funcDec->tier == Tier::Native) return Tier::Native;
+
+  // the VM runs it anyway, that's not worth a message
+  if (funcDec->tier == Tier::TreeWalker && vm_enabled()) funcDec->tier = Tier::VM;
+
+  if (thresholds.native > 0 && calls >= thresholds.native && funcDec->jit == nullptr && jit_enabled()) {
+    funcDec->jit = jit_compile(function_chunk(func));
+    if (funcDec->jit->entry != nullptr) {
+      move_up(funcDec, Tier::Native);
+      return Tier::Native;
+    }
+    report(callable_name(funcDec) + ": the jit can't compile it, stays on the " + tier_name(funcDec->tier));
+  }
+  if (funcDec->tier == Tier::TreeWalker && thresholds.vm > 0 && calls >= thresholds.vm) {
+    move_up(funcDec, Tier::VM);
+  }
+  return funcDec->tier;
+}
+
+RuntimeVal* tiered_call(FunctionVal* func, Environment* scope) {
+  Tier tier = count_call(func);
+  if (tier == Tier::TreeWalker) return nullptr;
+  if (tier == Tier::Native) {
+    if (RuntimeVal* result = jit_run(func->declaration->jit, scope)) return result;
+  }
+  // too deep for machine code, the VM keeps its frames on the heap
+  return run_chunk(function_chunk(func), scope);
+}
+
+RuntimeVal* native_call(FunctionVal* func, Environment* scope) {
+  if (count_call(func) != Tier::Native) return nullptr;
+  return jit_run(func->declaration->jit, scope);
+}
+
+RuntimeVal* tiered_loop(WhileStatement* whileStmt, Environment* scope, RuntimeVal* value) {
+  if (whileStmt->tier == Tier::TreeWalker) {
+    // a chunk but no tier: there was nothing to move to
+    if (thresholds.loop == 0 || whileStmt->chunk != nullptr) return nullptr;
+    if (++whileStmt->iterations < thresholds.loop) return nullptr;
+
+    whileStmt->chunk = compile_loop(whileStmt);
+    if (thresholds.native > 0 && jit_enabled()) whileStmt->jit = jit_compile(whileStmt->chunk);
+    if (whileStmt->jit != nullptr && whileStmt->jit->entry != nullptr) {
+      whileStmt->tier = Tier::Native;
+    } else if (thresholds.vm > 0) {
+      whileStmt->tier = Tier::VM;
+    } else {
+      return nullptr;
+    }
+    tieredLoops.push_back(whileStmt);
+    report(loop_name(whileStmt) + ": " + tier_name(whileStmt->tier) + " after " +
+      std::to_string(whileStmt->iterations) + " iterations (on-stack replacement)");
+  }
+  if (whileStmt->tier == Tier::Native) {
+    if (RuntimeVal* result = jit_run(whileStmt->jit, scope, value)) return result;
+  }
+  return run_chunk(whileStmt->chunk, scope, value);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include "../../parsing/ast.hpp"
+#include "../Environment.hpp"
+
+/*
+Tiered execution. Everything starts out on the tree-walker (interpreter.cpp), which costs
+nothing up front. Callables count their calls: after `vm` calls one runs on the VM (vm.hpp)
+and after `native` calls it's compiled to machine code (jit.hpp). Closures made from the
+same callable share one count, their bodies are the same code.
+
+A program spends most of its time in loops that are only entered once, so loops count
+their iterations too. A tree-walked while that gets past `loop` iterations is replaced while
+it runs (on-stack replacement): the rest of it, from the next check on, is compiled with
+compile_loop and finishes as machine code, or on the VM if the JIT can't have it. Its
+variables are in the loop's Environment already, so nothing has to be moved.
+
+A threshold of 0 turns that step off. With --vm callables start out on the VM, --no-jit
+leaves out the machine code. --tier-stats prints when something moves up and a summary at
+the end, to stderr.
+*/
+
+#ifndef EAST_VM_THRESHOLD
+#define EAST_VM_THRESHOLD 2
+#endif
+
+#ifndef EAST_JIT_THRESHOLD
+#define EAST_JIT_THRESHOLD 20
+#endif
+
+#ifndef EAST_OSR_THRESHOLD
+#define EAST_OSR_THRESHOLD 1000
+#endif
+
+struct TierThresholds {
+  uint32_t vm = EAST_VM_THRESHOLD; // calls
+  uint32_t native = EAST_JIT_THRESHOLD; // calls, counted from the first one
+  uint32_t loop = EAST_OSR_THRESHOLD; // iterations of one loop, over every time it ran
+};
+
+void set_tier_thresholds(const TierThresholds& thresholds);
+const TierThresholds& tier_thresholds();
+
+void set_tier_stats(bool enabled);
+void print_tier_stats();
+
+// the tree-walker's calls: counts it and runs the body on the tier it's at,
+// nullptr while that's still the tree-walker
+RuntimeVal* tiered_call(FunctionVal* func, Environment* scope);
+
+// the VM's calls: counts it and runs it as machine code if it got there, nullptr otherwise
+RuntimeVal* native_call(FunctionVal* func, Environment* scope);
+
+// after each iteration of a tree-walked loop, with the loop's scope and its value so far.
+// Once the loop is hot, runs the rest of it on a faster tier and gives the loop's value,
+// nullptr to keep walking
+RuntimeVal* tiered_loop(WhileStatement* whileStmt, Environment* scope, RuntimeVal* value);
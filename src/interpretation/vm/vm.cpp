@@ -0,0 +1,541 @@
+#include "vm.hpp"
+#include "compiler.hpp"
+#include "runtime.hpp"
+#include "jit.hpp"
+#include "tiers.hpp"
+#include "../interpreter.hpp"
+#include "../../Errors.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+static bool vmEnabled = false;
+static size_t stackBudget = static_cast<size_t>(EAST_STACK_BUDGET) << 20;
+static bool instructionCounting = false;
+static uint64_t instructionsRun = 0;
+
+void set_vm_enabled(bool enabled) {
+  vmEnabled = enabled;
+}
+
+bool vm_enabled() {
+  return vmEnabled;
+}
+
+void set_stack_budget(size_t megabytes) {
+  stackBudget = megabytes << 20;
+}
+
+// what all calls in progress take together, only the main thread runs code
+static size_t stackInUse = 0;
+
+static void charge_stack(size_t bytes) {
+  if (stackInUse + bytes > stackBudget) {
+    raise_error("Stack overflow: the calls took up more than the " + std::to_string(stackBudget >> 20) + " MB --stack-budget");
+  }
+  stackInUse += bytes;
+}
+
+size_t scope_bytes(const FunctionVal* func) {
+  size_t slots = func->layout != nullptr ? func->layout->slots.size() : 0;
+  return sizeof(Environment) + slots * sizeof(VarSlot);
+}
+
+StackCharge::StackCharge(size_t bytes): bytes(bytes) {
+  charge_stack(bytes);
+}
+
+StackCharge::~StackCharge() {
+  stackInUse -= bytes;
+}
+
+void set_vm_instruction_counting(bool enabled) {
+  instructionCounting = enabled;
+}
+
+uint64_t vm_instructions_run() {
+  return instructionsRun;
+}
+
+// what a call saves to come back to
+struct CallFrame {
+  Chunk* chunk;
+  const uint32_t* ip;
+  Environment* env;
+  size_t base; // first register of the frame
+  uint32_t dst; // where the result goes
+  size_t charge; // what the callee took from the stack budget
+};
+
+class VM {
+  private:
+    std::vector<RuntimeVal*> registers; // the frames' windows, one after the other
+    std::vector<CallFrame> frames;
+    std::vector<KeptValue> invariants;
+    size_t charged = 0; // taken from the stack budget by the frames on this VM
+
+    RuntimeVal** enter(Chunk* chunk, size_t base);
+    size_t charge(Chunk* chunk, size_t scope);
+
+  public:
+    ~VM() {
+      stackInUse -= charged;
+    }
+
+    template <bool Counting>
+    RuntimeVal* run(Chunk* entry, Environment* env, RuntimeVal* first = nullptr);
+};
+
+// makes room for the frame's registers and puts the constants in, returns its window
+RuntimeVal** VM::enter(Chunk* chunk, size_t base) {
+  if (registers.size() < base + chunk->frame_size()) registers.resize(base + chunk->frame_size());
+  RuntimeVal** regs = registers.data() + base;
+  std::copy(chunk->constants.begin(), chunk->constants.end(), regs + chunk->temporaries);
+  return regs;
+}
+
+// takes what a frame of `chunk` and its scope need from the stack budget, gives how much
+size_t VM::charge(Chunk* chunk, size_t scope) {
+  size_t bytes = chunk->frame_size() * sizeof(RuntimeVal*) + sizeof(CallFrame) + scope;
+  charge_stack(bytes);
+  charged += bytes;
+  return bytes;
+}
+
+// labels as values are a GNU extension, -DEAST_THREADED_DISPATCH=0 forces the switch
+#ifndef EAST_THREADED_DISPATCH
+#if defined(__GNUC__) || defined(__clang__)
+#define EAST_THREADED_DISPATCH 1
+#else
+#define EAST_THREADED_DISPATCH 0
+#endif
+#endif
+
+template <bool Counting>
+RuntimeVal* VM::run(Chunk* entry, Environment* env, RuntimeVal* first) {
+  Chunk* chunk = entry;
+  const uint32_t* ip = chunk->code.data();
+  size_t base = 0;
+  check_native_stack();
+  charge(chunk, 0); // the scope belongs to whoever handed the chunk over
+  RuntimeVal** regs = enter(chunk, base);
+  if (chunk->temporaries > 0) regs[0] = first;
+
+  // what the Call instructions hand over to `call`
+  RuntimeVal* callee;
+  RuntimeVal** args;
+  uint32_t argc;
+  uint32_t dst;
+
+#if EAST_THREADED_DISPATCH
+  static const void* handlers[] = {
+#define EAST_OPCODE_LABEL(name, operands) &&op_##name,
+    EAST_OPCODES(EAST_OPCODE_LABEL)
+#undef EAST_OPCODE_LABEL
+  };
+#define HANDLER(name) op_##name
+#define DISPATCH() do { if (Counting) instructionsRun++; goto *handlers[*ip++]; } while (0)
+  DISPATCH();
+#else
+#define HANDLER(name) case OpCode::name
+#define DISPATCH() goto dispatch
+dispatch:
+  if (Counting) instructionsRun++;
+  switch (static_cast<OpCode>(*ip++)) {
+#endif
+
+  HANDLER(Move): {
+    regs[ip[0]] = regs[ip[1]];
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(Empty): {
+    regs[*ip++] = emptyValue;
+    DISPATCH();
+  }
+  HANDLER(Load): {
+    const NamedRef& named = chunk->refs[ip[1]];
+    regs[ip[0]] = env->lookupRef(named.ref, named.symbol);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(LoadOuter): {
+    const NamedRef& named = chunk->refs[ip[1]];
+    regs[ip[0]] = env->parent()->lookupRef(named.ref, named.symbol);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(Peek): {
+    const NamedRef& named = chunk->refs[ip[1]];
+    regs[ip[0]] = env->peekRef(named.ref, named.symbol);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(PeekOuter): {
+    const NamedRef& named = chunk->refs[ip[1]];
+    regs[ip[0]] = env->parent()->peekRef(named.ref, named.symbol);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(Store): {
+    const NamedRef& named = chunk->refs[ip[1]];
+    regs[ip[0]] = env->assignRef(named.ref, named.symbol, regs[ip[0]], ip[2]);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(StoreNumber): {
+    regs[ip[0]] = store_number(env, chunk->refs[ip[1]], regs[ip[2]], regs[ip[3]], static_cast<OperatorType>(ip[4]));
+    ip += 5;
+    DISPATCH();
+  }
+  HANDLER(Declare): {
+    const NamedRef& named = chunk->refs[ip[1]];
+    regs[ip[0]] = env->declareRef(named.ref, named.symbol, regs[ip[0]], ip[2]);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Array): {
+    ArrayVal* array = new ArrayVal();
+    array->elements.assign(regs + ip[1], regs + ip[1] + ip[2]);
+    regs[ip[0]] = array;
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Function): {
+    regs[ip[0]] = make_function(static_cast<FunctionDeclaration*>(chunk->nodes[ip[1]]), env);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(Call): {
+    dst = ip[0];
+    callee = regs[ip[1]];
+    args = regs + ip[2];
+    argc = ip[3];
+    ip += 4;
+    goto call;
+  }
+  HANDLER(TailCall): {
+    callee = regs[ip[1]];
+    if (callee->type != ValueType::Function) {
+      // natives never take a frame
+      dst = ip[0];
+      args = regs + ip[2];
+      argc = ip[3];
+      ip += 5;
+      goto call;
+    }
+    FunctionVal* func = static_cast<FunctionVal*>(callee);
+    uncachedCalls++;
+    heapEpoch++;
+    Environment* reuse = nullptr;
+    if (ip[4] != NO_REUSE) {
+      reuse = env;
+      for (uint32_t i = 0; i < ip[4]; i++) reuse = reuse->parent();
+    }
+    Environment* scope = call_scope(func, regs + ip[2], ip[3], reuse);
+    if (RuntimeVal* result = native_call(func, scope)) {
+      regs[ip[0]] = result;
+      ip += 5;
+      DISPATCH();
+    }
+
+    // the callee runs in this frame, it returns to where this one would have
+    chunk = function_chunk(func);
+    regs = enter(chunk, base);
+    ip = chunk->code.data();
+    env = scope;
+    DISPATCH();
+  }
+  HANDLER(CallMember): {
+    RuntimeVal* module = regs[ip[1]];
+    if (module->type != ValueType::Module) raise_error("Unsuported type for member (dot) Expr");
+    dst = ip[0];
+    callee = static_cast<ModuleVal*>(module)->moduleEnv->lookupVar(ip[2]);
+    args = regs + ip[3];
+    argc = ip[4];
+    ip += 5;
+    goto call;
+  }
+  HANDLER(Return): {
+    RuntimeVal* result = regs[*ip];
+    if (frames.empty()) return result;
+
+    const CallFrame& caller = frames.back();
+    chunk = caller.chunk;
+    ip = caller.ip;
+    env = caller.env;
+    base = caller.base;
+    regs = registers.data() + base;
+    regs[caller.dst] = result;
+    stackInUse -= caller.charge;
+    charged -= caller.charge;
+    frames.pop_back();
+    DISPATCH();
+  }
+  HANDLER(Member): {
+    RuntimeVal* left = regs[ip[1]];
+    if (left->type != ValueType::Module) raise_error("Unsuported type for member (dot) Expr");
+    regs[ip[0]] = static_cast<ModuleVal*>(left)->moduleEnv->lookupVar(ip[2]);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Subscript): {
+    regs[ip[0]] = subscript(regs[ip[1]], regs[ip[2]]);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(ExpectArray): {
+    if (regs[*ip++]->type != ValueType::Array) raise_error("cannot subscript assing a non-array");
+    DISPATCH();
+  }
+  HANDLER(ExpectIndex): {
+    if (regs[*ip++]->type != ValueType::Number) raise_error("cannot subscript using a non-number");
+    DISPATCH();
+  }
+  HANDLER(StoreSubscript): {
+    store_subscript(env, regs[ip[0]], regs[ip[1]], regs[ip[2]], chunk->refs[ip[3]].symbol);
+    ip += 4;
+    DISPATCH();
+  }
+  HANDLER(Add): {
+    RuntimeVal* left = regs[ip[1]];
+    RuntimeVal* right = regs[ip[2]];
+    regs[ip[0]] = both_numbers(left, right) ? MK_NUM(number(left) + number(right)) : binary_other(left, right);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Subtract): {
+    RuntimeVal* left = regs[ip[1]];
+    RuntimeVal* right = regs[ip[2]];
+    regs[ip[0]] = both_numbers(left, right) ? MK_NUM(number(left) - number(right)) : binary_other(left, right);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Multiply): {
+    RuntimeVal* left = regs[ip[1]];
+    RuntimeVal* right = regs[ip[2]];
+    regs[ip[0]] = both_numbers(left, right) ? MK_NUM(number(left) * number(right)) : binary_other(left, right);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Divide): {
+    RuntimeVal* left = regs[ip[1]];
+    RuntimeVal* right = regs[ip[2]];
+    regs[ip[0]] = both_numbers(left, right) ? MK_NUM(number(left) / number(right)) : binary_other(left, right);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Modulo): {
+    RuntimeVal* left = regs[ip[1]];
+    RuntimeVal* right = regs[ip[2]];
+    regs[ip[0]] = both_numbers(left, right) ? MK_NUM(std::fmod(number(left), number(right))) : binary_other(left, right);
+    ip += 3;
+    DISPATCH();
+  }
+  HANDLER(Compare): {
+    regs[ip[0]] = boolean(test(regs[ip[1]], regs[ip[2]], static_cast<ComparisonOperatorType>(ip[3])));
+    ip += 4;
+    DISPATCH();
+  }
+  HANDLER(Logical): {
+    regs[ip[0]] = eval_logical_expr(regs[ip[1]], regs[ip[2]], static_cast<LogicalOperatorType>(ip[3]));
+    ip += 4;
+    DISPATCH();
+  }
+  HANDLER(Negate): {
+    regs[ip[0]] = negate(regs[ip[1]]);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(Shift): {
+    RuntimeVal* left = regs[ip[1]];
+    RuntimeVal* right = regs[ip[2]];
+    if (!both_numbers(left, right)) raise_error("can't use bitshift with non-number values");
+    regs[ip[0]] = MK_NUM(ip[3] ? (int)number(left) >> (int)number(right) : (int)number(left) << (int)number(right));
+    ip += 4;
+    DISPATCH();
+  }
+  HANDLER(Enter): {
+    env = new Environment(env, chunk->layouts[*ip++]);
+    DISPATCH();
+  }
+  HANDLER(Leave): {
+    env = env->parent();
+    DISPATCH();
+  }
+  HANDLER(Jump): {
+    ip = chunk->code.data() + *ip;
+    DISPATCH();
+  }
+  HANDLER(JumpIfFalse): {
+    RuntimeVal* check = regs[ip[0]];
+    if (check->type != ValueType::Boolean) raise_error("if checks only support boolean values");
+    ip = static_cast<BooleanVal*>(check)->value ? ip + 2 : chunk->code.data() + ip[1];
+    DISPATCH();
+  }
+  HANDLER(JumpIfFalsy): {
+    ip = eval_runtimeval_to_bool(regs[ip[0]]) ? ip + 2 : chunk->code.data() + ip[1];
+    DISPATCH();
+  }
+  HANDLER(LoopResult): {
+    RuntimeVal* value = regs[ip[1]];
+    if (value->type == ValueType::Break) {
+      ip = chunk->code.data() + ip[2];
+    } else if (value->type == ValueType::Continue) {
+      ip = chunk->code.data() + ip[3];
+    } else {
+      regs[ip[0]] = value;
+      ip += 4;
+    }
+    DISPATCH();
+  }
+  HANDLER(RangeStart): {
+    bool counting = range_start(env, chunk->refs[ip[4]], &regs[ip[0]], regs[ip[1]], regs[ip[2]], regs[ip[3]]);
+    ip = counting ? ip + 6 : chunk->code.data() + ip[5];
+    DISPATCH();
+  }
+  HANDLER(RangeNext): {
+    bool counting = range_next(env, chunk->refs[ip[3]], regs[ip[0]], regs[ip[1]], regs[ip[2]]);
+    ip = counting ? chunk->code.data() + ip[4] : ip + 5;
+    DISPATCH();
+  }
+  HANDLER(ArrayStart): {
+    bool counting = array_start(env, chunk->refs[ip[2]], &regs[ip[0]], regs[ip[1]]);
+    ip = counting ? ip + 4 : chunk->code.data() + ip[3];
+    DISPATCH();
+  }
+  HANDLER(ArrayNext): {
+    bool counting = array_next(env, chunk->refs[ip[2]], regs[ip[0]], regs[ip[1]]);
+    ip = counting ? chunk->code.data() + ip[3] : ip + 4;
+    DISPATCH();
+  }
+  HANDLER(Invariants): {
+    invariants.resize(invariants.size() + *ip++);
+    DISPATCH();
+  }
+  HANDLER(DropInvariants): {
+    invariants.resize(invariants.size() - *ip++);
+    DISPATCH();
+  }
+  HANDLER(InvariantStart): {
+    RuntimeVal* value = kept_value(invariants[invariants.size() - ip[1]]);
+    if (value != nullptr) {
+      regs[ip[0]] = value;
+      ip = chunk->code.data() + ip[2];
+    } else {
+      ip += 3;
+    }
+    DISPATCH();
+  }
+  HANDLER(InvariantEnd): {
+    keep_value(invariants[invariants.size() - ip[1]], regs[ip[0]]);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(Match): {
+    size_t index;
+    env = match_scope(static_cast<MatchExpr*>(chunk->nodes[ip[1]]), regs[ip[0]], env, index);
+    ip = chunk->code.data() + chunk->tables[ip[2]][index];
+    DISPATCH();
+  }
+  HANDLER(Node): {
+    regs[ip[0]] = evaluate(chunk->nodes[ip[1]], env);
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(NodeOuter): {
+    regs[ip[0]] = evaluate(chunk->nodes[ip[1]], env->parent());
+    ip += 2;
+    DISPATCH();
+  }
+  HANDLER(BranchCompare): {
+    bool passed = test(regs[ip[0]], regs[ip[1]], static_cast<ComparisonOperatorType>(ip[2]));
+    ip = passed ? ip + 4 : chunk->code.data() + ip[3];
+    DISPATCH();
+  }
+  HANDLER(BranchCompareVar): {
+    const NamedRef& named = chunk->refs[ip[0]];
+    Environment* scope = ip[3] ? env->parent() : env;
+    bool passed = test(scope->peekRef(named.ref, named.symbol), regs[ip[1]], static_cast<ComparisonOperatorType>(ip[2]));
+    ip = passed ? ip + 5 : chunk->code.data() + ip[4];
+    DISPATCH();
+  }
+  HANDLER(IncrementVar): {
+    const NamedRef& source = chunk->refs[ip[2]];
+    RuntimeVal* value = env->peekRef(source.ref, source.symbol);
+    RuntimeVal* step = regs[ip[3]];
+    RuntimeVal* result = value->type == ValueType::Number ? MK_NUM(number(value) + number(step)) : binary_other(value, step);
+
+    const NamedRef& target = chunk->refs[ip[1]];
+    regs[ip[0]] = env->assignRef(target.ref, target.symbol, result, false);
+    ip += 4;
+    DISPATCH();
+  }
+
+#if !EAST_THREADED_DISPATCH
+  }
+  raise_error("invalid instruction");
+#endif
+
+call:
+  if (callee->type == ValueType::NativeFn) {
+    regs[dst] = call_native(static_cast<NativeFnVal*>(callee), args, argc);
+    DISPATCH();
+  }
+  if (callee->type != ValueType::Function) raise_error("Cannot call a non-callable value");
+  {
+    // the callee's registers go right after the caller's
+    FunctionVal* func = static_cast<FunctionVal*>(callee);
+    uncachedCalls++;
+    heapEpoch++;
+    Environment* scope = call_scope(func, args, argc);
+    if (RuntimeVal* result = native_call(func, scope)) {
+      regs[dst] = result;
+      DISPATCH();
+    }
+    Chunk* callerChunk = chunk;
+    chunk = function_chunk(func);
+    frames.push_back(CallFrame{ callerChunk, ip, env, base, dst, charge(chunk, scope_bytes(func)) });
+
+    base += callerChunk->frame_size();
+    regs = enter(chunk, base);
+    ip = chunk->code.data();
+    env = scope;
+  }
+  DISPATCH();
+
+#undef HANDLER
+#undef DISPATCH
+}
+
+RuntimeVal* call_value(RuntimeVal* callee, RuntimeVal** args, size_t argc) {
+  if (callee->type == ValueType::NativeFn) return call_native(static_cast<NativeFnVal*>(callee), args, argc);
+  if (callee->type != ValueType::Function) raise_error("Cannot call a non-callable value");
+
+  FunctionVal* func = static_cast<FunctionVal*>(callee);
+  uncachedCalls++;
+  heapEpoch++;
+  Environment* scope = call_scope(func, args, argc);
+  return call_function(func, scope);
+}
+
+RuntimeVal* run_chunk(Chunk* chunk, Environment* env, RuntimeVal* first) {
+  if (instructionCounting) return VM().run<true>(chunk, env, first);
+  return VM().run<false>(chunk, env, first);
+}
+
+const char * vm_dispatch_name() {
+  return EAST_THREADED_DISPATCH ? "computed goto" : "switch";
+}
+
+RuntimeVal* run_program(Program* program, Environment* env) {
+  if (!vmEnabled) return evaluate(program, env);
+
+  heapEpoch++;
+  env->install(program->layout);
+  std::unique_ptr<Chunk> chunk(compile_chunk(program->body));
+  if (instructionCounting) return VM().run<true>(chunk.get(), env);
+  return VM().run<false>(chunk.get(), env);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include "../../parsing/ast.hpp"
+#include "../Environment.hpp"
+
+/*
+Bytecode VM, an alternative to the tree-walker in interpreter.cpp (--vm).
+A program is compiled into a chunk (compiler.hpp) and run by a register machine: every
+instruction names the registers it reads and writes, so there's no stack shuffling, and
+common patterns (compare a variable to a constant and branch, x = x + 1, module.callable())
+are single superinstructions. With GCC/Clang each instruction jumps straight to the next
+one's handler (computed goto), elsewhere it's a switch in a loop.
+
+Calls between callables push call frames instead of recursing, their bodies are compiled
+the first time they're called. The frames and registers live on the heap, so how deep a
+recursion can go is only limited by --stack-budget, and going past it is an EastLang error
+instead of a crash. The budget is shared with nested VMs and the tree-walker (StackCharge). Apart from what it hands to the tree-walker, everything a running chunk
+needs is in the VM object rather than on the C++ stack. Hot ones run as machine code instead (tiers.hpp). Variables
+still live in Environments, so closures, modules and the tree-walker (which runs whatever
+the VM has no instructions for) see the same scopes either way. Without --vm the VM is
+still the middle tier, hot callables and loops of a tree-walked program move to it.
+*/
+
+void set_vm_enabled(bool enabled);
+bool vm_enabled();
+
+// how much the calls in progress may take up, in MB: the VMs' registers and call frames and
+// every call's scope. Going deeper is an error
+#ifndef EAST_STACK_BUDGET
+#define EAST_STACK_BUDGET 512
+#endif
+void set_stack_budget(size_t megabytes);
+
+// what a call's scope takes from the budget
+size_t scope_bytes(const FunctionVal* func);
+
+// A share of --stack-budget, held for as long as the object lives. There's one budget for the
+// whole process: a chunk handed to a fresh VM from the tree-walker, the JIT or a tier change,
+// and the tree-walker's own calls, all take from it, so recursion going back and forth between
+// them is limited like recursion on a single VM
+class StackCharge {
+  private:
+    size_t bytes;
+
+  public:
+    StackCharge(size_t bytes);
+    ~StackCharge();
+    StackCharge(const StackCharge&) = delete;
+    StackCharge& operator=(const StackCharge&) = delete;
+};
+
+// runs a program in `env` with the VM or the tree-walker, whichever is enabled
+RuntimeVal* run_program(Program* program, Environment* env);
+
+// calls a callable or a native like the VM's Call does, for the JIT's calls back into the runtime
+RuntimeVal* call_value(RuntimeVal* callee, RuntimeVal** args, size_t argc);
+
+// runs a chunk on its own VM, register 0 starting as `first` (compile_loop needs that)
+RuntimeVal* run_chunk(Chunk* chunk, Environment* env, RuntimeVal* first = nullptr);
+
+// "computed goto" or "switch"
+const char * vm_dispatch_name();
+
+// counts the instructions the VM runs, for bench/dispatch.cpp. Costs nothing while it's off
+void set_vm_instruction_counting(bool enabled);
+uint64_t vm_instructions_run();
@@ -0,0 +1,204 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/*
+Just enough of an x86-64 assembler for the JIT (jit.cpp): 64 bit moves between registers
+and memory, the SSE2 instructions for doubles it needs, compares, calls and jumps to labels.
+Memory operands are always [base + disp32].
+*/
+
+enum Reg : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum Xmm : uint8_t { XMM0, XMM1 };
+
+// the jcc condition codes the JIT uses
+enum Cond : uint8_t {
+  CondB = 0x2,   // below, unsigned < (ucomisd: less or unordered)
+  CondAE = 0x3,
+  CondE = 0x4,
+  CondNE = 0x5,
+  CondBE = 0x6,
+  CondA = 0x7,
+  CondP = 0xA,   // parity, ucomisd saw a NaN
+};
+
+class X64Assembler {
+  private:
+    std::vector<uint8_t> bytes;
+    std::vector<int64_t> labels; // where each label is, -1 until it's bound
+    std::vector<std::pair<size_t, uint32_t>> fixups; // a rel32 at that position has to reach the label
+
+    void byte(uint8_t value) {
+      bytes.push_back(value);
+    }
+
+    void u32(uint32_t value) {
+      for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void u64(uint64_t value) {
+      for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    // only written when something needs it
+    void rex(bool wide, uint8_t reg, uint8_t base) {
+      uint8_t prefix = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (base >> 3);
+      if (prefix != 0x40) byte(prefix);
+    }
+
+    // ModRM for [base + disp32], rsp and r12 as a base need a SIB byte
+    void mem(uint8_t reg, Reg base, int32_t disp) {
+      byte(0x80 | ((reg & 7) << 3) | (base & 7));
+      if ((base & 7) == RSP) byte(0x24);
+      u32(static_cast<uint32_t>(disp));
+    }
+
+    void rel32(uint32_t label) {
+      fixups.emplace_back(bytes.size(), label);
+      u32(0);
+    }
+
+    void sse(uint8_t prefix, uint8_t op, Xmm dst, Reg base, int32_t disp) {
+      byte(prefix);
+      rex(false, dst, base);
+      byte(0x0F);
+      byte(op);
+      mem(dst, base, disp);
+    }
+
+  public:
+    using Label = uint32_t;
+
+    Label label() {
+      labels.push_back(-1);
+      return static_cast<Label>(labels.size() - 1);
+    }
+
+    void bind(Label label) {
+      labels[label] = static_cast<int64_t>(bytes.size());
+    }
+
+    void mov(Reg dst, uint64_t imm) {
+      rex(true, 0, dst);
+      byte(0xB8 | (dst & 7));
+      u64(imm);
+    }
+
+    void mov(Reg dst, const void* pointer) {
+      mov(dst, reinterpret_cast<uint64_t>(pointer));
+    }
+
+    void mov(Reg dst, Reg src) {
+      rex(true, src, dst);
+      byte(0x89);
+      byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+    }
+
+    void load(Reg dst, Reg base, int32_t disp) {
+      rex(true, dst, base);
+      byte(0x8B);
+      mem(dst, base, disp);
+    }
+
+    void store(Reg base, int32_t disp, Reg src) {
+      rex(true, src, base);
+      byte(0x89);
+      mem(src, base, disp);
+    }
+
+    void lea(Reg dst, Reg base, int32_t disp) {
+      rex(true, dst, base);
+      byte(0x8D);
+      mem(dst, base, disp);
+    }
+
+    // cmp dword [base + disp], imm
+    void cmp32(Reg base, int32_t disp, int32_t imm) {
+      rex(false, 0, base);
+      byte(0x81);
+      mem(7, base, disp);
+      u32(static_cast<uint32_t>(imm));
+    }
+
+    // cmp byte [base + disp], imm
+    void cmp8(Reg base, int32_t disp, uint8_t imm) {
+      rex(false, 0, base);
+      byte(0x80);
+      mem(7, base, disp);
+      byte(imm);
+    }
+
+    void test(Reg reg) {
+      rex(true, reg, reg);
+      byte(0x85);
+      byte(0xC0 | ((reg & 7) << 3) | (reg & 7));
+    }
+
+    // test al, al, for functions returning a bool
+    void test_al() {
+      byte(0x84);
+      byte(0xC0);
+    }
+
+    void movsd(Xmm dst, Reg base, int32_t disp) { sse(0xF2, 0x10, dst, base, disp); }
+    void addsd(Xmm dst, Reg base, int32_t disp) { sse(0xF2, 0x58, dst, base, disp); }
+    void subsd(Xmm dst, Reg base, int32_t disp) { sse(0xF2, 0x5C, dst, base, disp); }
+    void mulsd(Xmm dst, Reg base, int32_t disp) { sse(0xF2, 0x59, dst, base, disp); }
+    void divsd(Xmm dst, Reg base, int32_t disp) { sse(0xF2, 0x5E, dst, base, disp); }
+
+    void ucomisd(Xmm left, Xmm right) {
+      byte(0x66);
+      byte(0x0F);
+      byte(0x2E);
+      byte(0xC0 | (left << 3) | right);
+    }
+
+    void call(const void* function) {
+      mov(RAX, function);
+      byte(0xFF);
+      byte(0xD0);
+    }
+
+    void jmp(Label label) {
+      byte(0xE9);
+      rel32(label);
+    }
+
+    void j(Cond cond, Label label) {
+      byte(0x0F);
+      byte(0x80 | cond);
+      rel32(label);
+    }
+
+    void push(Reg reg) {
+      if (reg >= R8) byte(0x41);
+      byte(0x50 | (reg & 7));
+    }
+
+    void pop(Reg reg) {
+      if (reg >= R8) byte(0x41);
+      byte(0x58 | (reg & 7));
+    }
+
+    void sub_rsp(int32_t imm) {
+      byte(0x48);
+      byte(0x81);
+      byte(0xEC);
+      u32(static_cast<uint32_t>(imm));
+    }
+
+    void ret() {
+      byte(0xC3);
+    }
+
+    // fills in the jumps, after this the code can be copied anywhere
+    const std::vector<uint8_t>& finish() {
+      for (const auto& fixup : fixups) {
+        int32_t rel = static_cast<int32_t>(labels[fixup.second] - static_cast<int64_t>(fixup.first + 4));
+        std::memcpy(&bytes[fixup.first], &rel, 4);
+      }
+      return bytes;
+    }
+};
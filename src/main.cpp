@@ -1,31 +1,51 @@
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "parsing/lexer.hpp"
 #include "parsing/parser.hpp"
+#include "parsing/astcache.hpp"
+#include "parsing/bundle.hpp"
+#include "parsing/loader.hpp"
+#include "optimization/inliner.hpp"
+#include "optimization/optimizer.hpp"
+#include "optimization/resolver.hpp"
 #include "interpretation/Environment.hpp"
 #include "interpretation/GlobalEnv.hpp"
 #include "interpretation/interpreter.hpp"
+#include "interpretation/vm/vm.hpp"
+#include "interpretation/vm/jit.hpp"
+#include "interpretation/vm/tiers.hpp"
 
 #include "util.hpp"
 
+// argv[0] is the script, the rest are its arguments
 int run(int argc, char * argv[]) {
 
-  std::string fileContent = read_file(argv[1]);
-
-  Parser* parser = new Parser();
   Environment* env = makeGlobalEnv();
-  env->declareVar("@name", MK_STRING("main"));
+  env->declareVar(SYM_AT_NAME, MK_STRING("main"));
 
-  env->declareVar("@path", MK_STRING(path_of_file(pwd() + "/" + argv[1])), true);
+  std::string scriptDir = path_of_file(pwd() + "/" + argv[0]);
+  env->declareVar(SYM_AT_PATH, MK_STRING(scriptDir), true);
 
   auto* argArray = new ArrayVal();
-  for (int i = 1; i < argc; i++) { // convert argv after the interpreter path into an array
+  for (int i = 0; i < argc; i++) { // convert argv starting at the script path into an array
       argArray->elements.push_back(MK_STRING(argv[i]));
   }
-  env->declareVar("argv", argArray, true);
+  env->declareVar(SYM_ARGV, argArray, true);
+
+  // a bundle brings its modules along, the loader then takes them from there instead of the disk
+  std::string mainPath = argv[0];
+  size_t extension = std::strlen(BUNDLE_EXTENSION);
+  if (mainPath.size() > extension && mainPath.compare(mainPath.size() - extension, extension, BUNDLE_EXTENSION) == 0) {
+    mainPath = load_bundle(mainPath, scriptDir);
+  }
 
-  Program* program = parser->parse_ast(fileContent);
+  // kicks off parsing of everything the script imports before the script starts running
+  Program* program = load_module(mainPath, scriptDir);
 
-  evaluate(program, env);
+  run_program(program, env);
+  print_tier_stats();
   return 0;
 }
 
@@ -33,8 +53,8 @@ int repl(int argc, char * argv[]) {
   Parser* parser = new Parser();
   Environment* env = makeGlobalEnv();
 
-  env->declareVar("@name", MK_STRING("main"));
-  env->declareVar("@path", MK_STRING(pwd()), true);
+  env->declareVar(SYM_AT_NAME, MK_STRING("main"));
+  env->declareVar(SYM_AT_PATH, MK_STRING(pwd()), true);
 
   std::cout << "Repl v99.99\n";
 
@@ -54,20 +74,79 @@ int repl(int argc, char * argv[]) {
 
     // Produce AST From sourc-code
     Program* program = parser->parse_ast(input);
+    optimize_program(program);
+    resolve_program(program);
 
-    RuntimeVal* ret = evaluate(program, env);
+    RuntimeVal* ret = run_program(program, env);
     if (ret->type != ValueType::Empty)
       print({ ret }); // language specific function located in interpretation\GlobalEnv.cpp
   }
   return 0;
 }
 
+// --bundle script -o out
+int bundle(int argc, char * argv[]) {
+  if (argc != 3 || std::strcmp(argv[1], "-o") != 0) {
+    std::cerr << "Usage: EastLangInterpreter --bundle <script> -o <output" << BUNDLE_EXTENSION << ">\n";
+    return 1;
+  }
+  size_t count = write_bundle(argv[0], argv[2]);
+  std::cout << "Bundled " << count << (count == 1 ? " module" : " modules") << " into " << argv[2] << "\n";
+  return 0;
+}
+
 int main(int argc, char * argv[]) {
 
-  if (argc < 2) {
+  // interpreter options come before the script, everything after it belongs to the script
+  int first = 1;
+  bool bundling = false;
+  while (first < argc && std::strncmp(argv[first], "--", 2) == 0) {
+    std::string option = argv[first];
+
+    if (option == "--no-cache") {
+      set_ast_cache_enabled(false);
+    } else if (option == "--no-preload") {
+      set_module_preload_enabled(false);
+    } else if (option == "--no-optimize") {
+      set_optimizer_enabled(false);
+    } else if (option == "--vm") {
+      set_vm_enabled(true);
+    } else if (option == "--no-jit") {
+      set_jit_enabled(false);
+    } else if (option.rfind("--tier-thresholds=", 0) == 0) {
+      TierThresholds thresholds;
+      const char* numbers = option.c_str() + std::strlen("--tier-thresholds=");
+      if (std::sscanf(numbers, "%u,%u,%u", &thresholds.vm, &thresholds.native, &thresholds.loop) != 3) {
+        std::cerr << "Expected --tier-thresholds=<vm calls>,<jit calls>,<loop iterations>\n";
+        return 1;
+      }
+      set_tier_thresholds(thresholds);
+    } else if (option.rfind("--stack-budget=", 0) == 0) {
+      long megabytes = std::atol(option.c_str() + std::strlen("--stack-budget="));
+      if (megabytes <= 0) {
+        std::cerr << "Expected --stack-budget=<MB>\n";
+        return 1;
+      }
+      set_stack_budget(static_cast<size_t>(megabytes));
+    } else if (option == "--tier-stats") {
+      set_tier_stats(true);
+    } else if (option == "--debug-inline") {
+      set_inline_debug(true);
+    } else if (option == "--bundle") {
+      bundling = true;
+    } else {
+      std::cerr << "Unknown option " << option << "\n";
+      return 1;
+    }
+    first++;
+  }
+
+  if (bundling) {
+    return bundle(argc - first, argv + first);
+  } else if (first >= argc) {
     return repl(argc, argv);
   } else {
-    return run(argc, argv);
+    return run(argc - first, argv + first);
   }
 
   return 0;
@@ -0,0 +1,588 @@
+#include "inliner.hpp"
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+static bool inlineDebug = false;
+
+void set_inline_debug(bool enabled) {
+  inlineDebug = enabled;
+}
+
+// one line at a time, modules are optimized on the loader's threads
+static void report(const std::string& message) {
+  if (inlineDebug) std::cerr << "[inline] " + message + "\n";
+}
+
+struct Callable {
+  Symbol name;
+  FunctionDeclaration* func;
+  Expr* body;
+  size_t scope; // where it's declared, index into Inliner::scopes
+  std::vector<Symbol> freeNames; // names the body reads that aren't parameters
+};
+
+struct InlineScope {
+  std::unordered_set<Symbol> names; // everything that can get declared directly in it
+  std::unordered_map<Symbol, size_t> callables; // consts that are declared by now, index into Inliner::callables
+};
+
+class Inliner {
+  private:
+    AstArena& arena;
+    std::vector<InlineScope*> scopes; // innermost last
+    std::vector<Callable> callables;
+
+    void collect(Stmt* node, InlineScope& scope);
+    size_t count_nodes(Stmt* node);
+    bool inlinable_body(Stmt* node);
+    void consider(VariableDeclaration* varDec);
+    const Callable* find(Symbol name);
+    bool args_in_order(const Callable& callable, CallExpr* call);
+    bool can_inline(const Callable& callable, CallExpr* call);
+    Expr* substitute(Expr* node, const Callable& callable, CallExpr* call);
+
+    void rewrite_body(StmtList body);
+    void rewrite_scope(InlineScope& scope, std::initializer_list<StmtList> bodies);
+
+  public:
+    Inliner(AstArena& a): arena(a) {}
+
+    Expr* rewrite(Expr* node);
+    void rewrite_program(Program* program);
+};
+
+// same rules as the resolver: assignments, consts, the checks of ifs and whiles, not nested scopes
+void Inliner::collect(Stmt* node, InlineScope& scope) {
+  if (node == nullptr) return;
+
+  switch (node->kind) {
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      if (assign->identifier->kind == NodeType::Identifier) {
+        scope.names.insert(static_cast<Identifier*>(assign->identifier)->symbol);
+      } else {
+        collect(assign->identifier, scope);
+      }
+      collect(assign->value, scope);
+      break;
+    }
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      scope.names.insert(varDec->identifier);
+      collect(varDec->value, scope);
+      break;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      collect(ifStmt->check, scope);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) collect(branch.check, scope);
+      break;
+    }
+    case NodeType::WhileStatement: {
+      collect(static_cast<WhileStatement*>(node)->check, scope);
+      break;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr* expr : { forStmt->iterable, forStmt->start, forStmt->end, forStmt->step }) collect(expr, scope);
+      break;
+    }
+    case NodeType::MatchExpr: {
+      collect(static_cast<MatchExpr*>(node)->value, scope);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+    case NodeType::BlockExpr:
+      break;
+    default:
+      for_each_child(node, [&](Stmt* child) {
+        collect(child, scope);
+      });
+  }
+}
+
+size_t Inliner::count_nodes(Stmt* node) {
+  size_t count = 1;
+  for_each_child(node, [&](Stmt* child) {
+    count += count_nodes(child);
+  });
+  return count;
+}
+
+// expressions that only compute a value in the scope they run in
+bool Inliner::inlinable_body(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::Identifier:
+    case NodeType::ArrayLiteral:
+    case NodeType::CallExpr:
+    case NodeType::MemberExpr:
+    case NodeType::SubscriptExpr:
+    case NodeType::NegateExpr:
+    case NodeType::LogicalExpr:
+    case NodeType::ComparisonExpr:
+    case NodeType::BinaryExpr:
+    case NodeType::BitShiftExpr: {
+      bool all = true;
+      for_each_child(node, [&](Stmt* child) {
+        all = all && inlinable_body(child);
+      });
+      return all;
+    }
+    default:
+      return false;
+  }
+}
+
+static void free_names(Stmt* node, const NodeList<Symbol>& params, std::vector<Symbol>& names) {
+  if (node->kind == NodeType::Identifier) {
+    Symbol symbol = static_cast<Identifier*>(node)->symbol;
+    for (Symbol param : params) {
+      if (param == symbol) return;
+    }
+    names.push_back(symbol);
+    return;
+  }
+  for_each_child(node, [&](Stmt* child) {
+    free_names(child, params, names);
+  });
+}
+
+// a const callable whose declaration just ran, calls from here on can use it
+void Inliner::consider(VariableDeclaration* varDec) {
+  if (!varDec->constant || varDec->value->kind != NodeType::FunctionDeclaration) return;
+
+  FunctionDeclaration* func = static_cast<FunctionDeclaration*>(varDec->value);
+  std::string name = symbol_name(varDec->identifier);
+
+  if (func->body.size() != 1 || !inlinable_body(func->body[0])) {
+    report("not inlining " + name + ": the body isn't a single expression");
+    return;
+  }
+  size_t size = count_nodes(func->body[0]);
+  if (size > INLINE_MAX_NODES) {
+    report("not inlining " + name + ": the body has " + std::to_string(size) + " nodes");
+    return;
+  }
+  for (size_t i = 0; i < func->parameters.size(); i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (func->parameters[i] == func->parameters[j]) {
+        report("not inlining " + name + ": a parameter is repeated");
+        return;
+      }
+    }
+  }
+
+  Callable callable;
+  callable.name = varDec->identifier;
+  callable.func = func;
+  callable.body = static_cast<Expr*>(func->body[0]);
+  callable.scope = scopes.size() - 1;
+  free_names(callable.body, func->parameters, callable.freeNames);
+  for (Symbol free : callable.freeNames) {
+    if (free == callable.name) {
+      report("not inlining " + name + ": it's recursive");
+      return;
+    }
+  }
+
+  scopes.back()->callables[callable.name] = callables.size();
+  callables.push_back(callable);
+}
+
+// the const a call site's name refers to, if it's one that can be inlined
+const Callable* Inliner::find(Symbol name) {
+  for (size_t i = scopes.size(); i-- > 0;) {
+    if (scopes[i]->names.find(name) == scopes[i]->names.end()) continue;
+
+    auto found = scopes[i]->callables.find(name);
+    if (found == scopes[i]->callables.end()) return nullptr;
+    return &callables[found->second];
+  }
+  return nullptr;
+}
+
+static bool is_literal(Stmt* node) {
+  return node->kind == NodeType::NumberLiteral
+    || node->kind == NodeType::StringLiteral
+    || node->kind == NodeType::BooleanLiteral;
+}
+
+static int param_index(Stmt* node, const NodeList<Symbol>& params) {
+  if (node->kind != NodeType::Identifier) return -1;
+  Symbol symbol = static_cast<Identifier*>(node)->symbol;
+  for (size_t i = 0; i < params.size(); i++) {
+    if (params[i] == symbol) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+/*
+Arguments that are more than a literal or a name can do anything, so they have to run exactly
+once, in their order, and before the body does anything but put literals together with `+`
+or into arrays (which never errors). Names are read where the body gets to them, which is fine
+as long as the body calls nothing and no complex argument after them could change them.
+*/
+bool Inliner::args_in_order(const Callable& callable, CallExpr* call) {
+  const NodeList<Symbol>& params = callable.func->parameters;
+
+  std::vector<size_t> uses(params.size(), 0);
+  bool pastArgs = false; // the body did something the arguments could notice
+  bool lateArg = false;
+  int lastComplex = -1;
+  bool hasCall = false;
+
+  std::function<void(Stmt*)> walk = [&](Stmt* node) {
+    LogicalExpr* logical = node->kind == NodeType::LogicalExpr ? static_cast<LogicalExpr*>(node) : nullptr;
+    if (logical != nullptr && logical->op != LogicalOperatorType::Xor) {
+      // and/or short-circuit, an argument on the right might never run
+      walk(logical->left);
+      pastArgs = true;
+      walk(logical->right);
+    } else {
+      for_each_child(node, [&](Stmt* child) {
+        walk(child);
+      });
+    }
+
+    if (node->kind == NodeType::CallExpr) hasCall = true;
+
+    int param = param_index(node, params);
+    if (param < 0) {
+      if (!is_literal(node) && node->kind != NodeType::BinaryExpr && node->kind != NodeType::ArrayLiteral) pastArgs = true;
+      return;
+    }
+    uses[param]++;
+
+    Expr* arg = call->args[param];
+    if (is_literal(arg)) return;
+    if (arg->kind == NodeType::Identifier) {
+      pastArgs = true;
+      return;
+    }
+    if (pastArgs || param < lastComplex) lateArg = true;
+    lastComplex = param;
+  };
+  walk(callable.body);
+  if (lateArg) return false;
+
+  bool seenName = false;
+  for (size_t i = 0; i < params.size(); i++) {
+    Expr* arg = call->args[i];
+    if (is_literal(arg)) continue;
+    if (arg->kind == NodeType::Identifier) {
+      if (uses[i] == 0 || hasCall) return false;
+      seenName = true;
+      continue;
+    }
+    if (uses[i] != 1 || seenName) return false;
+  }
+  return true;
+}
+
+bool Inliner::can_inline(const Callable& callable, CallExpr* call) {
+  std::string name = symbol_name(callable.name);
+
+  if (call->args.size() != callable.func->parameters.size()) {
+    report("kept a call to " + name + ": it gets " + std::to_string(call->args.size()) + " arguments");
+    return false;
+  }
+  for (Symbol free : callable.freeNames) {
+    for (size_t i = callable.scope + 1; i < scopes.size(); i++) {
+      if (scopes[i]->names.find(free) != scopes[i]->names.end()) {
+        report("kept a call to " + name + ": " + symbol_name(free) + " means something else there");
+        return false;
+      }
+    }
+  }
+  if (!args_in_order(callable, call)) {
+    report("kept a call to " + name + ": its arguments would run differently");
+    return false;
+  }
+  return true;
+}
+
+// a copy of the body with the arguments in place of the parameters
+Expr* Inliner::substitute(Expr* node, const Callable& callable, CallExpr* call) {
+  int param = param_index(node, callable.func->parameters);
+  if (param >= 0) {
+    Expr* arg = call->args[param];
+    if (arg->kind != NodeType::Identifier) return arg; // literals are shared anyway, complex ones are used once
+    Identifier* copy = arena.make<Identifier>();
+    copy->symbol = static_cast<Identifier*>(arg)->symbol;
+    return copy;
+  }
+
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+      return node;
+    case NodeType::Identifier: {
+      Identifier* copy = arena.make<Identifier>();
+      copy->symbol = static_cast<Identifier*>(node)->symbol;
+      return copy;
+    }
+    case NodeType::ArrayLiteral: {
+      ArrayLiteral* array = static_cast<ArrayLiteral*>(node);
+      ArrayLiteral* copy = arena.make<ArrayLiteral>();
+      copy->elements = arena.make_list<Expr*>(array->elements.size());
+      for (size_t i = 0; i < array->elements.size(); i++) {
+        copy->elements[i] = substitute(array->elements[i], callable, call);
+      }
+      return copy;
+    }
+    case NodeType::CallExpr: {
+      CallExpr* inner = static_cast<CallExpr*>(node);
+      CallExpr* copy = arena.make<CallExpr>();
+      copy->caller = substitute(inner->caller, callable, call);
+      copy->args = arena.make_list<Expr*>(inner->args.size());
+      for (size_t i = 0; i < inner->args.size(); i++) {
+        copy->args[i] = substitute(inner->args[i], callable, call);
+      }
+      return copy;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      MemberExpr* copy = arena.make<MemberExpr>();
+      copy->left = substitute(member->left, callable, call);
+      copy->identifier = member->identifier;
+      return copy;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = static_cast<SubscriptExpr*>(node);
+      SubscriptExpr* copy = arena.make<SubscriptExpr>();
+      copy->left = substitute(sub->left, callable, call);
+      copy->value = substitute(sub->value, callable, call);
+      return copy;
+    }
+    case NodeType::NegateExpr: {
+      NegateExpr* copy = arena.make<NegateExpr>();
+      copy->expr = substitute(static_cast<NegateExpr*>(node)->expr, callable, call);
+      return copy;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      LogicalExpr* copy = arena.make<LogicalExpr>();
+      copy->left = substitute(logical->left, callable, call);
+      copy->right = substitute(logical->right, callable, call);
+      copy->op = logical->op;
+      return copy;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      ComparisonExpr* copy = arena.make<ComparisonExpr>();
+      copy->left = substitute(comparison->left, callable, call);
+      copy->right = substitute(comparison->right, callable, call);
+      copy->op = comparison->op;
+      return copy;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      BinaryExpr* copy = arena.make<BinaryExpr>();
+      copy->left = substitute(binary->left, callable, call);
+      copy->right = substitute(binary->right, callable, call);
+      copy->expr_operator = binary->expr_operator;
+      return copy;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      BitShiftExpr* copy = arena.make<BitShiftExpr>();
+      copy->left = substitute(shift->left, callable, call);
+      copy->right = substitute(shift->right, callable, call);
+      copy->shiftRight = shift->shiftRight;
+      return copy;
+    }
+    default: // inlinable_body() lets nothing else through
+      return node;
+  }
+}
+
+// calls are rewritten inside out, so arguments are inlined before the call they're passed to
+Expr* Inliner::rewrite(Expr* node) {
+  if (node == nullptr) return node;
+
+  switch (node->kind) {
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(node);
+      call->caller = rewrite(call->caller);
+      for (Expr*& arg : call->args) arg = rewrite(arg);
+
+      if (call->caller->kind != NodeType::Identifier) return call;
+      const Callable* callable = find(static_cast<Identifier*>(call->caller)->symbol);
+      if (callable == nullptr || !can_inline(*callable, call)) return call;
+
+      report("inlined a call to " + symbol_name(callable->name));
+      return substitute(callable->body, *callable, call);
+    }
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      varDec->value = rewrite(varDec->value);
+      return node;
+    }
+    case NodeType::FunctionDeclaration: {
+      FunctionDeclaration* funcDec = static_cast<FunctionDeclaration*>(node);
+      InlineScope scope;
+      for (Symbol param : funcDec->parameters) scope.names.insert(param);
+      rewrite_scope(scope, { funcDec->body });
+      return node;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      ifStmt->check = rewrite(ifStmt->check);
+      for (ElseIfBranch& branch : ifStmt->else_if_chain) branch.check = rewrite(branch.check);
+
+      // every branch runs in the same scope
+      InlineScope scope;
+      for (auto stmt : ifStmt->body) collect(stmt, scope);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) {
+        for (auto stmt : branch.body) collect(stmt, scope);
+      }
+      for (auto stmt : ifStmt->else_body) collect(stmt, scope);
+
+      scopes.push_back(&scope);
+      rewrite_body(ifStmt->body);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) rewrite_body(branch.body);
+      rewrite_body(ifStmt->else_body);
+      scopes.pop_back();
+      return node;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      whileStmt->check = rewrite(whileStmt->check);
+      InlineScope scope;
+      rewrite_scope(scope, { whileStmt->body });
+      return node;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr** expr : { &forStmt->iterable, &forStmt->start, &forStmt->end, &forStmt->step }) *expr = rewrite(*expr);
+      InlineScope scope;
+      scope.names.insert(forStmt->identifier);
+      rewrite_scope(scope, { forStmt->body });
+      return node;
+    }
+    case NodeType::BlockExpr: {
+      InlineScope scope;
+      rewrite_scope(scope, { static_cast<BlockExpr*>(node)->body });
+      return node;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      match->value = rewrite(match->value);
+      for (const MatchCase& matchCase : match->cases) {
+        InlineScope scope;
+        for (const MatchPattern& pattern : matchCase.patterns) {
+          for_each_binding(pattern, [&](Symbol name) { scope.names.insert(name); });
+        }
+        rewrite_scope(scope, { matchCase.body });
+      }
+      InlineScope elseScope;
+      rewrite_scope(elseScope, { match->else_body });
+      return node;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      if (assign->identifier->kind == NodeType::SubscriptExpr) {
+        SubscriptExpr* sub = static_cast<SubscriptExpr*>(assign->identifier);
+        sub->value = rewrite(sub->value);
+      }
+      assign->value = rewrite(assign->value);
+      return node;
+    }
+    case NodeType::SpecialExpr: {
+      for (Expr*& arg : static_cast<SpecialExpr*>(node)->args) arg = rewrite(arg);
+      return node;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = static_cast<SubscriptExpr*>(node);
+      sub->left = rewrite(sub->left);
+      sub->value = rewrite(sub->value);
+      return node;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      member->left = rewrite(member->left);
+      return node;
+    }
+    case NodeType::NegateExpr: {
+      NegateExpr* negate = static_cast<NegateExpr*>(node);
+      negate->expr = rewrite(negate->expr);
+      return node;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      logical->left = rewrite(logical->left);
+      logical->right = rewrite(logical->right);
+      return node;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      comparison->left = rewrite(comparison->left);
+      comparison->right = rewrite(comparison->right);
+      return node;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      binary->left = rewrite(binary->left);
+      binary->right = rewrite(binary->right);
+      return node;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      shift->left = rewrite(shift->left);
+      shift->right = rewrite(shift->right);
+      return node;
+    }
+    case NodeType::ArrayLiteral: {
+      for (Expr*& elem : static_cast<ArrayLiteral*>(node)->elements) elem = rewrite(elem);
+      return node;
+    }
+    default: // literals, identifiers
+      return node;
+  }
+}
+
+// a const is only known to the statements after it in the same body
+void Inliner::rewrite_body(StmtList body) {
+  InlineScope& scope = *scopes.back();
+  std::vector<Symbol> declared;
+
+  for (Stmt*& stmt : body) {
+    stmt = rewrite(static_cast<Expr*>(stmt));
+    if (stmt->kind != NodeType::VariableDeclaration) continue;
+
+    size_t before = scope.callables.size();
+    consider(static_cast<VariableDeclaration*>(stmt));
+    if (scope.callables.size() != before) declared.push_back(static_cast<VariableDeclaration*>(stmt)->identifier);
+  }
+
+  for (Symbol name : declared) scope.callables.erase(name);
+}
+
+void Inliner::rewrite_scope(InlineScope& scope, std::initializer_list<StmtList> bodies) {
+  for (StmtList body : bodies) {
+    for (auto stmt : body) collect(stmt, scope);
+  }
+
+  scopes.push_back(&scope);
+  for (StmtList body : bodies) rewrite_body(body);
+  scopes.pop_back();
+}
+
+void Inliner::rewrite_program(Program* program) {
+  InlineScope scope;
+  rewrite_scope(scope, { program->body });
+}
+
+void inline_callables(Program* program) {
+  Inliner inliner(program->arena);
+  inliner.rewrite_program(program);
+}
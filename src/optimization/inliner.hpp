@@ -0,0 +1,22 @@
+#pragma once
+#include "../parsing/ast.hpp"
+
+/*
+Inlines small callables, the first step of the optimizer.
+`const name = callable(params) { expression }` can't be reassigned, so a call `name(args)` that
+comes after it and sees that same declaration is replaced by the expression with the arguments
+put in place of the parameters: no scope, no argument vector, no call.
+
+Only done when the result evaluates exactly like the call would:
+ - the body is one expression without declarations, assignments or nested scopes, of at most
+   INLINE_MAX_NODES nodes, that doesn't name the callable itself
+ - no scope between the declaration and the call declares a name the body uses
+ - the arguments still run once each, in order, before anything the body does that could notice
+*/
+
+constexpr size_t INLINE_MAX_NODES = 16;
+
+// print every inlined call and every callable that was left alone, to stderr
+void set_inline_debug(bool enabled);
+
+void inline_callables(Program* program);
@@ -0,0 +1,248 @@
+#include "licm.hpp"
+#include <unordered_set>
+
+class LoopHoister {
+  private:
+    AstArena& arena;
+    WhileStatement* loop = nullptr;
+    std::unordered_set<Symbol> changed; // every name assigned or declared somewhere in `loop`
+
+    void collect_changed(Stmt* node);
+    bool invariant(Stmt* node);
+    Expr* hoist(Expr* node, bool inside);
+    void hoist_body(StmtList body);
+    void hoist_loop(WhileStatement* whileStmt);
+
+  public:
+    LoopHoister(AstArena& a): arena(a) {}
+
+    void visit(Stmt* node);
+};
+
+// callables declared in the loop count too, they can assign outer names when they're called
+void LoopHoister::collect_changed(Stmt* node) {
+  if (node == nullptr) return;
+
+  if (node->kind == NodeType::AssignmentExpr) {
+    Expr* target = static_cast<AssignmentExpr*>(node)->identifier;
+    if (target->kind == NodeType::Identifier) {
+      changed.insert(static_cast<Identifier*>(target)->symbol);
+    }
+  } else if (node->kind == NodeType::VariableDeclaration) {
+    changed.insert(static_cast<VariableDeclaration*>(node)->identifier);
+  } else if (node->kind == NodeType::ForStatement) {
+    changed.insert(static_cast<ForStatement*>(node)->identifier);
+  } else if (node->kind == NodeType::MatchExpr) {
+    for (const MatchCase& matchCase : static_cast<MatchExpr*>(node)->cases) {
+      for (const MatchPattern& pattern : matchCase.patterns) {
+        for_each_binding(pattern, [&](Symbol name) { changed.insert(name); });
+      }
+    }
+  }
+
+  for_each_child(node, [&](Stmt* child) {
+    collect_changed(child);
+  });
+}
+
+// evaluates to the same value on every iteration, as long as its calls turn out to be pure
+bool LoopHoister::invariant(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::InvariantExpr: // of an outer loop, so of this one as well
+      return true;
+    case NodeType::Identifier:
+      return changed.find(static_cast<Identifier*>(node)->symbol) == changed.end();
+    case NodeType::CallExpr:
+    case NodeType::MemberExpr:
+    case NodeType::SubscriptExpr:
+    case NodeType::NegateExpr:
+    case NodeType::LogicalExpr:
+    case NodeType::ComparisonExpr:
+    case NodeType::BinaryExpr:
+    case NodeType::BitShiftExpr: {
+      bool all = true;
+      for_each_child(node, [&](Stmt* child) {
+        all = all && invariant(child);
+      });
+      return all;
+    }
+    default: // array literals make a new array every time, the rest declares, assigns or runs code
+      return false;
+  }
+}
+
+/*
+Wraps the biggest invariant subexpressions. Below a wrapped node (`inside`) nothing else needs
+wrapping, its value is kept as a whole, except below a call: that one may not be pure, so
+its callee and arguments are kept on their own
+*/
+Expr* LoopHoister::hoist(Expr* node, bool inside) {
+  if (node == nullptr) return node;
+
+  switch (node->kind) {
+    case NodeType::FunctionDeclaration: // runs in its own call, not in the loop
+    case NodeType::InvariantExpr:
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::Identifier:
+      return node;
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      varDec->value = hoist(varDec->value, false);
+      return node;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      if (assign->identifier->kind == NodeType::SubscriptExpr) { // the target stays a target
+        SubscriptExpr* sub = static_cast<SubscriptExpr*>(assign->identifier);
+        sub->value = hoist(sub->value, false);
+      }
+      assign->value = hoist(assign->value, false);
+      return node;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      ifStmt->check = hoist(ifStmt->check, false);
+      hoist_body(ifStmt->body);
+      for (ElseIfBranch& branch : ifStmt->else_if_chain) {
+        branch.check = hoist(branch.check, false);
+        hoist_body(branch.body);
+      }
+      hoist_body(ifStmt->else_body);
+      return node;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      whileStmt->check = hoist(whileStmt->check, false);
+      hoist_body(whileStmt->body);
+      return node;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr** expr : { &forStmt->iterable, &forStmt->start, &forStmt->end, &forStmt->step }) *expr = hoist(*expr, false);
+      hoist_body(forStmt->body);
+      return node;
+    }
+    case NodeType::BlockExpr: {
+      hoist_body(static_cast<BlockExpr*>(node)->body);
+      return node;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      match->value = hoist(match->value, false);
+      for (const MatchCase& matchCase : match->cases) hoist_body(matchCase.body);
+      hoist_body(match->else_body);
+      return node;
+    }
+    case NodeType::SpecialExpr: {
+      for (Expr*& arg : static_cast<SpecialExpr*>(node)->args) arg = hoist(arg, false);
+      return node;
+    }
+    case NodeType::ArrayLiteral: {
+      for (Expr*& elem : static_cast<ArrayLiteral*>(node)->elements) elem = hoist(elem, false);
+      return node;
+    }
+    default:
+      break;
+  }
+
+  // operators, calls, member and subscript expressions
+  Expr* result = node;
+  if (!inside && invariant(node)) {
+    InvariantExpr* wrapped = arena.make<InvariantExpr>();
+    wrapped->expr = node;
+    wrapped->loop = loop;
+    wrapped->slot = loop->invariants++;
+    result = wrapped;
+    inside = true;
+  }
+  if (node->kind == NodeType::CallExpr) {
+    inside = false;
+  }
+
+  switch (node->kind) {
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(node);
+      call->caller = hoist(call->caller, inside);
+      for (Expr*& arg : call->args) arg = hoist(arg, inside);
+      break;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      member->left = hoist(member->left, inside);
+      break;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = static_cast<SubscriptExpr*>(node);
+      sub->left = hoist(sub->left, inside);
+      sub->value = hoist(sub->value, inside);
+      break;
+    }
+    case NodeType::NegateExpr: {
+      NegateExpr* negate = static_cast<NegateExpr*>(node);
+      negate->expr = hoist(negate->expr, inside);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      logical->left = hoist(logical->left, inside);
+      logical->right = hoist(logical->right, inside);
+      break;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      comparison->left = hoist(comparison->left, inside);
+      comparison->right = hoist(comparison->right, inside);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      binary->left = hoist(binary->left, inside);
+      binary->right = hoist(binary->right, inside);
+      break;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      shift->left = hoist(shift->left, inside);
+      shift->right = hoist(shift->right, inside);
+      break;
+    }
+    default:
+      break;
+  }
+  return result;
+}
+
+void LoopHoister::hoist_body(StmtList body) {
+  for (Stmt*& stmt : body) stmt = hoist(static_cast<Expr*>(stmt), false);
+}
+
+void LoopHoister::hoist_loop(WhileStatement* whileStmt) {
+  loop = whileStmt;
+  changed.clear();
+  collect_changed(whileStmt);
+
+  whileStmt->check = hoist(whileStmt->check, false);
+  hoist_body(whileStmt->body);
+}
+
+// outer loops go first, whatever they keep is already invariant for the loops inside them
+void LoopHoister::visit(Stmt* node) {
+  if (node == nullptr) return;
+
+  if (node->kind == NodeType::WhileStatement) {
+    hoist_loop(static_cast<WhileStatement*>(node));
+  }
+  for_each_child(node, [&](Stmt* child) {
+    visit(child);
+  });
+}
+
+void hoist_loop_invariants(Program* program) {
+  LoopHoister hoister(program->arena);
+  for (auto stmt : program->body) hoister.visit(stmt);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "../parsing/ast.hpp"
+
+/*
+Loop invariant code motion, the last step of the optimizer.
+Subexpressions of a while loop (check and body) that only read names the loop never assigns
+get wrapped in an InvariantExpr. The interpreter computes such a value the first time an
+iteration needs it and keeps it for the next ones, as long as nothing ran in between that could
+change what it depends on (a callable, a native that changes values, an array element assignment).
+
+Whether a call can be kept is only known once it runs: calls to natives marked Purity::Pure are,
+anything else is computed again every time. Values are never kept before the loop needs them,
+so a loop that doesn't run, or a value that errors, behaves exactly like before.
+*/
+
+void hoist_loop_invariants(Program* program);
@@ -0,0 +1,389 @@
+#include "optimizer.hpp"
+#include "inliner.hpp"
+#include "licm.hpp"
+#include "types.hpp"
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+static bool optimizerEnabled = true;
+
+void set_optimizer_enabled(bool enabled) {
+  optimizerEnabled = enabled;
+}
+
+static bool is_constant(Stmt* node) {
+  return node->kind == NodeType::NumberLiteral
+    || node->kind == NodeType::StringLiteral
+    || node->kind == NodeType::BooleanLiteral;
+}
+
+static bool is_number(Stmt* node) {
+  return node->kind == NodeType::NumberLiteral;
+}
+
+static bool is_string(Stmt* node) {
+  return node->kind == NodeType::StringLiteral;
+}
+
+static double number_of(Stmt* node) {
+  return static_cast<NumberLiteral*>(node)->value;
+}
+
+static std::string_view string_of(Stmt* node) {
+  return static_cast<StringLiteral*>(node)->value;
+}
+
+static bool is_bool(Stmt* node, bool value) {
+  return node->kind == NodeType::BooleanLiteral && static_cast<BooleanLiteral*>(node)->value == value;
+}
+
+// eval_runtimeval_to_bool for literals
+static bool truthy(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::BooleanLiteral:
+      return static_cast<BooleanLiteral*>(node)->value;
+    case NodeType::NumberLiteral:
+      return number_of(node) != 0.0;
+    default:
+      return !string_of(node).empty();
+  }
+}
+
+// statements that can be skipped when their value isn't used
+static bool is_pure(Stmt* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+    case NodeType::StringLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::FunctionDeclaration:
+      return true;
+    case NodeType::BlockExpr:
+      return static_cast<BlockExpr*>(node)->body.empty();
+    case NodeType::ArrayLiteral: {
+      for (auto elem : static_cast<ArrayLiteral*>(node)->elements) {
+        if (!is_pure(elem)) return false;
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+class Optimizer {
+  private:
+    AstArena& arena;
+
+    Expr* make_number(double value) {
+      NumberLiteral* numLit = arena.make<NumberLiteral>();
+      numLit->value = value;
+      return numLit;
+    }
+
+    Expr* make_string(std::string_view value) {
+      StringLiteral* strLit = arena.make<StringLiteral>();
+      strLit->value = arena.copy_string(value);
+      return strLit;
+    }
+
+    Expr* make_bool(bool value) {
+      BooleanLiteral* boolLit = arena.make<BooleanLiteral>();
+      boolLit->value = value;
+      return boolLit;
+    }
+
+    Expr* make_block(StmtList body) {
+      BlockExpr* block = arena.make<BlockExpr>();
+      block->body = body;
+      return block;
+    }
+
+    Expr* fold_binary(BinaryExpr* binary);
+    Expr* fold_comparison(ComparisonExpr* comparison);
+    Expr* fold_if(IfStatement* ifStmt);
+
+  public:
+    Optimizer(AstArena& a): arena(a) {}
+
+    Expr* optimize(Expr* node);
+    StmtList optimize_body(StmtList body, bool dropPure = true);
+};
+
+// same as eval_binary_expr: numbers do math, two strings concatenate whatever the operator
+Expr* Optimizer::fold_binary(BinaryExpr* binary) {
+  Expr* left = binary->left;
+  Expr* right = binary->right;
+
+  if (is_number(left) && is_number(right)) {
+    double a = number_of(left);
+    double b = number_of(right);
+    switch (binary->expr_operator) {
+      case OperatorType::add: return make_number(a + b);
+      case OperatorType::substract: return make_number(a - b);
+      case OperatorType::multiply: return make_number(a * b);
+      case OperatorType::divide: return make_number(a / b);
+      case OperatorType::modulo: return make_number(std::fmod(a, b));
+    }
+  }
+  if (is_string(left) && is_string(right)) {
+    return make_string(std::string(string_of(left)) + std::string(string_of(right)));
+  }
+  return binary;
+}
+
+// same as eval_comparison_expr, except orderings of non numbers which are runtime errors
+Expr* Optimizer::fold_comparison(ComparisonExpr* comparison) {
+  Expr* left = comparison->left;
+  Expr* right = comparison->right;
+  if (!is_constant(left) || !is_constant(right)) return comparison;
+
+  bool sameKind = left->kind == right->kind;
+  bool equal = false;
+  if (sameKind && is_number(left)) {
+    equal = number_of(left) == number_of(right);
+  } else if (sameKind && is_string(left)) {
+    equal = string_of(left) == string_of(right);
+  } else if (sameKind) {
+    equal = static_cast<BooleanLiteral*>(left)->value == static_cast<BooleanLiteral*>(right)->value;
+  }
+
+  switch (comparison->op) {
+    case ComparisonOperatorType::equal:
+      return make_bool(sameKind && equal);
+    case ComparisonOperatorType::not_equal:
+      return make_bool(!(sameKind && equal));
+    default:
+      break;
+  }
+
+  if (!is_number(left) || !is_number(right)) return comparison;
+  double a = number_of(left);
+  double b = number_of(right);
+  switch (comparison->op) {
+    case ComparisonOperatorType::greater: return make_bool(a > b);
+    case ComparisonOperatorType::greater_equal: return make_bool(a >= b);
+    case ComparisonOperatorType::less: return make_bool(a < b);
+    case ComparisonOperatorType::less_equal: return make_bool(a <= b);
+    default: return comparison;
+  }
+}
+
+/*
+Branches with a constant check are resolved here:
+ - else_ifs that are always false disappear, one that's always true becomes the else
+ - an if that's always true becomes its body (still in its own scope, so locals behave the same)
+ - an if that's always false hands over to the first else_if left, or to the else
+Only literal `true`/`false` (made by folding) count, a non boolean check is kept so it still errors
+*/
+Expr* Optimizer::fold_if(IfStatement* ifStmt) {
+  if (is_bool(ifStmt->check, true)) {
+    return make_block(ifStmt->body);
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < ifStmt->else_if_chain.size(); i++) {
+    ElseIfBranch branch = ifStmt->else_if_chain[i];
+    if (is_bool(branch.check, false)) continue;
+    if (is_bool(branch.check, true)) {
+      ifStmt->else_body = branch.body;
+      break;
+    }
+    ifStmt->else_if_chain[kept++] = branch;
+  }
+  ifStmt->else_if_chain.count = static_cast<uint32_t>(kept);
+
+  if (!is_bool(ifStmt->check, false)) return ifStmt;
+
+  if (ifStmt->else_if_chain.empty()) {
+    return make_block(ifStmt->else_body);
+  }
+  ifStmt->check = ifStmt->else_if_chain[0].check;
+  ifStmt->body = ifStmt->else_if_chain[0].body;
+  ifStmt->else_if_chain.items++;
+  ifStmt->else_if_chain.count--;
+  return ifStmt;
+}
+
+// rewrites the children first, then tries to fold the node itself. Returns what replaces it
+Expr* Optimizer::optimize(Expr* node) {
+  if (node == nullptr) return node;
+
+  switch (node->kind) {
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      varDec->value = optimize(varDec->value);
+      return varDec;
+    }
+    case NodeType::FunctionDeclaration: {
+      FunctionDeclaration* funcDec = static_cast<FunctionDeclaration*>(node);
+      funcDec->body = optimize_body(funcDec->body);
+      return funcDec;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      ifStmt->check = optimize(ifStmt->check);
+      ifStmt->body = optimize_body(ifStmt->body);
+      for (ElseIfBranch& branch : ifStmt->else_if_chain) {
+        branch.check = optimize(branch.check);
+        branch.body = optimize_body(branch.body);
+      }
+      ifStmt->else_body = optimize_body(ifStmt->else_body);
+      return fold_if(ifStmt);
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      whileStmt->check = optimize(whileStmt->check);
+      // a loop's value is the last statement that ran before a break/continue, so nothing is dropped
+      whileStmt->body = optimize_body(whileStmt->body, false);
+      if (is_bool(whileStmt->check, false)) {
+        return make_block(StmtList());
+      }
+      return whileStmt;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr** expr : { &forStmt->iterable, &forStmt->start, &forStmt->end, &forStmt->step }) *expr = optimize(*expr);
+      forStmt->body = optimize_body(forStmt->body, false);
+      return forStmt;
+    }
+    case NodeType::BlockExpr: {
+      BlockExpr* block = static_cast<BlockExpr*>(node);
+      block->body = optimize_body(block->body);
+      return block;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      match->value = optimize(match->value);
+      for (MatchCase& matchCase : match->cases) matchCase.body = optimize_body(matchCase.body);
+      match->else_body = optimize_body(match->else_body);
+      return match;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      if (assign->identifier->kind == NodeType::SubscriptExpr) { // only the index, the target stays a target
+        SubscriptExpr* sub = static_cast<SubscriptExpr*>(assign->identifier);
+        sub->value = optimize(sub->value);
+      }
+      assign->value = optimize(assign->value);
+      return assign;
+    }
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(node);
+      call->caller = optimize(call->caller);
+      for (Expr*& arg : call->args) arg = optimize(arg);
+      return call;
+    }
+    case NodeType::SpecialExpr: {
+      SpecialExpr* special = static_cast<SpecialExpr*>(node);
+      for (Expr*& arg : special->args) arg = optimize(arg);
+      return special;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = static_cast<SubscriptExpr*>(node);
+      sub->left = optimize(sub->left);
+      sub->value = optimize(sub->value);
+
+      // "abc"[1], out of range stays a runtime error
+      if (is_string(sub->left) && is_number(sub->value)) {
+        std::string_view str = string_of(sub->left);
+        double index = number_of(sub->value);
+        if (index > -1 && index < static_cast<double>(str.size())) {
+          return make_string(str.substr(static_cast<size_t>(static_cast<int>(index)), 1));
+        }
+      }
+      return sub;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      member->left = optimize(member->left);
+      return member;
+    }
+    case NodeType::NegateExpr: {
+      NegateExpr* negate = static_cast<NegateExpr*>(node);
+      negate->expr = optimize(negate->expr);
+
+      Expr* expr = negate->expr;
+      if (expr->kind == NodeType::BooleanLiteral) return make_bool(!static_cast<BooleanLiteral*>(expr)->value);
+      if (is_number(expr)) return make_bool(number_of(expr) == 0.0);
+      if (is_string(expr)) return make_bool(false);
+      return negate;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      logical->left = optimize(logical->left);
+      logical->right = optimize(logical->right);
+      if (is_constant(logical->left)) {
+        // short-circuits, the right side never runs
+        bool a = truthy(logical->left);
+        if (logical->op == LogicalOperatorType::And && !a) return make_bool(false);
+        if (logical->op == LogicalOperatorType::Or && a) return make_bool(true);
+      }
+      if (!is_constant(logical->left) || !is_constant(logical->right)) return logical;
+
+      bool a = truthy(logical->left);
+      bool b = truthy(logical->right);
+      switch (logical->op) {
+        case LogicalOperatorType::And: return make_bool(a && b);
+        case LogicalOperatorType::Or: return make_bool(a || b);
+        case LogicalOperatorType::Xor: return make_bool(a ^ b);
+      }
+      return logical;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      comparison->left = optimize(comparison->left);
+      comparison->right = optimize(comparison->right);
+      return fold_comparison(comparison);
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      binary->left = optimize(binary->left);
+      binary->right = optimize(binary->right);
+      return fold_binary(binary);
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      shift->left = optimize(shift->left);
+      shift->right = optimize(shift->right);
+      if (!is_number(shift->left) || !is_number(shift->right)) return shift;
+
+      // the interpreter shifts ints, leave anything that wouldn't fit (or shift) cleanly to it
+      double value = number_of(shift->left);
+      double by = number_of(shift->right);
+      if (value <= INT32_MIN - 1.0 || value >= INT32_MAX + 1.0 || by <= -1 || by >= 32) return shift;
+      int a = static_cast<int>(value);
+      int b = static_cast<int>(by);
+      if (a < 0 && !shift->shiftRight) return shift;
+      return make_number(shift->shiftRight ? a >> b : a << b);
+    }
+    case NodeType::ArrayLiteral: {
+      for (Expr*& elem : static_cast<ArrayLiteral*>(node)->elements) elem = optimize(elem);
+      return node;
+    }
+    default: // literals, identifiers
+      return node;
+  }
+}
+
+// the last statement is the value of the body, everything before it only matters for its effects
+StmtList Optimizer::optimize_body(StmtList body, bool dropPure) {
+  size_t kept = 0;
+  for (size_t i = 0; i < body.size(); i++) {
+    Stmt* stmt = optimize(static_cast<Expr*>(body[i]));
+    bool last = i + 1 == body.size();
+    if (dropPure && !last && is_pure(stmt)) continue;
+    body[kept++] = stmt;
+  }
+  body.count = static_cast<uint32_t>(kept);
+  return body;
+}
+
+void optimize_program(Program* program) {
+  if (!optimizerEnabled) return;
+  inline_callables(program);
+  Optimizer optimizer(program->arena);
+  program->body = optimizer.optimize_body(program->body);
+  hoist_loop_invariants(program);
+  infer_types(program);
+}
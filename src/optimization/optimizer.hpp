@@ -0,0 +1,20 @@
+#pragma once
+#include "../parsing/ast.hpp"
+
+/*
+AST optimization pass, runs on every program between parsing and evaluation.
+ - inlines calls to small const callables, see inliner.hpp
+ - folds operators whose operands are all literals into a single literal
+ - replaces ifs/else_ifs/whiles with a constant check by the branch that's always taken
+ - drops statements that can't do anything (literals in the middle of a body)
+ - marks values that don't change while a loop runs, see licm.hpp
+ - marks assignments of numbers that can skip allocating, see types.hpp
+
+It only folds what the interpreter would compute the same way every time, anything that
+would raise an error or depends on a variable (`true` and `false` included, they can be
+shadowed) is left for the interpreter. New nodes go into the program's own arena.
+*/
+
+void set_optimizer_enabled(bool enabled);
+
+void optimize_program(Program* program);
@@ -0,0 +1,316 @@
+#include "resolver.hpp"
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+// a scope while it's being resolved
+struct Scope {
+  std::vector<Symbol> names;
+  std::unordered_map<Symbol, uint32_t> slots;
+  const ScopeLayout* layout = nullptr;
+
+  void add(Symbol symbol) {
+    if (slots.emplace(symbol, static_cast<uint32_t>(names.size())).second) {
+      names.push_back(symbol);
+    }
+  }
+};
+
+class Resolver {
+  private:
+    AstArena& arena;
+    std::vector<Scope*> scopes; // innermost last
+
+    void collect(Stmt* node, Scope& scope);
+    void collect_list(StmtList body, Scope& scope);
+    VarRef lookup(Symbol symbol, size_t start, size_t base);
+    const ScopeLayout* build(Scope& scope);
+    const ScopeLayout* resolve_scope(Scope& scope, std::initializer_list<StmtList> bodies);
+    void resolve_list(StmtList body);
+
+  public:
+    Resolver(AstArena& a): arena(a) {}
+
+    void resolve(Stmt* node);
+    void resolve_program(Program* program);
+};
+
+// names declared by code that runs directly in this scope. Nested scopes are skipped,
+// but the checks of ifs and whiles (and what a for goes over) run in the scope around them
+void Resolver::collect(Stmt* node, Scope& scope) {
+  if (node == nullptr) return;
+
+  switch (node->kind) {
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      if (assign->identifier->kind == NodeType::Identifier) {
+        scope.add(static_cast<Identifier*>(assign->identifier)->symbol);
+      } else {
+        collect(assign->identifier, scope);
+      }
+      collect(assign->value, scope);
+      break;
+    }
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      scope.add(varDec->identifier);
+      collect(varDec->value, scope);
+      break;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      collect(ifStmt->check, scope);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) collect(branch.check, scope);
+      break;
+    }
+    case NodeType::WhileStatement: {
+      collect(static_cast<WhileStatement*>(node)->check, scope);
+      break;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr* expr : { forStmt->iterable, forStmt->start, forStmt->end, forStmt->step }) collect(expr, scope);
+      break;
+    }
+    case NodeType::MatchExpr: {
+      collect(static_cast<MatchExpr*>(node)->value, scope);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+    case NodeType::BlockExpr:
+      break;
+    default:
+      for_each_child(node, [&](Stmt* child) {
+        collect(child, scope);
+      });
+  }
+}
+
+void Resolver::collect_list(StmtList body, Scope& scope) {
+  for (auto stmt : body) collect(stmt, scope);
+}
+
+// closest scope from scopes[start] outwards that may hold the name, hops counted from scopes[base]
+VarRef Resolver::lookup(Symbol symbol, size_t start, size_t base) {
+  VarRef ref;
+  for (size_t i = start + 1; i-- > 0;) {
+    auto found = scopes[i]->slots.find(symbol);
+    if (found != scopes[i]->slots.end()) {
+      ref.layout = scopes[i]->layout;
+      ref.depth = static_cast<uint32_t>(base - i);
+      ref.slot = found->second;
+      return ref;
+    }
+  }
+  ref.depth = static_cast<uint32_t>(base); // by name, from the program's own scope outwards
+  return ref;
+}
+
+// `scope` has to be the innermost one already
+const ScopeLayout* Resolver::build(Scope& scope) {
+  size_t index = scopes.size() - 1;
+  size_t count = scope.names.size();
+
+  ScopeLayout* layout = arena.make<ScopeLayout>();
+  layout->slots = arena.make_list<ScopeSlot>(count);
+  for (size_t i = 0; i < count; i++) {
+    ScopeSlot& slot = layout->slots[i];
+    slot.symbol = scope.names[i];
+    slot.outer = index == 0 ? VarRef() : lookup(slot.symbol, index - 1, index);
+  }
+
+  if (count > 0) {
+    size_t tableSize = 1;
+    while (tableSize < count * 2) tableSize *= 2;
+    layout->table = arena.make_list<uint32_t>(tableSize);
+    for (uint32_t& entry : layout->table) entry = 0;
+
+    size_t mask = tableSize - 1;
+    for (size_t i = 0; i < count; i++) {
+      size_t at = ScopeLayout::hash(scope.names[i]) & mask;
+      while (layout->table[at] != 0) at = (at + 1) & mask;
+      layout->table[at] = static_cast<uint32_t>(i + 1);
+    }
+  }
+
+  scope.layout = layout;
+  return layout;
+}
+
+const ScopeLayout* Resolver::resolve_scope(Scope& scope, std::initializer_list<StmtList> bodies) {
+  for (StmtList body : bodies) collect_list(body, scope);
+
+  scopes.push_back(&scope);
+  const ScopeLayout* layout = build(scope);
+  for (StmtList body : bodies) resolve_list(body);
+  scopes.pop_back();
+
+  return layout;
+}
+
+void Resolver::resolve_list(StmtList body) {
+  for (auto stmt : body) resolve(stmt);
+}
+
+// whether something in the body can still get at the callable's scope once it returned:
+// a closure made in it, or whatever @include declared in it
+static bool keeps_scope(Stmt* node) {
+  bool keeps = false;
+  for_each_child(node, [&](Stmt* child) {
+    if (keeps || child == nullptr) return;
+    if (child->kind == NodeType::FunctionDeclaration) {
+      keeps = true;
+    } else if (child->kind == NodeType::SpecialExpr && static_cast<SpecialExpr*>(child)->identifier == SYM_INCLUDE) {
+      keeps = true;
+    } else {
+      keeps = keeps_scope(child);
+    }
+  });
+  return keeps;
+}
+
+// the last statement of a callable gives its value, so does the last one of each branch of
+// an if (or a block) that comes last
+static void mark_tail_calls(StmtList body, bool reuseScope) {
+  if (body.empty()) return;
+  Stmt* last = body.back();
+  switch (last->kind) {
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(last);
+      call->tail = true;
+      call->reuseScope = reuseScope;
+      break;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(last);
+      mark_tail_calls(ifStmt->body, reuseScope);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) mark_tail_calls(branch.body, reuseScope);
+      mark_tail_calls(ifStmt->else_body, reuseScope);
+      break;
+    }
+    case NodeType::BlockExpr:
+      mark_tail_calls(static_cast<BlockExpr*>(last)->body, reuseScope);
+      break;
+    default:
+      break;
+  }
+}
+
+// callables have no names of their own, messages call them by the first variable they're given to
+static void name_callable(Expr* value, Symbol name) {
+  if (value == nullptr || value->kind != NodeType::FunctionDeclaration) return;
+  FunctionDeclaration* funcDec = static_cast<FunctionDeclaration*>(value);
+  if (funcDec->name == SYM_EMPTY) funcDec->name = name;
+}
+
+void Resolver::resolve(Stmt* node) {
+  if (node == nullptr) return;
+  size_t current = scopes.size() - 1;
+
+  switch (node->kind) {
+    case NodeType::Identifier: {
+      Identifier* iden = static_cast<Identifier*>(node);
+      iden->ref = lookup(iden->symbol, current, current);
+      break;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      if (assign->identifier->kind == NodeType::Identifier) {
+        // collect() gave the name a slot right here, the slot's chain covers the outer scopes
+        Identifier* target = static_cast<Identifier*>(assign->identifier);
+        target->ref = lookup(target->symbol, current, current);
+        name_callable(assign->value, target->symbol);
+      } else {
+        resolve(assign->identifier);
+      }
+      resolve(assign->value);
+      break;
+    }
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      varDec->ref = lookup(varDec->identifier, current, current);
+      name_callable(varDec->value, varDec->identifier);
+      resolve(varDec->value);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      FunctionDeclaration* funcDec = static_cast<FunctionDeclaration*>(node);
+      Scope scope;
+      for (Symbol param : funcDec->parameters) scope.add(param);
+      funcDec->layout = resolve_scope(scope, { funcDec->body });
+      mark_tail_calls(funcDec->body, !keeps_scope(funcDec));
+      break;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      resolve(ifStmt->check);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) resolve(branch.check);
+
+      // every branch runs in the same scope
+      Scope scope;
+      collect_list(ifStmt->body, scope);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) collect_list(branch.body, scope);
+      collect_list(ifStmt->else_body, scope);
+
+      scopes.push_back(&scope);
+      ifStmt->layout = build(scope);
+      resolve_list(ifStmt->body);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) resolve_list(branch.body);
+      resolve_list(ifStmt->else_body);
+      scopes.pop_back();
+      break;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      resolve(whileStmt->check);
+      Scope scope;
+      whileStmt->layout = resolve_scope(scope, { whileStmt->body });
+      break;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr* expr : { forStmt->iterable, forStmt->start, forStmt->end, forStmt->step }) resolve(expr);
+      Scope scope;
+      scope.add(forStmt->identifier);
+      forStmt->layout = resolve_scope(scope, { forStmt->body });
+      forStmt->ref.layout = forStmt->layout;
+      forStmt->ref.depth = 0;
+      forStmt->ref.slot = 0;
+      break;
+    }
+    case NodeType::BlockExpr: {
+      BlockExpr* block = static_cast<BlockExpr*>(node);
+      Scope scope;
+      block->layout = resolve_scope(scope, { block->body });
+      break;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      resolve(match->value);
+      for (MatchCase& matchCase : match->cases) {
+        Scope scope;
+        for (const MatchPattern& pattern : matchCase.patterns) {
+          for_each_binding(pattern, [&](Symbol name) { scope.add(name); });
+        }
+        matchCase.layout = resolve_scope(scope, { matchCase.body });
+      }
+      Scope elseScope;
+      match->else_layout = resolve_scope(elseScope, { match->else_body });
+      break;
+    }
+    default:
+      for_each_child(node, [&](Stmt* child) {
+        resolve(child);
+      });
+  }
+}
+
+void Resolver::resolve_program(Program* program) {
+  Scope scope;
+  program->layout = resolve_scope(scope, { program->body });
+}
+
+void resolve_program(Program* program) {
+  Resolver resolver(program->arena);
+  resolver.resolve_program(program);
+}
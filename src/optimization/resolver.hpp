@@ -0,0 +1,16 @@
+#pragma once
+#include "../parsing/ast.hpp"
+
+/*
+Scope resolution pass, runs after the optimizer.
+Every scope the interpreter creates (program, callable call, if, while, block) gets a ScopeLayout
+with a slot for each name that can be declared in it. Identifiers, assignments and const
+declarations get a VarRef pointing at the closest slot their name can live in, so the interpreter
+can find variables by walking a known number of scopes and indexing, without hashing names.
+
+Names can't always be pinned down: something declared in an outer scope only on some paths,
+things from @include, the built-ins, the REPL. Slots chain to the next place the name may be and
+the chain ends in a by-name lookup, so the result is always the same as the plain lookup.
+*/
+
+void resolve_program(Program* program);
@@ -0,0 +1,283 @@
+#include "types.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+enum class Type : uint8_t {
+  Number,
+  Bool,
+  String,
+  Any,
+};
+
+// the type of each name at one point of a body, a name that isn't in it can be anything
+using Types = std::unordered_map<Symbol, Type>;
+
+// what's still known when either of two ways could have been taken
+static Types join(const Types& a, const Types& b) {
+  Types joined;
+  for (const auto& [name, type] : a) {
+    auto other = b.find(name);
+    if (other != b.end() && other->second == type) joined.emplace(name, type);
+  }
+  return joined;
+}
+
+// names assigned by a callable declared in `node`, they can change whenever it's called
+static void collect_shared(Stmt* node, bool inCallable, std::unordered_set<Symbol>& shared) {
+  if (node == nullptr) return;
+
+  if (inCallable && node->kind == NodeType::AssignmentExpr) {
+    AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+    if (!assign->local && assign->identifier->kind == NodeType::Identifier) {
+      shared.insert(static_cast<Identifier*>(assign->identifier)->symbol);
+    }
+  }
+  bool inside = inCallable || node->kind == NodeType::FunctionDeclaration;
+  for_each_child(node, [&](Stmt* child) {
+    collect_shared(child, inside, shared);
+  });
+}
+
+class TypeInference {
+  private:
+    Types types;
+    std::unordered_set<Symbol> shared;
+
+    Type type_of(Symbol name);
+    void assign(Symbol name, Type type);
+    bool numeric(Expr* node);
+    void walk_body(StmtList body, bool used);
+    template <typename Fn>
+    void walk_loop(StmtList body, bool used, Fn&& next);
+    Type walk(Stmt* node, bool used);
+
+  public:
+    void infer_body(StmtList body);
+};
+
+Type TypeInference::type_of(Symbol name) {
+  if (shared.count(name) > 0) return Type::Any;
+  auto found = types.find(name);
+  return found != types.end() ? found->second : Type::Any;
+}
+
+void TypeInference::assign(Symbol name, Type type) {
+  if (type == Type::Any || shared.count(name) > 0) {
+    types.erase(name);
+  } else {
+    types[name] = type;
+  }
+}
+
+// what eval_number can compute: numbers, names that hold one and arithmetic on them
+bool TypeInference::numeric(Expr* node) {
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+      return true;
+    case NodeType::Identifier:
+      return type_of(static_cast<Identifier*>(node)->symbol) == Type::Number;
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      return numeric(binary->left) && numeric(binary->right);
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      return numeric(shift->left) && numeric(shift->right);
+    }
+    case NodeType::InvariantExpr:
+      return numeric(static_cast<InvariantExpr*>(node)->expr);
+    default:
+      return false;
+  }
+}
+
+// only the last statement gives the body's value
+void TypeInference::walk_body(StmtList body, bool used) {
+  for (size_t i = 0; i < body.size(); i++) {
+    walk(body[i], used && i + 1 == body.size());
+  }
+}
+
+/*
+`next` walks what decides whether there's another iteration (a while's check, a for taking
+the next value), the loop can end right after it. Any statement can end the loop (break) or
+start the next iteration (continue), so both see what's known after each of them. The body
+is walked again until the start of an iteration stays the same, the last walk is the one
+whose marks stay.
+*/
+template <typename Fn>
+void TypeInference::walk_loop(StmtList body, bool used, Fn&& next) {
+  while (true) {
+    Types start = types;
+    next();
+    Types exit = types;
+    Types again = start;
+    for (Stmt* stmt : body) {
+      // the loop's value is whatever statement ran last
+      walk(stmt, used);
+      exit = join(exit, types);
+      again = join(again, types);
+    }
+    if (again == start) {
+      types = exit;
+      return;
+    }
+    types = again;
+  }
+}
+
+// walks `node` in the order it runs and gives its type, `used` says whether anything looks at its value
+Type TypeInference::walk(Stmt* node, bool used) {
+  if (node == nullptr) return Type::Any;
+
+  switch (node->kind) {
+    case NodeType::NumberLiteral:
+      return Type::Number;
+    case NodeType::StringLiteral:
+      return Type::String;
+    case NodeType::BooleanLiteral:
+      return Type::Bool;
+    case NodeType::Identifier:
+      return type_of(static_cast<Identifier*>(node)->symbol);
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      Type type = walk(varDec->value, true);
+      assign(varDec->identifier, type);
+      return type;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assignment = static_cast<AssignmentExpr*>(node);
+      if (assignment->identifier->kind != NodeType::Identifier) {
+        walk(assignment->identifier, true);
+        return walk(assignment->value, true);
+      }
+      Type type = walk(assignment->value, true);
+      assignment->unboxed = !used && numeric(assignment->value);
+      assign(static_cast<Identifier*>(assignment->identifier)->symbol, type);
+      return type;
+    }
+    case NodeType::FunctionDeclaration:
+      return Type::Any; // a body of its own, see infer_types
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      walk(ifStmt->check, true);
+      Types checked = types;
+      walk_body(ifStmt->body, used);
+      Types joined = types;
+
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) {
+        types = checked;
+        walk(branch.check, true);
+        checked = types;
+        walk_body(branch.body, used);
+        joined = join(joined, types);
+      }
+
+      types = checked;
+      walk_body(ifStmt->else_body, used);
+      types = join(joined, types);
+      return Type::Any;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      walk_loop(whileStmt->body, used, [&]() { walk(whileStmt->check, true); });
+      return Type::Any;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr* expr : { forStmt->iterable, forStmt->start, forStmt->end, forStmt->step }) walk(expr, true);
+      // the name is the loop's own, whatever it was outside is still there afterwards
+      Type outside = type_of(forStmt->identifier);
+      Type each = forStmt->iterable == nullptr ? Type::Number : Type::Any;
+      walk_loop(forStmt->body, used, [&]() { assign(forStmt->identifier, each); });
+      assign(forStmt->identifier, outside);
+      return Type::Any;
+    }
+    case NodeType::BlockExpr:
+      walk_body(static_cast<BlockExpr*>(node)->body, used);
+      return Type::Any;
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      walk(match->value, true);
+      Types matched = types;
+      walk_body(match->else_body, used);
+      Types joined = types;
+
+      for (const MatchCase& matchCase : match->cases) {
+        types = matched;
+        for (const MatchPattern& pattern : matchCase.patterns) {
+          for_each_binding(pattern, [&](Symbol name) { assign(name, Type::Any); });
+        }
+        walk_body(matchCase.body, used);
+        joined = join(joined, types);
+      }
+      types = joined;
+      return Type::Any;
+    }
+    case NodeType::SpecialExpr: {
+      SpecialExpr* special = static_cast<SpecialExpr*>(node);
+      for (Expr* arg : special->args) walk(arg, true);
+      if (special->identifier == SYM_INCLUDE) types.clear(); // it can assign anything in here
+      return Type::Any;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      walk(logical->left, true);
+      Types left = types;
+      walk(logical->right, true);
+      if (logical->op != LogicalOperatorType::Xor) types = join(left, types); // the right side may not run
+      return Type::Bool;
+    }
+    case NodeType::ComparisonExpr:
+    case NodeType::NegateExpr:
+      for_each_child(node, [&](Stmt* child) {
+        walk(child, true);
+      });
+      return Type::Bool;
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      Type left = walk(binary->left, true);
+      Type right = walk(binary->right, true);
+      if (left == Type::Number && right == Type::Number) return Type::Number;
+      if (binary->expr_operator == OperatorType::add && left == Type::String && right == Type::String) return Type::String;
+      return Type::Any;
+    }
+    case NodeType::BitShiftExpr:
+      for_each_child(node, [&](Stmt* child) {
+        walk(child, true);
+      });
+      return Type::Number;
+    case NodeType::InvariantExpr:
+      return walk(static_cast<InvariantExpr*>(node)->expr, used);
+    default:
+      for_each_child(node, [&](Stmt* child) {
+        walk(child, true);
+      });
+      return Type::Any;
+  }
+}
+
+void TypeInference::infer_body(StmtList body) {
+  for (Stmt* stmt : body) collect_shared(stmt, false, shared);
+  walk_body(body, true);
+}
+
+// callables are inferred on their own, nothing around one tells what it gets called with
+static void infer_callables(Stmt* node) {
+  if (node == nullptr) return;
+
+  if (node->kind == NodeType::FunctionDeclaration) {
+    TypeInference inference;
+    inference.infer_body(static_cast<FunctionDeclaration*>(node)->body);
+  }
+  for_each_child(node, [&](Stmt* child) {
+    infer_callables(child);
+  });
+}
+
+void infer_types(Program* program) {
+  TypeInference inference;
+  inference.infer_body(program->body);
+  for (Stmt* stmt : program->body) infer_callables(stmt);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "../parsing/ast.hpp"
+
+/*
+Type inference, runs after loop invariant code motion.
+The program and every callable body are walked the way they run, keeping the type each name
+has at that point: a number, a bool, a string, or anything. Branches join what they leave
+behind, loops are walked until their types stop changing. Parameters, match bindings and
+names a nested callable assigns can be anything.
+
+An assignment whose value is arithmetic on numbers and whose own value nothing uses is marked
+AssignmentExpr::unboxed. The interpreter and the VM compute it without a NumberVal for every
+step and write it into the one the variable owns (Environment::assignNumber), so a numeric
+loop doesn't allocate. The types are only a hint: what runs still checks them, a wrong guess
+costs time but never changes a result.
+*/
+
+void infer_types(Program* program);
@@ -0,0 +1,46 @@
+#include "ast.hpp"
+#include <cstdlib>
+#include <cstring>
+
+AstArena::~AstArena() {
+  for (char* block : blocks) {
+    std::free(block);
+  }
+}
+
+static uintptr_t align_up(const char* ptr, size_t align) {
+  return (reinterpret_cast<uintptr_t>(ptr) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+}
+
+void* AstArena::allocate(size_t size, size_t align) {
+  used += size;
+
+  // big lists (huge array literals) get a block of their own, the current block keeps filling up
+  if (size + align > BLOCK_SIZE / 4) {
+    char* block = static_cast<char*>(std::malloc(size + align));
+    if (block == nullptr) throw std::bad_alloc();
+    blocks.push_back(block);
+    return reinterpret_cast<void*>(align_up(block, align));
+  }
+
+  uintptr_t aligned = align_up(cursor, align);
+  if (cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+    char* block = static_cast<char*>(std::malloc(BLOCK_SIZE));
+    if (block == nullptr) throw std::bad_alloc();
+    blocks.push_back(block);
+
+    cursor = block;
+    limit = block + BLOCK_SIZE;
+    aligned = align_up(cursor, align);
+  }
+
+  cursor = reinterpret_cast<char*>(aligned + size);
+  return reinterpret_cast<void*>(aligned);
+}
+
+std::string_view AstArena::copy_string(std::string_view str) {
+  if (str.empty()) return std::string_view();
+  char* bytes = static_cast<char*>(allocate(str.size(), 1));
+  std::memcpy(bytes, str.data(), str.size());
+  return std::string_view(bytes, str.size());
+}
@@ -1,6 +1,17 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include "symbols.hpp"
+
+class RuntimeVal;
+struct MatchTable;
+struct Chunk;
+struct JitCode;
 
 enum class NodeType {
   // EXPRESSIONS
@@ -9,6 +20,7 @@ enum class NodeType {
   FunctionDeclaration,
   IfStatement,
   WhileStatement,
+  BlockExpr,
 
   AssignmentExpr,
   CallExpr,
@@ -23,9 +35,13 @@ enum class NodeType {
   StringLiteral,
   ArrayLiteral,
   NumberLiteral,
+  BooleanLiteral,
   Identifier,
   BinaryExpr,
   BitShiftExpr,
+  InvariantExpr,
+  MatchExpr,
+  ForStatement,
 };
 
 enum class OperatorType {
@@ -51,6 +67,161 @@ enum class LogicalOperatorType {
   Xor,
 };
 
+/*
+What an operator node turned itself into after it ran (quickening, see quicken() in
+interpreter.cpp). The specialized forms only check that the operands are still the types
+they saw, a node whose guard fails goes back to Unseen and gives up after a few tries.
+Only the tree-walker looks at this, every other pass sees the node's own kind.
+*/
+enum class Quick : uint8_t {
+  Unseen,
+  Generic,
+  NumberAdd,
+  NumberSubtract,
+  NumberMultiply,
+  NumberDivide,
+  NumberModulo,
+  StringConcat,
+  NumberEqual,
+  NumberNotEqual,
+  NumberGreaterEqual,
+  NumberGreater,
+  NumberLessEqual,
+  NumberLess,
+  StringEqual,
+  StringNotEqual,
+  NumberShiftLeft,
+  NumberShiftRight,
+};
+
+struct QuickState {
+  Quick form = Quick::Unseen;
+  uint8_t deopts = 0;
+};
+
+// how a callable or loop runs, it moves up once it's hot (src/interpretation/vm/tiers.hpp)
+enum class Tier : uint8_t {
+  TreeWalker,
+  VM,
+  Native,
+};
+
+// A run of items stored inside an AstArena
+template <typename T>
+class NodeList {
+  public:
+    T* items = nullptr;
+    uint32_t count = 0;
+
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) const { return items[i]; }
+    T& back() const { return items[count - 1]; }
+};
+
+/*
+Bump allocator owned by a Program. Every node, list and string of that program is carved
+out of a few big blocks, siblings end up next to each other in memory and the whole tree
+is released in one go when the Program is deleted.
+Nothing allocated here is ever destructed, so nodes have to stay trivially destructible.
+*/
+class AstArena {
+  private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<char*> blocks;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t used = 0;
+
+  public:
+    AstArena() = default;
+    ~AstArena();
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    void* allocate(size_t size, size_t align);
+
+    template <typename T>
+    T* make() {
+      static_assert(std::is_trivially_destructible<T>::value, "arena nodes are never destructed");
+      return new (allocate(sizeof(T), alignof(T))) T();
+    }
+
+    // uninitialised list of `count` items
+    template <typename T>
+    NodeList<T> make_list(size_t count) {
+      static_assert(std::is_trivially_destructible<T>::value, "arena lists are never destructed");
+      NodeList<T> list;
+      if (count == 0) return list;
+      list.items = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+      list.count = static_cast<uint32_t>(count);
+      return list;
+    }
+
+    template <typename T>
+    NodeList<T> copy_list(const T* items, size_t count) {
+      NodeList<T> list;
+      if (count == 0) return list;
+      list.items = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+      list.count = static_cast<uint32_t>(count);
+      for (size_t i = 0; i < count; i++) {
+        new (&list.items[i]) T(items[i]);
+      }
+      return list;
+    }
+
+    template <typename T>
+    NodeList<T> copy_list(const std::vector<T>& items) {
+      return copy_list(items.data(), items.size());
+    }
+
+    std::string_view copy_string(std::string_view str);
+
+    size_t bytes_used() const { return used; }
+};
+
+class ScopeLayout;
+
+// Where a variable lives, filled in by the resolver (src/optimization/resolver.cpp): `depth` scopes
+// up from where it's used, in slot `slot` of a scope that has to have `layout`.
+// Without a layout the name couldn't be pinned down and is looked up by name, starting `depth` scopes up
+struct VarRef {
+  const ScopeLayout* layout = nullptr;
+  uint32_t depth = 0;
+  uint32_t slot = 0;
+};
+
+struct ScopeSlot {
+  Symbol symbol;
+  VarRef outer; // where the same name may live further out (relative to this scope), checked while this slot is empty
+};
+
+// Every name that can get declared directly in one scope, each with a fixed slot
+class ScopeLayout {
+  public:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    NodeList<ScopeSlot> slots;
+    NodeList<uint32_t> table; // open addressing symbol -> slot + 1, size is a power of two
+
+    static size_t hash(Symbol symbol) {
+      return symbol * 2654435761u;
+    }
+
+    uint32_t find(Symbol symbol) const {
+      if (table.empty()) return NO_SLOT;
+      size_t mask = table.size() - 1;
+      for (size_t i = hash(symbol) & mask; ; i = (i + 1) & mask) {
+        uint32_t entry = table[i];
+        if (entry == 0) return NO_SLOT;
+        if (slots[entry - 1].symbol == symbol) return entry - 1;
+      }
+    }
+};
+
 class Stmt {
   public:
     NodeType kind;
@@ -59,11 +230,16 @@ class Stmt {
     }
 };
 
+using StmtList = NodeList<Stmt*>;
+
 
+// Owns the arena the rest of the tree lives in, so it's the only node made with `new`
 class Program: public Stmt {
   public:
     Program(): Stmt(NodeType::Program) {}
-    std::vector<Stmt*> body;
+    AstArena arena;
+    StmtList body;
+    const ScopeLayout* layout = nullptr;
 };
 
 
@@ -75,10 +251,13 @@ class Expr: public Stmt {
     Expr(NodeType k): Stmt(k) {}
 };
 
+using ExprList = NodeList<Expr*>;
+
 class VariableDeclaration: public Expr {
   public:
     VariableDeclaration(): Expr(NodeType::VariableDeclaration) {}
-    std::string identifier;
+    Symbol identifier;
+    VarRef ref;
     bool constant = false;
     Expr* value; // value always is defined because `x = 10` is treaded as declaration if x doesn't exist
 };
@@ -87,6 +266,9 @@ class AssignmentExpr: public Expr {
   public:
     AssignmentExpr(): Expr(NodeType::AssignmentExpr) {}
     bool local = false;
+    // the value is arithmetic on numbers and nothing uses what the assignment gives, so it can be
+    // written into the NumberVal the variable owns (set by src/optimization/types.cpp)
+    bool unboxed = false;
     Expr* identifier;
     Expr* value;
 };
@@ -95,22 +277,25 @@ class CallExpr: public Expr {
   public:
     CallExpr(): Expr(NodeType::CallExpr) {}
     Expr* caller;
-    std::vector<Expr*> args;
+    ExprList args;
+    // the last thing its callable does, so the call takes the caller's place (the resolver sets these)
+    bool tail = false;
+    bool reuseScope = false; // nothing can still see the caller's scope, the callee gets it
 };
 
 class SpecialExpr: public Expr { // @import("file")
   public:
     SpecialExpr(): Expr(NodeType::SpecialExpr) {}
-    std::string identifier;
-    bool isFunction;
-    std::vector<Expr*> args;
+    Symbol identifier;
+    bool isFunction = false;
+    ExprList args;
 };
 
 class MemberExpr: public Expr {
   public:
     MemberExpr(): Expr(NodeType::MemberExpr) {}
     Expr* left;
-    std::string identifier;
+    Symbol identifier;
 };
 
 class BinaryExpr: public Expr {
@@ -119,29 +304,72 @@ class BinaryExpr: public Expr {
     Expr* left;
     Expr* right;
     OperatorType expr_operator;
+    QuickState quick;
 };
 
 class FunctionDeclaration: public Expr {
   public:
     FunctionDeclaration(): Expr(NodeType::FunctionDeclaration) {}
-    std::vector<std::string> parameters;
-    std::vector<Stmt*> body;
+    NodeList<Symbol> parameters;
+    StmtList body;
+    const ScopeLayout* layout = nullptr; // of the call scope, parameters come first
+    Chunk* chunk = nullptr; // the body as bytecode, compiled by the VM the first time it calls it
+    JitCode* jit = nullptr; // the chunk as machine code once the callable got hot (jit.hpp)
+    Tier tier = Tier::TreeWalker;
+    uint64_t calls = 0;
+    Symbol name = SYM_EMPTY; // the variable it was first given to, for messages
+};
+
+struct ElseIfBranch {
+  Expr* check;
+  StmtList body;
 };
 
 class IfStatement: public Expr {
   public:
     IfStatement(): Expr(NodeType::IfStatement) {}
     Expr* check;
-    std::vector<Stmt*> body;
-    std::vector<std::pair<Expr*, std::vector<Stmt*>>> else_if_chain;
-    std::vector<Stmt*> else_body;
+    StmtList body;
+    NodeList<ElseIfBranch> else_if_chain;
+    StmtList else_body;
+    const ScopeLayout* layout = nullptr; // one scope for all the branches
 };
 
 class WhileStatement: public Expr {
   public:
     WhileStatement(): Expr(NodeType::WhileStatement) {}
     Expr* check;
-    std::vector<Stmt*> body;
+    StmtList body;
+    const ScopeLayout* layout = nullptr; // one scope for all the iterations
+    uint32_t invariants = 0; // how many InvariantExprs cache their value in this loop
+    // a hot loop finishes on a faster tier, starting from the iteration the tree-walker got to
+    Tier tier = Tier::TreeWalker;
+    uint64_t iterations = 0;
+    Chunk* chunk = nullptr;
+    JitCode* jit = nullptr;
+};
+
+// `for x in array { ... }` or `for i in range(start, end, step) { ... }`, what it goes over is
+// evaluated once before the first iteration
+class ForStatement: public Expr {
+  public:
+    ForStatement(): Expr(NodeType::ForStatement) {}
+    Symbol identifier;
+    VarRef ref; // the first slot of the loop's scope
+    Expr* iterable = nullptr; // the array, nullptr for a range
+    Expr* start = nullptr; // range(end) starts at 0
+    Expr* end = nullptr;
+    Expr* step = nullptr; // 1 when it's left out
+    StmtList body;
+    const ScopeLayout* layout = nullptr; // one scope for all the iterations
+};
+
+// statements run in their own scope, what's left of an if after its check was folded away
+class BlockExpr: public Expr {
+  public:
+    BlockExpr(): Expr(NodeType::BlockExpr) {}
+    StmtList body;
+    const ScopeLayout* layout = nullptr;
 };
 
 class NegateExpr: public Expr {
@@ -164,6 +392,7 @@ class ComparisonExpr: public Expr {
     Expr* left;
     Expr* right;
     ComparisonOperatorType op;
+    QuickState quick;
 };
 
 class BitShiftExpr: public Expr {
@@ -172,6 +401,7 @@ class BitShiftExpr: public Expr {
     bool shiftRight;
     Expr* left;
     Expr* right;
+    QuickState quick;
 };
 
 class SubscriptExpr: public Expr {
@@ -182,26 +412,212 @@ class SubscriptExpr: public Expr {
 };
 
 // Literals
+// Scalar values are never modified once made, so the interpreter hands out the same
+// value every time a literal runs instead of allocating a new one (`cached`)
 class NumberLiteral: public Expr {
   public:
     NumberLiteral(): Expr(NodeType::NumberLiteral) {}
     double value;
+    RuntimeVal* cached = nullptr;
 };
 
 class StringLiteral: public Expr {
   public:
     StringLiteral(): Expr(NodeType::StringLiteral) {}
-    std::string value;
+    std::string_view value; // the bytes live in the arena
+    RuntimeVal* cached = nullptr;
+};
+
+// never written in source (true and false are variables), only made by the optimizer
+class BooleanLiteral: public Expr {
+  public:
+    BooleanLiteral(): Expr(NodeType::BooleanLiteral) {}
+    bool value;
+    RuntimeVal* cached = nullptr;
 };
 
 class ArrayLiteral: public Expr {
   public:
     ArrayLiteral(): Expr(NodeType::ArrayLiteral) {}
-    std::vector<Expr*> elements;
+    ExprList elements;
 };
 
 class Identifier: public Expr {
   public:
     Identifier(): Expr(NodeType::Identifier) {}
-    std::string value;
-};
\ No newline at end of file
+    Symbol symbol;
+    VarRef ref;
+};
+
+enum class PatternKind : uint8_t {
+  Number,
+  String,
+  Bind, // any value, put in a variable. Only inside arrays
+  Array,
+};
+
+struct MatchPattern {
+  PatternKind kind;
+  double number = 0;
+  std::string_view string; // the bytes live in the arena
+  Symbol binding = 0;
+  NodeList<MatchPattern> elements; // an array matches if it has exactly as many elements and each matches
+};
+
+// calls fn on every name the pattern binds
+template <typename Fn>
+void for_each_binding(const MatchPattern& pattern, Fn&& fn) {
+  if (pattern.kind == PatternKind::Bind) fn(pattern.binding);
+  for (const MatchPattern& element : pattern.elements) for_each_binding(element, fn);
+}
+
+struct MatchCase {
+  NodeList<MatchPattern> patterns; // the case is taken if any of them matches
+  StmtList body;
+  const ScopeLayout* layout = nullptr; // names bound by the patterns come first
+};
+
+// `match value { 1, 2 { ... } "a" { ... } [x, 0] { ... } else { ... } }`, the first case that matches runs
+class MatchExpr: public Expr {
+  public:
+    MatchExpr(): Expr(NodeType::MatchExpr) {}
+    Expr* value;
+    NodeList<MatchCase> cases;
+    StmtList else_body;
+    const ScopeLayout* else_layout = nullptr;
+    MatchTable* table = nullptr; // the decision tree, built by the interpreter the first time the match runs
+};
+
+// An expression that gives the same value on every iteration of `loop`, made by the LICM pass
+// (src/optimization/licm.cpp). Its value is kept in slot `slot` of the running loop
+class InvariantExpr: public Expr {
+  public:
+    InvariantExpr(): Expr(NodeType::InvariantExpr) {}
+    Expr* expr;
+    const WhileStatement* loop;
+    uint32_t slot;
+};
+
+// Calls fn on every direct child of the node, in evaluation order
+template <typename Fn>
+void for_each_child(Stmt* node, Fn&& fn) {
+  switch (node->kind) {
+    case NodeType::Program: {
+      for (auto stmt : static_cast<Program*>(node)->body) fn(stmt);
+      break;
+    }
+    case NodeType::VariableDeclaration: {
+      fn(static_cast<VariableDeclaration*>(node)->value);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      for (auto stmt : static_cast<FunctionDeclaration*>(node)->body) fn(stmt);
+      break;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      fn(ifStmt->check);
+      for (auto stmt : ifStmt->body) fn(stmt);
+      for (auto& branch : ifStmt->else_if_chain) {
+        fn(branch.check);
+        for (auto stmt : branch.body) fn(stmt);
+      }
+      for (auto stmt : ifStmt->else_body) fn(stmt);
+      break;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      fn(whileStmt->check);
+      for (auto stmt : whileStmt->body) fn(stmt);
+      break;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      for (Expr* expr : { forStmt->iterable, forStmt->start, forStmt->end, forStmt->step }) {
+        if (expr != nullptr) fn(expr);
+      }
+      for (auto stmt : forStmt->body) fn(stmt);
+      break;
+    }
+    case NodeType::BlockExpr: {
+      for (auto stmt : static_cast<BlockExpr*>(node)->body) fn(stmt);
+      break;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      fn(assign->identifier);
+      fn(assign->value);
+      break;
+    }
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(node);
+      fn(call->caller);
+      for (auto arg : call->args) fn(arg);
+      break;
+    }
+    case NodeType::SpecialExpr: {
+      for (auto arg : static_cast<SpecialExpr*>(node)->args) fn(arg);
+      break;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = static_cast<SubscriptExpr*>(node);
+      fn(sub->left);
+      fn(sub->value);
+      break;
+    }
+    case NodeType::MemberExpr: {
+      fn(static_cast<MemberExpr*>(node)->left);
+      break;
+    }
+    case NodeType::NegateExpr: {
+      fn(static_cast<NegateExpr*>(node)->expr);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      fn(logical->left);
+      fn(logical->right);
+      break;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      fn(comparison->left);
+      fn(comparison->right);
+      break;
+    }
+    case NodeType::ArrayLiteral: {
+      for (auto elem : static_cast<ArrayLiteral*>(node)->elements) fn(elem);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      fn(binary->left);
+      fn(binary->right);
+      break;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      fn(shift->left);
+      fn(shift->right);
+      break;
+    }
+    case NodeType::InvariantExpr: {
+      fn(static_cast<InvariantExpr*>(node)->expr);
+      break;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      fn(match->value);
+      for (const MatchCase& matchCase : match->cases) {
+        for (auto stmt : matchCase.body) fn(stmt);
+      }
+      for (auto stmt : match->else_body) fn(stmt);
+      break;
+    }
+    case NodeType::StringLiteral:
+    case NodeType::NumberLiteral:
+    case NodeType::BooleanLiteral:
+    case NodeType::Identifier:
+      break;
+  }
+}
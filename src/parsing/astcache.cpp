@@ -0,0 +1,628 @@
+#include "astcache.hpp"
+#include "parser.hpp"
+#include "../util.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+static bool cacheEnabled = true;
+
+void set_ast_cache_enabled(bool enabled) {
+  cacheEnabled = enabled;
+}
+
+// FNV-1a, good enough to tell two versions of a script apart
+uint64_t hash_source(std::string_view source) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : source) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// the file starts with this, followed by the symbol names and then the tree in pre-order
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  uint64_t sourceSize;
+  uint32_t symbolCount;
+  uint32_t byteOrder; // caches are written in native byte order, a foreign one won't match
+};
+
+constexpr char CACHE_MAGIC[4] = { 'E', 'S', 'T', 'C' };
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr uint8_t NULL_NODE = 0xFF;
+
+static CacheHeader make_header(std::string_view source, uint32_t symbolCount) {
+  CacheHeader header;
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = AST_CACHE_VERSION;
+  header.sourceHash = hash_source(source);
+  header.sourceSize = source.size();
+  header.symbolCount = symbolCount;
+  header.byteOrder = BYTE_ORDER_MARK;
+  return header;
+}
+
+/*
+WRITING
+*/
+class AstWriter {
+  public:
+    std::string out;
+    std::vector<Symbol> symbols; // file-local id -> symbol
+    std::unordered_map<Symbol, uint32_t> symbolIds;
+
+    template <typename T>
+    void put(T value) {
+      out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put_symbol(Symbol symbol) {
+      auto it = symbolIds.find(symbol);
+      if (it == symbolIds.end()) {
+        it = symbolIds.emplace(symbol, static_cast<uint32_t>(symbols.size())).first;
+        symbols.push_back(symbol);
+      }
+      put<uint32_t>(it->second);
+    }
+
+    void put_string(std::string_view str) {
+      put<uint32_t>(static_cast<uint32_t>(str.size()));
+      out.append(str.data(), str.size());
+    }
+
+    template <typename T>
+    void put_list(NodeList<T*> list) {
+      put<uint32_t>(list.count);
+      for (auto node : list) put_node(node);
+    }
+
+    void put_pattern(const MatchPattern& pattern) {
+      put<uint8_t>(static_cast<uint8_t>(pattern.kind));
+      switch (pattern.kind) {
+        case PatternKind::Number: put<double>(pattern.number); break;
+        case PatternKind::String: put_string(pattern.string); break;
+        case PatternKind::Bind: put_symbol(pattern.binding); break;
+        case PatternKind::Array: {
+          put<uint32_t>(pattern.elements.count);
+          for (const MatchPattern& element : pattern.elements) put_pattern(element);
+          break;
+        }
+      }
+    }
+
+    void put_node(Stmt* node);
+};
+
+void AstWriter::put_node(Stmt* node) {
+  if (node == nullptr) {
+    put<uint8_t>(NULL_NODE);
+    return;
+  }
+  if (node->kind == NodeType::InvariantExpr) { // only the optimizer makes these, store what it wraps
+    put_node(static_cast<InvariantExpr*>(node)->expr);
+    return;
+  }
+  put<uint8_t>(static_cast<uint8_t>(node->kind));
+
+  switch (node->kind) {
+    case NodeType::Program: {
+      put_list(static_cast<Program*>(node)->body);
+      break;
+    }
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = static_cast<VariableDeclaration*>(node);
+      put_symbol(varDec->identifier);
+      put<uint8_t>(varDec->constant);
+      put_node(varDec->value);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      FunctionDeclaration* funcDec = static_cast<FunctionDeclaration*>(node);
+      put<uint32_t>(funcDec->parameters.count);
+      for (Symbol param : funcDec->parameters) put_symbol(param);
+      put_list(funcDec->body);
+      break;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = static_cast<IfStatement*>(node);
+      put_node(ifStmt->check);
+      put_list(ifStmt->body);
+      put<uint32_t>(ifStmt->else_if_chain.count);
+      for (const ElseIfBranch& branch : ifStmt->else_if_chain) {
+        put_node(branch.check);
+        put_list(branch.body);
+      }
+      put_list(ifStmt->else_body);
+      break;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = static_cast<WhileStatement*>(node);
+      put_node(whileStmt->check);
+      put_list(whileStmt->body);
+      break;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = static_cast<ForStatement*>(node);
+      put_symbol(forStmt->identifier);
+      put_node(forStmt->iterable);
+      put_node(forStmt->start);
+      put_node(forStmt->end);
+      put_node(forStmt->step);
+      put_list(forStmt->body);
+      break;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = static_cast<AssignmentExpr*>(node);
+      put<uint8_t>(assign->local);
+      put_node(assign->identifier);
+      put_node(assign->value);
+      break;
+    }
+    case NodeType::CallExpr: {
+      CallExpr* call = static_cast<CallExpr*>(node);
+      put_node(call->caller);
+      put_list(call->args);
+      break;
+    }
+    case NodeType::SpecialExpr: {
+      SpecialExpr* special = static_cast<SpecialExpr*>(node);
+      put_symbol(special->identifier);
+      put<uint8_t>(special->isFunction);
+      put_list(special->args);
+      break;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = static_cast<SubscriptExpr*>(node);
+      put_node(sub->left);
+      put_node(sub->value);
+      break;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = static_cast<MemberExpr*>(node);
+      put_node(member->left);
+      put_symbol(member->identifier);
+      break;
+    }
+    case NodeType::NegateExpr: {
+      put_node(static_cast<NegateExpr*>(node)->expr);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = static_cast<LogicalExpr*>(node);
+      put<uint8_t>(static_cast<uint8_t>(logical->op));
+      put_node(logical->left);
+      put_node(logical->right);
+      break;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = static_cast<ComparisonExpr*>(node);
+      put<uint8_t>(static_cast<uint8_t>(comparison->op));
+      put_node(comparison->left);
+      put_node(comparison->right);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = static_cast<BinaryExpr*>(node);
+      put<uint8_t>(static_cast<uint8_t>(binary->expr_operator));
+      put_node(binary->left);
+      put_node(binary->right);
+      break;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = static_cast<BitShiftExpr*>(node);
+      put<uint8_t>(shift->shiftRight);
+      put_node(shift->left);
+      put_node(shift->right);
+      break;
+    }
+    case NodeType::StringLiteral: {
+      put_string(static_cast<StringLiteral*>(node)->value);
+      break;
+    }
+    case NodeType::ArrayLiteral: {
+      put_list(static_cast<ArrayLiteral*>(node)->elements);
+      break;
+    }
+    case NodeType::BlockExpr: {
+      put_list(static_cast<BlockExpr*>(node)->body);
+      break;
+    }
+    case NodeType::BooleanLiteral: {
+      put<uint8_t>(static_cast<BooleanLiteral*>(node)->value);
+      break;
+    }
+    case NodeType::NumberLiteral: {
+      put<double>(static_cast<NumberLiteral*>(node)->value);
+      break;
+    }
+    case NodeType::Identifier: {
+      put_symbol(static_cast<Identifier*>(node)->symbol);
+      break;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = static_cast<MatchExpr*>(node);
+      put_node(match->value);
+      put<uint32_t>(match->cases.count);
+      for (const MatchCase& matchCase : match->cases) {
+        put<uint32_t>(matchCase.patterns.count);
+        for (const MatchPattern& pattern : matchCase.patterns) put_pattern(pattern);
+        put_list(matchCase.body);
+      }
+      put_list(match->else_body);
+      break;
+    }
+    case NodeType::InvariantExpr: // unwrapped above
+      break;
+  }
+}
+
+std::string serialize_program(Program* program, std::string_view source) {
+  AstWriter writer;
+  writer.put_list(program->body);
+
+  CacheHeader header = make_header(source, static_cast<uint32_t>(writer.symbols.size()));
+  std::string image(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (Symbol symbol : writer.symbols) {
+    const std::string& name = symbol_name(symbol);
+    uint32_t length = static_cast<uint32_t>(name.size());
+    image.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    image += name;
+  }
+  image += writer.out;
+  return image;
+}
+
+/*
+READING
+Everything read is bounds checked, a truncated or damaged file just flips `ok` and the
+caller throws the half-built program away.
+*/
+class AstReader {
+  public:
+    const char* cursor;
+    const char* end;
+    bool ok = true;
+    AstArena* arena;
+    std::vector<Symbol> symbols; // file-local id -> symbol of this run
+
+    bool has(size_t bytes) {
+      if (!ok || static_cast<size_t>(end - cursor) < bytes) {
+        ok = false;
+        return false;
+      }
+      return true;
+    }
+
+    template <typename T>
+    T get() {
+      T value{};
+      if (!has(sizeof(T))) return value;
+      std::memcpy(&value, cursor, sizeof(T));
+      cursor += sizeof(T);
+      return value;
+    }
+
+    // a count that claims more items than there are bytes left can't be right
+    uint32_t get_count() {
+      uint32_t count = get<uint32_t>();
+      if (!has(count)) return 0;
+      return count;
+    }
+
+    Symbol get_symbol() {
+      uint32_t id = get<uint32_t>();
+      if (id >= symbols.size()) {
+        ok = false;
+        return SYM_EMPTY;
+      }
+      return symbols[id];
+    }
+
+    std::string_view get_string() {
+      uint32_t length = get_count();
+      if (!ok) return std::string_view();
+      std::string_view str(cursor, length);
+      cursor += length;
+      return str;
+    }
+
+    template <typename T>
+    NodeList<T*> get_list() {
+      NodeList<T*> list = arena->make_list<T*>(get_count());
+      for (size_t i = 0; i < list.size(); i++) {
+        list[i] = static_cast<T*>(get_node());
+      }
+      return list;
+    }
+
+    template <typename T>
+    T* make() {
+      return arena->make<T>();
+    }
+
+    MatchPattern get_pattern() {
+      MatchPattern pattern;
+      uint8_t kind = get<uint8_t>();
+      switch (static_cast<PatternKind>(kind)) {
+        case PatternKind::Number: pattern.number = get<double>(); break;
+        case PatternKind::String: pattern.string = arena->copy_string(get_string()); break;
+        case PatternKind::Bind: pattern.binding = get_symbol(); break;
+        case PatternKind::Array: {
+          pattern.elements = arena->make_list<MatchPattern>(get_count());
+          for (MatchPattern& element : pattern.elements) element = get_pattern();
+          break;
+        }
+        default:
+          ok = false;
+          return pattern;
+      }
+      pattern.kind = static_cast<PatternKind>(kind);
+      return pattern;
+    }
+
+    Stmt* get_node();
+};
+
+Stmt* AstReader::get_node() {
+  uint8_t kind = get<uint8_t>();
+  if (!ok || kind == NULL_NODE) return nullptr;
+
+  switch (static_cast<NodeType>(kind)) {
+    case NodeType::VariableDeclaration: {
+      VariableDeclaration* varDec = make<VariableDeclaration>();
+      varDec->identifier = get_symbol();
+      varDec->constant = get<uint8_t>();
+      varDec->value = static_cast<Expr*>(get_node());
+      return varDec;
+    }
+    case NodeType::FunctionDeclaration: {
+      FunctionDeclaration* funcDec = make<FunctionDeclaration>();
+      funcDec->parameters = arena->make_list<Symbol>(get_count());
+      for (Symbol& param : funcDec->parameters) param = get_symbol();
+      funcDec->body = get_list<Stmt>();
+      return funcDec;
+    }
+    case NodeType::IfStatement: {
+      IfStatement* ifStmt = make<IfStatement>();
+      ifStmt->check = static_cast<Expr*>(get_node());
+      ifStmt->body = get_list<Stmt>();
+      ifStmt->else_if_chain = arena->make_list<ElseIfBranch>(get_count());
+      for (ElseIfBranch& branch : ifStmt->else_if_chain) {
+        branch.check = static_cast<Expr*>(get_node());
+        branch.body = get_list<Stmt>();
+      }
+      ifStmt->else_body = get_list<Stmt>();
+      return ifStmt;
+    }
+    case NodeType::WhileStatement: {
+      WhileStatement* whileStmt = make<WhileStatement>();
+      whileStmt->check = static_cast<Expr*>(get_node());
+      whileStmt->body = get_list<Stmt>();
+      return whileStmt;
+    }
+    case NodeType::ForStatement: {
+      ForStatement* forStmt = make<ForStatement>();
+      forStmt->identifier = get_symbol();
+      forStmt->iterable = static_cast<Expr*>(get_node());
+      forStmt->start = static_cast<Expr*>(get_node());
+      forStmt->end = static_cast<Expr*>(get_node());
+      forStmt->step = static_cast<Expr*>(get_node());
+      forStmt->body = get_list<Stmt>();
+      return forStmt;
+    }
+    case NodeType::AssignmentExpr: {
+      AssignmentExpr* assign = make<AssignmentExpr>();
+      assign->local = get<uint8_t>();
+      assign->identifier = static_cast<Expr*>(get_node());
+      assign->value = static_cast<Expr*>(get_node());
+      return assign;
+    }
+    case NodeType::CallExpr: {
+      CallExpr* call = make<CallExpr>();
+      call->caller = static_cast<Expr*>(get_node());
+      call->args = get_list<Expr>();
+      return call;
+    }
+    case NodeType::SpecialExpr: {
+      SpecialExpr* special = make<SpecialExpr>();
+      special->identifier = get_symbol();
+      special->isFunction = get<uint8_t>();
+      special->args = get_list<Expr>();
+      return special;
+    }
+    case NodeType::SubscriptExpr: {
+      SubscriptExpr* sub = make<SubscriptExpr>();
+      sub->left = static_cast<Expr*>(get_node());
+      sub->value = static_cast<Expr*>(get_node());
+      return sub;
+    }
+    case NodeType::MemberExpr: {
+      MemberExpr* member = make<MemberExpr>();
+      member->left = static_cast<Expr*>(get_node());
+      member->identifier = get_symbol();
+      return member;
+    }
+    case NodeType::NegateExpr: {
+      NegateExpr* negate = make<NegateExpr>();
+      negate->expr = static_cast<Expr*>(get_node());
+      return negate;
+    }
+    case NodeType::LogicalExpr: {
+      LogicalExpr* logical = make<LogicalExpr>();
+      logical->op = static_cast<LogicalOperatorType>(get<uint8_t>());
+      logical->left = static_cast<Expr*>(get_node());
+      logical->right = static_cast<Expr*>(get_node());
+      return logical;
+    }
+    case NodeType::ComparisonExpr: {
+      ComparisonExpr* comparison = make<ComparisonExpr>();
+      comparison->op = static_cast<ComparisonOperatorType>(get<uint8_t>());
+      comparison->left = static_cast<Expr*>(get_node());
+      comparison->right = static_cast<Expr*>(get_node());
+      return comparison;
+    }
+    case NodeType::BinaryExpr: {
+      BinaryExpr* binary = make<BinaryExpr>();
+      binary->expr_operator = static_cast<OperatorType>(get<uint8_t>());
+      binary->left = static_cast<Expr*>(get_node());
+      binary->right = static_cast<Expr*>(get_node());
+      return binary;
+    }
+    case NodeType::BitShiftExpr: {
+      BitShiftExpr* shift = make<BitShiftExpr>();
+      shift->shiftRight = get<uint8_t>();
+      shift->left = static_cast<Expr*>(get_node());
+      shift->right = static_cast<Expr*>(get_node());
+      return shift;
+    }
+    case NodeType::StringLiteral: {
+      StringLiteral* strLit = make<StringLiteral>();
+      strLit->value = arena->copy_string(get_string()); // the mapping goes away after loading
+      return strLit;
+    }
+    case NodeType::ArrayLiteral: {
+      ArrayLiteral* array = make<ArrayLiteral>();
+      array->elements = get_list<Expr>();
+      return array;
+    }
+    case NodeType::NumberLiteral: {
+      NumberLiteral* numLit = make<NumberLiteral>();
+      numLit->value = get<double>();
+      return numLit;
+    }
+    case NodeType::BooleanLiteral: {
+      BooleanLiteral* boolLit = make<BooleanLiteral>();
+      boolLit->value = get<uint8_t>();
+      return boolLit;
+    }
+    case NodeType::BlockExpr: {
+      BlockExpr* block = make<BlockExpr>();
+      block->body = get_list<Stmt>();
+      return block;
+    }
+    case NodeType::Identifier: {
+      Identifier* iden = make<Identifier>();
+      iden->symbol = get_symbol();
+      return iden;
+    }
+    case NodeType::MatchExpr: {
+      MatchExpr* match = make<MatchExpr>();
+      match->value = static_cast<Expr*>(get_node());
+      match->cases = arena->make_list<MatchCase>(get_count());
+      for (MatchCase& matchCase : match->cases) {
+        matchCase = MatchCase();
+        matchCase.patterns = arena->make_list<MatchPattern>(get_count());
+        for (MatchPattern& pattern : matchCase.patterns) pattern = get_pattern();
+        matchCase.body = get_list<Stmt>();
+      }
+      match->else_body = get_list<Stmt>();
+      return match;
+    }
+    default: // Program never nests, anything else is garbage
+      ok = false;
+      return nullptr;
+  }
+}
+
+// `source` is nullptr when there's nothing to check the image against
+static Program* deserialize_image(std::string_view image, const std::string_view* source) {
+  if (image.size() < sizeof(CacheHeader)) return nullptr;
+
+  CacheHeader header;
+  std::memcpy(&header, image.data(), sizeof(header));
+  if (
+    std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+    || header.version != AST_CACHE_VERSION
+    || header.byteOrder != BYTE_ORDER_MARK
+  ) {
+    return nullptr;
+  }
+  if (source != nullptr && (header.sourceSize != source->size() || header.sourceHash != hash_source(*source))) {
+    return nullptr;
+  }
+
+  Program* program = new Program();
+  AstReader reader;
+  reader.cursor = image.data() + sizeof(header);
+  reader.end = image.data() + image.size();
+  reader.arena = &program->arena;
+
+  reader.symbols.reserve(header.symbolCount);
+  for (uint32_t i = 0; i < header.symbolCount && reader.ok; i++) {
+    reader.symbols.push_back(intern(reader.get_string()));
+  }
+
+  program->body = reader.get_list<Stmt>();
+  if (!reader.ok || reader.cursor != reader.end) {
+    delete program;
+    return nullptr;
+  }
+  return program;
+}
+
+Program* deserialize_program(std::string_view image, std::string_view source) {
+  return deserialize_image(image, &source);
+}
+
+Program* deserialize_program(std::string_view image) {
+  return deserialize_image(image, nullptr);
+}
+
+/*
+CACHE FILES
+*/
+static std::string cache_path(const std::string& path, std::string_view source) {
+  const char* cacheDir = std::getenv("EASTLANG_CACHE_DIR");
+  if (cacheDir == nullptr || *cacheDir == '\0') {
+    return path + ".eastc";
+  }
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.eastc", static_cast<unsigned long long>(hash_source(source)));
+  return std::string(cacheDir) + "/" + name;
+}
+
+// a cache that can't be written (read-only dir, full disk, ...) isn't an error, it's just slower
+static void write_cache(const std::string& cachePath, const std::string& image) {
+  // write to the side and rename, so another run never maps a half-written file
+  std::string tmpPath = temp_path_for(cachePath);
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file) return;
+    file.write(image.data(), image.size());
+    if (!file) {
+      file.close();
+      std::remove(tmpPath.c_str());
+      return;
+    }
+  }
+  if (std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+    std::remove(tmpPath.c_str());
+  }
+}
+
+Program* parse_file(const std::string& path, std::string_view source) {
+  if (!cacheEnabled) {
+    return Parser().parse_ast(source);
+  }
+
+  std::string cachePath = cache_path(path, source);
+  std::error_code error;
+  MappedFile cacheFile;
+  if (std::filesystem::is_regular_file(cachePath, error) && cacheFile.open(cachePath.c_str())) {
+    Program* program = deserialize_program(cacheFile.view(), source);
+    if (program != nullptr) return program;
+  }
+
+  Program* program = Parser().parse_ast(source);
+  write_cache(cachePath, serialize_program(program, source));
+  return program;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "ast.hpp"
+
+/*
+Precompiled AST cache (.eastc files).
+A parsed program is written out as a flat, versioned binary blob keyed by a hash of its source.
+On the next run the blob is memory-mapped and rebuilt straight into a fresh arena, skipping the
+lexer and the parser. Names are stored as strings and re-interned on load because symbol ids
+differ between runs.
+
+The cache sits next to the source (`script.el.eastc`) unless EASTLANG_CACHE_DIR is set, then
+it's `<dir>/<source hash>.eastc`. Unreadable, stale or corrupt caches are ignored and rewritten.
+*/
+
+// bump this whenever the encoding or the meaning of a node changes, older caches are then ignored
+constexpr uint32_t AST_CACHE_VERSION = 4;
+
+void set_ast_cache_enabled(bool enabled);
+
+uint64_t hash_source(std::string_view source);
+
+// writes the program into an in-memory .eastc image
+std::string serialize_program(Program* program, std::string_view source);
+
+// rebuilds a program from an .eastc image, nullptr if it's damaged or doesn't belong to the source
+Program* deserialize_program(std::string_view image, std::string_view source);
+
+// same without checking the source, for images that travel without it (bundles)
+Program* deserialize_program(std::string_view image);
+
+// Parses a file through the cache, `source` has to be the current contents of `path`
+Program* parse_file(const std::string& path, std::string_view source);
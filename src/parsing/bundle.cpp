@@ -0,0 +1,149 @@
+#include "bundle.hpp"
+#include "astcache.hpp"
+#include "loader.hpp"
+#include "../Errors.hpp"
+#include "../util.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+/*
+Layout: a BundleHeader, then one entry per module, the main script first:
+  u32 key length, key (path relative to the script's folder, starting with '/', may go up with '..'),
+  u64 image length, .eastc image
+*/
+
+static constexpr char BUNDLE_MAGIC[4] = { 'E', 'S', 'T', 'B' };
+static constexpr uint32_t BUNDLE_BYTE_ORDER = 0x01020304;
+
+struct BundleHeader {
+  char magic[4];
+  uint32_t version; // the .eastc version of the images inside
+  uint32_t moduleCount;
+  uint32_t byteOrder;
+};
+
+template<typename T>
+static void put_raw(std::string& out, T value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+size_t write_bundle(const std::string& mainPath, const std::string& outPath) {
+  std::string absolute = std::filesystem::path(mainPath).is_absolute() ? mainPath : pwd() + "/" + mainPath;
+  std::string scriptDir = path_of_file(absolute);
+
+  // same walk the loader's preload does, the keys are the paths with scriptDir cut off
+  std::deque<std::pair<std::string, std::string>> pending = { { absolute, scriptDir } };
+  // an included file runs with the @path of whoever included it, so the same file
+  // can have different imports depending on where it's used from
+  std::unordered_set<std::string> seen = { absolute + "\n" + scriptDir };
+  std::unordered_set<std::string> written;
+  std::string entries;
+  uint32_t count = 0;
+
+  while (!pending.empty()) {
+    auto [path, dir] = pending.front();
+    pending.pop_front();
+
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+      // could be behind a branch that never runs, the bundle raises the usual error if it does
+      std::cerr << "Skipping " << path << ", the file doesn't exist\n";
+      continue;
+    }
+
+    MappedFile sourceFile;
+    if (!sourceFile.open(path.c_str())) raise_error("Could not open file " + path);
+    Program* program = parse_file(path, sourceFile.view());
+    if (written.insert(path).second) {
+      std::string image = serialize_program(program, sourceFile.view());
+      // every import path is built onto scriptDir, one outside of it just keeps its "/../"
+      std::string key = path.substr(scriptDir.size());
+      put_raw<uint32_t>(entries, static_cast<uint32_t>(key.size()));
+      entries += key;
+      put_raw<uint64_t>(entries, static_cast<uint64_t>(image.size()));
+      entries += image;
+      count++;
+    }
+
+    for (auto& import : static_imports(program, dir)) {
+      if (seen.insert(import.first + "\n" + import.second).second) pending.push_back(import);
+    }
+    delete program;
+  }
+
+  BundleHeader header;
+  std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+  header.version = AST_CACHE_VERSION;
+  header.moduleCount = count;
+  header.byteOrder = BUNDLE_BYTE_ORDER;
+
+  // write to the side and rename, like the cache does
+  std::string tmpPath = temp_path_for(outPath);
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(entries.data(), entries.size());
+    if (!file) {
+      file.close();
+      std::remove(tmpPath.c_str());
+      raise_error("Could not write bundle " + outPath);
+    }
+  }
+  if (std::rename(tmpPath.c_str(), outPath.c_str()) != 0) {
+    std::remove(tmpPath.c_str());
+    raise_error("Could not write bundle " + outPath);
+  }
+  return count;
+}
+
+std::string load_bundle(const std::string& bundlePath, const std::string& scriptDir) {
+  // never freed, the loader keeps views into it for as long as the program runs
+  MappedFile* bundleFile = new MappedFile();
+  if (!bundleFile->open(bundlePath.c_str())) raise_error("Could not open file " + bundlePath);
+  std::string_view bundle = bundleFile->view();
+
+  BundleHeader header;
+  if (bundle.size() < sizeof(header)) {
+    raise_error(bundlePath + " is not a bundle");
+  }
+  std::memcpy(&header, bundle.data(), sizeof(header));
+  if (std::memcmp(header.magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0 || header.byteOrder != BUNDLE_BYTE_ORDER) {
+    raise_error(bundlePath + " is not a bundle");
+  }
+  if (header.version != AST_CACHE_VERSION) {
+    raise_error(bundlePath + " was made by another version of the interpreter, bundle the script again");
+  }
+
+  size_t at = sizeof(header);
+  std::string mainPath;
+  for (uint32_t i = 0; i < header.moduleCount; i++) {
+    uint32_t keySize;
+    uint64_t imageSize;
+    if (bundle.size() - at < sizeof(keySize)) raise_error(bundlePath + " is damaged");
+    std::memcpy(&keySize, bundle.data() + at, sizeof(keySize));
+    at += sizeof(keySize);
+
+    if (bundle.size() - at < keySize + sizeof(imageSize)) raise_error(bundlePath + " is damaged");
+    std::string path = scriptDir + std::string(bundle.substr(at, keySize));
+    at += keySize;
+    std::memcpy(&imageSize, bundle.data() + at, sizeof(imageSize));
+    at += sizeof(imageSize);
+
+    if (bundle.size() - at < imageSize) raise_error(bundlePath + " is damaged");
+    add_bundled_module(path, bundle.substr(at, imageSize));
+    at += imageSize;
+
+    if (i == 0) mainPath = path;
+  }
+  if (header.moduleCount == 0 || at != bundle.size()) {
+    raise_error(bundlePath + " is damaged");
+  }
+  return mainPath;
+}
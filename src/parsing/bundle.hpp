@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+
+/*
+Bundles (.eastb files).
+A script and everything it imports or includes by a literal path, precompiled into a single file.
+Each module is stored as its .eastc image (see astcache.hpp) under its path relative to the
+script's folder, so running a bundle never looks for or parses any source. The bundle can be
+moved around, modules are looked up next to wherever it lives, like the sources were.
+Modules from outside the script's folder go in too, `@import("../lib.el")` is stored as "/../lib.el".
+
+Imports that only get their path while running aren't in the bundle and still come from disk.
+*/
+
+constexpr const char* BUNDLE_EXTENSION = ".eastb";
+
+// bundles `mainPath` and its imports into `outPath`, returns how many modules went in
+size_t write_bundle(const std::string& mainPath, const std::string& outPath);
+
+// registers the modules of a bundle with the loader, returns the path of its main script.
+// `scriptDir` is the folder the bundle runs from
+std::string load_bundle(const std::string& bundlePath, const std::string& scriptDir);
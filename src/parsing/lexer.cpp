@@ -1,213 +1,262 @@
 #include <string>
-#include <deque>
+#include <cctype>
+#include <cstdint>
 #include "lexer.hpp"
-#include <iostream>
-
-std::deque<Token> tokenize(std::string sourceCode) {
-  std::deque<Token> tokens;
-  std::deque<char> str(sourceCode.begin(), sourceCode.end());
-
-  while (str.size() > 0) {
-    if (str[0] == '(') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::OpenParen));
-
-    } else if (str[0] == ')') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::ClosedParen));
-
-    } else if (str[0] == '{') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::OpenBrace));
-
-    } else if (str[0] == '}') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::ClosedBrace));
-
-    } else if (str[0] == '[') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::OpenBracket));
-
-    } else if (str[0] == ']') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::ClosedBracket));
-
-    } else if (str[0] == '.') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::Dot));
-
-    } else if (str[0] == ',') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::Comma));
-
-    } else if (str[0] == '+' || str[0] == '-' || str[0] == '*' || str[0] == '/' || str[0] == '%') {
-      char value = str.front();
-      str.pop_front();
-      tokens.push_back(Token(value, TokenType::BinaryOperator));
-
-    } else if (str[0] == '!') {
-      str.pop_front();
-      if (str[0] == '=') {
-        str.pop_front();
-        tokens.push_back(Token("!=", TokenType::ComparisonExpr));
-      } else {
-        tokens.push_back(Token("not", TokenType::Not));
-      }
-    } else if (str[0] == '=') {
-      str.pop_front();
-      if (str[0] == '=') {
-        str.pop_front();
-        tokens.push_back(Token("==", TokenType::ComparisonExpr));
-      } else {
-        tokens.push_back(Token('=', TokenType::Equals));
-      }
+#include "scan.hpp"
+#include "../Errors.hpp"
 
-    } else if (str[0] == '@') {
-      str.pop_front();
-      tokens.push_back(Token('@', TokenType::Monkey));
-
-    } else if (str[0] == '>') {
-      str.pop_front();
-      if (str[0] == '=') {
-        str.pop_front();
-        tokens.push_back(Token(">=", TokenType::ComparisonExpr));
-      } else if (str[0] == '>') {
-        str.pop_front();
-        tokens.push_back(Token(">>", TokenType::BitwiseShift));
-      } else {
-        tokens.push_back(Token('>', TokenType::ComparisonExpr));
+static bool is_digit(char c) {
+  return std::isdigit(static_cast<unsigned char>(c));
+}
+
+static bool is_alnum(char c) {
+  return std::isalnum(static_cast<unsigned char>(c));
+}
+
+Lexer::Lexer(std::string_view sourceCode) {
+  if (sourceCode.size() > UINT32_MAX) {
+    raise_error("Source file is too big (over 4GB)");
+  }
+  source = sourceCode;
+}
+
+char Lexer::peek(size_t n) const {
+  if (pos + n >= source.size()) return '\0';
+  return source[pos + n];
+}
+
+Token Lexer::make(TokenType type, size_t start, Operator op) {
+  Token token(type, static_cast<uint32_t>(start), static_cast<uint32_t>(pos - start));
+  token.op = op;
+  last = type;
+  return token;
+}
+
+Token Lexer::next() {
+  bool afterDot = last == TokenType::Dot; // members can be named like keywords: regex.match
+  while (pos < source.size()) {
+    size_t start = pos;
+    char c = source[pos];
+
+    if (c == '(') {
+      pos++;
+      return make(TokenType::OpenParen, start);
+
+    } else if (c == ')') {
+      pos++;
+      return make(TokenType::ClosedParen, start);
+
+    } else if (c == '{') {
+      pos++;
+      return make(TokenType::OpenBrace, start);
+
+    } else if (c == '}') {
+      pos++;
+      return make(TokenType::ClosedBrace, start);
+
+    } else if (c == '[') {
+      pos++;
+      return make(TokenType::OpenBracket, start);
+
+    } else if (c == ']') {
+      pos++;
+      return make(TokenType::ClosedBracket, start);
+
+    } else if (c == '.') {
+      pos++;
+      return make(TokenType::Dot, start);
+
+    } else if (c == ',') {
+      pos++;
+      return make(TokenType::Comma, start);
+
+    } else if (c == '+') {
+      pos++;
+      return make(TokenType::BinaryOperator, start, Operator::Add);
+
+    } else if (c == '-') {
+      pos++;
+      return make(TokenType::BinaryOperator, start, Operator::Substract);
+
+    } else if (c == '*') {
+      pos++;
+      return make(TokenType::BinaryOperator, start, Operator::Multiply);
+
+    } else if (c == '/') {
+      pos++;
+      return make(TokenType::BinaryOperator, start, Operator::Divide);
+
+    } else if (c == '%') {
+      pos++;
+      return make(TokenType::BinaryOperator, start, Operator::Modulo);
+
+    } else if (c == '!') {
+      pos++;
+      if (peek() == '=') {
+        pos++;
+        return make(TokenType::ComparisonExpr, start, Operator::NotEqual);
       }
+      return make(TokenType::Not, start);
 
-    } else if (str[0] == '<') {
-      str.pop_front();
-      if (str[0] == '=') {
-        str.pop_front();
-        tokens.push_back(Token("<=", TokenType::ComparisonExpr));
-      } else if (str[0] == '<') {
-        str.pop_front();
-        tokens.push_back(Token("<<", TokenType::BitwiseShift));
-      } else {
-        tokens.push_back(Token('<', TokenType::ComparisonExpr));
+    } else if (c == '=') {
+      pos++;
+      if (peek() == '=') {
+        pos++;
+        return make(TokenType::ComparisonExpr, start, Operator::Equal);
+      }
+      return make(TokenType::Equals, start);
+
+    } else if (c == '@') {
+      pos++;
+      return make(TokenType::Monkey, start);
+
+    } else if (c == '>') {
+      pos++;
+      if (peek() == '=') {
+        pos++;
+        return make(TokenType::ComparisonExpr, start, Operator::GreaterEqual);
+      } else if (peek() == '>') {
+        pos++;
+        return make(TokenType::BitwiseShift, start, Operator::ShiftRight);
       }
+      return make(TokenType::ComparisonExpr, start, Operator::Greater);
+
+    } else if (c == '<') {
+      pos++;
+      if (peek() == '=') {
+        pos++;
+        return make(TokenType::ComparisonExpr, start, Operator::LessEqual);
+      } else if (peek() == '<') {
+        pos++;
+        return make(TokenType::BitwiseShift, start, Operator::ShiftLeft);
+      }
+      return make(TokenType::ComparisonExpr, start, Operator::Less);
+
+    } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      pos = scan_whitespace(source.data(), pos + 1, source.size());
 
-    } else if (str[0] == '`') { // block comments
-      str.pop_front();
-      while (str[0] != '`') {
-        str.pop_front();
+    } else if (c == '`') { // block comments
+      pos = scan_until(source.data(), pos + 1, source.size(), '`', '`');
+      if (pos >= source.size()) {
+        raise_error("Unterminated block comment");
       }
-      str.pop_front();
+      pos++; // eat the closing backtick
 
-    } else {
-      if (std::isdigit(str[0])) {
-        std::string ret = "";
-        while (std::isdigit(str[0]) || str[0] == '.') {
-          ret += str.front();
-          str.pop_front();
-        }
-        tokens.push_back(Token(ret, TokenType::Number));
-
-      } else if (std::isalnum(str[0])) {
-        std::string ret = "";
-        while (std::isalnum(str[0]) || str[0] == '_') {
-          ret += str.front();
-          str.pop_front();
-        }
-        auto itt = KEYWORDS.find(ret);
-        if (itt == KEYWORDS.end()) {
-          tokens.push_back(Token(ret, TokenType::Identifier));
-        } else {
-          tokens.push_back(Token(ret, itt->second));
-        };
-
-      } else if (str[0] == '\'' || str[0] == '"') {
-        std::string ret = "";
-        char end = str.front();
-        str.pop_front();
-        while (str[0] != end) {
-          if (str[0] == '\\') { // ESCAPE CODES
-            str.pop_front(); // pop \ from the deque
-            if (str[0] == '\'' || str[0] == '"') {
-              ret += str.front();
-              str.pop_front(); // pop ' or " from the deque
-              continue;
-
-            } else if (str[0] == '\\') {
-              ret += '\\';
-              str.pop_front();
-              continue;
-
-            } else if (str[0] == 'n') {
-              str.pop_front();
-              ret += '\n';
-              continue;
-
-            } else if (str[0] == 't') {
-              str.pop_front();
-              ret += '\t';
-              continue;
-
-            } else if (str[0] == 'r') {
-              str.pop_front();
-              ret += '\r';
-              continue;
-
-            } else if (str[0] == 'v') {
-              str.pop_front();
-              ret += '\v';
-              continue;
-
-            } else if (std::isdigit(str[0])) {
-              std::string esc = "";
-              esc += str.front(); // escape codes \nnn where n is a digit
-              str.pop_front();
-
-              esc += str.front();
-              str.pop_front();
-
-              esc += str.front();
-              str.pop_front();
-
-              char val = static_cast<char>(std::stoi(esc, nullptr, 8));
-              ret += val;
-              continue;
-
-            } else if (str[0] == 'x') {
-              str.pop_front(); // pop x
-
-              std::string esc = "";
-              esc += str.front(); // escape codes \xnn where n is a digit
-              str.pop_front();
-
-              esc += str.front();
-              str.pop_front();
-
-              char val = static_cast<char>(std::stoi(esc, nullptr, 16));
-              ret += val;
-              continue;
-            }
-            str.pop_front(); // remove the char after the slash
-          }
-          ret += str.front();
-          str.pop_front();
-        }
-        str.pop_front();
-        tokens.push_back(Token(ret, TokenType::String));
+    } else if (is_digit(c)) {
+      pos = scan_number(source.data(), pos + 1, source.size());
+      return make(TokenType::Number, start);
 
+    } else if (is_alnum(c)) {
+      pos = scan_identifier(source.data(), pos + 1, source.size());
+      Token token = make(TokenType::Identifier, start);
+
+      const Keyword* keyword = afterDot ? nullptr : find_keyword(token.text(source));
+      if (keyword != nullptr) {
+        token.type = keyword->type;
+        token.op = keyword->op;
       } else {
-        str.pop_front();
+        token.symbol = intern(token.text(source));
+      }
+      return token;
+
+    } else if (c == '\'' || c == '"') {
+      pos++; // eat the opening quote
+      size_t bodyStart = pos;
+      while (true) {
+        pos = scan_until(source.data(), pos, source.size(), c, '\\');
+        if (pos >= source.size() || source[pos] == c) break;
+        pos += 2; // the escaped char can't end the string
       }
+      if (pos >= source.size()) {
+        raise_error("Unterminated string literal");
+      }
+      Token token = make(TokenType::String, bodyStart);
+      pos++; // eat the closing quote
+      return token;
+
+    } else {
+      pos++;
     }
   }
 
-  tokens.push_back(Token("EOF", TokenType::EndOfFile));
+  return Token(TokenType::EndOfFile, static_cast<uint32_t>(source.size()), 0);
+}
+
+TokenStream::TokenStream(std::string_view sourceCode): lexer(sourceCode) {}
+
+const Token& TokenStream::peek(size_t n) {
+  if (n >= LOOKAHEAD) {
+    raise_error("Parser looked too far ahead");
+  }
+  while (pulled <= head + n) {
+    ring[pulled & (LOOKAHEAD - 1)] = lexer.next();
+    pulled++;
+  }
+  return ring[(head + n) & (LOOKAHEAD - 1)];
+}
+
+const Token& TokenStream::advance() {
+  const Token& token = peek();
+  head++;
+  return token;
+}
+
+std::vector<Token> tokenize(std::string_view sourceCode) {
+  std::vector<Token> tokens;
+  Lexer lexer(sourceCode);
+
+  while (true) {
+    Token token = lexer.next();
+    tokens.push_back(token);
+    if (token.type == TokenType::EndOfFile) break;
+  }
 
   return tokens;
-};
\ No newline at end of file
+};
+
+std::string unescape_string(std::string_view raw) {
+  std::string ret;
+  ret.reserve(raw.size());
+
+  for (size_t i = 0; i < raw.size(); i++) {
+    if (raw[i] != '\\') {
+      ret += raw[i];
+      continue;
+    }
+    i++; // skip the slash
+    if (i >= raw.size()) break;
+
+    char c = raw[i];
+    if (c == '\'' || c == '"') {
+      ret += c;
+
+    } else if (c == '\\') {
+      ret += '\\';
+
+    } else if (c == 'n') {
+      ret += '\n';
+
+    } else if (c == 't') {
+      ret += '\t';
+
+    } else if (c == 'r') {
+      ret += '\r';
+
+    } else if (c == 'v') {
+      ret += '\v';
+
+    } else if (is_digit(c)) { // escape codes \nnn where n is a digit
+      std::string esc(raw.substr(i, 3));
+      ret += static_cast<char>(std::stoi(esc, nullptr, 8));
+      i += esc.size() - 1;
+
+    } else if (c == 'x') { // escape codes \xnn where n is a digit
+      std::string esc(raw.substr(i + 1, 2));
+      ret += static_cast<char>(std::stoi(esc, nullptr, 16));
+      i += esc.size();
+    }
+    // unknown escapes are dropped together with the slash
+  }
+
+  return ret;
+}
@@ -1,9 +1,11 @@
 #pragma once
 #include <string>
-#include <deque>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "symbols.hpp"
 
-enum class TokenType {
+enum class TokenType : uint8_t {
   // types
   String,
 	Number,
@@ -21,6 +23,9 @@ enum class TokenType {
   Else,
   ElseIf,
   While,
+  For,
+  In,
+  Match,
 
   LogicalExpr,
   Not,
@@ -42,7 +47,36 @@ enum class TokenType {
   EndOfFile,
 };
 
-static const std::unordered_map<std::string, TokenType> KEYWORDS = {
+// which operator a BinaryOperator / BitwiseShift / ComparisonExpr / LogicalExpr token is
+enum class Operator : uint8_t {
+  None,
+  Add,          // +
+  Substract,    // -
+  Multiply,     // *
+  Divide,       // /
+  Modulo,       // %
+  ShiftLeft,    // <<
+  ShiftRight,   // >>
+  Equal,        // ==
+  NotEqual,     // !=
+  Greater,      // >
+  GreaterEqual, // >=
+  Less,         // <
+  LessEqual,    // <=
+  And,
+  Or,
+  Xor,
+
+  Count,
+};
+
+struct Keyword {
+  std::string_view word;
+  TokenType type = TokenType::Identifier;
+  Operator op = Operator::None;
+};
+
+constexpr Keyword KEYWORDS[] = {
   { "callable", TokenType::Callable },
   { "const", TokenType::Const },
   { "local", TokenType::Local },
@@ -50,27 +84,118 @@ static const std::unordered_map<std::string, TokenType> KEYWORDS = {
   { "else", TokenType::Else },
   { "else_if", TokenType::ElseIf },
   { "while", TokenType::While },
+  { "for", TokenType::For },
+  { "in", TokenType::In },
+  { "match", TokenType::Match },
 
-  { "and", TokenType::LogicalExpr },
-  { "or", TokenType::LogicalExpr },
-  { "xor", TokenType::LogicalExpr },
+  { "and", TokenType::LogicalExpr, Operator::And },
+  { "or", TokenType::LogicalExpr, Operator::Or },
+  { "xor", TokenType::LogicalExpr, Operator::Xor },
   { "not", TokenType::Not },
 };
 
+// Perfect hash over the keyword list: first char, last char and length pick the slot.
+// If a new keyword collides the static_assert below fires, retune the multipliers then
+constexpr size_t KEYWORD_SLOTS = 16;
+
+constexpr size_t keyword_slot(std::string_view word) {
+  return (
+    static_cast<unsigned char>(word[0])
+    + static_cast<unsigned char>(word[word.size() - 1]) * 11
+    + word.size() * 3
+  ) % KEYWORD_SLOTS;
+}
+
+struct KeywordTable {
+  Keyword slots[KEYWORD_SLOTS] = {};
+  bool perfect = true;
+};
+
+constexpr KeywordTable make_keyword_table() {
+  KeywordTable table;
+  for (const Keyword& keyword : KEYWORDS) {
+    Keyword& slot = table.slots[keyword_slot(keyword.word)];
+    if (!slot.word.empty()) table.perfect = false;
+    slot = keyword;
+  }
+  return table;
+}
+
+constexpr KeywordTable KEYWORD_TABLE = make_keyword_table();
+static_assert(KEYWORD_TABLE.perfect, "keyword hash has collisions");
+
+// one hash and at most one string compare, returns nullptr for plain identifiers
+inline const Keyword* find_keyword(std::string_view word) {
+  const Keyword& slot = KEYWORD_TABLE.slots[keyword_slot(word)];
+  return slot.word == word ? &slot : nullptr;
+}
+
+// Tokens don't own their text, they are a kind plus a window into the source buffer.
+// For string literals the window is the raw body between the quotes (escapes not resolved yet).
+// Identifiers also carry their interned symbol and operators which operator they are
 class Token {
   public:
-    std::string value;
     TokenType type;
+    Operator op = Operator::None;
+    uint32_t offset;
+    uint32_t length;
+    Symbol symbol = 0;
 
-    Token(std::string v, TokenType t) {
-      value = v;
-      type = t;
+    Token() {
+      type = TokenType::EndOfFile;
+      offset = 0;
+      length = 0;
     }
 
-    Token(char v, TokenType t) {
-      value = std::string(1, v);
+    Token(TokenType t, uint32_t o, uint32_t l) {
       type = t;
+      offset = o;
+      length = l;
+    }
+
+    std::string_view text(std::string_view source) const {
+      return source.substr(offset, length);
     }
 };
 
-std::deque<Token> tokenize(std::string sourceCode);
\ No newline at end of file
+// Scans the source by index, the buffer has to outlive every token produced from it
+class Lexer {
+  private:
+    std::string_view source;
+    size_t pos = 0;
+    TokenType last = TokenType::EndOfFile; // type of the token returned before
+
+    char peek(size_t n = 0) const;
+    Token make(TokenType type, size_t start, Operator op = Operator::None);
+
+  public:
+    Lexer() = default;
+    Lexer(std::string_view sourceCode);
+    // keeps returning EndOfFile once the source is exhausted
+    Token next();
+};
+
+// Pulls tokens from the lexer on demand. Only a small ring around the cursor is kept,
+// so memory stays the same no matter how big the source is
+class TokenStream {
+  private:
+    static constexpr size_t LOOKAHEAD = 8; // has to be a power of two
+
+    Lexer lexer;
+    Token ring[LOOKAHEAD];
+    size_t head = 0; // index of the current token
+    size_t pulled = 0; // how many tokens were taken from the lexer so far
+
+  public:
+    TokenStream() = default;
+    TokenStream(std::string_view sourceCode);
+
+    const Token& peek(size_t n = 0);
+    // the returned token stays valid until the stream pulls LOOKAHEAD - 1 more tokens
+    const Token& advance();
+};
+
+std::vector<Token> tokenize(std::string_view sourceCode);
+
+// resolves the escape codes in the raw body of a string literal
+std::string unescape_string(std::string_view raw);
@@ -0,0 +1,247 @@
+#include "loader.hpp"
+#include "astcache.hpp"
+#include "../optimization/optimizer.hpp"
+#include "../optimization/resolver.hpp"
+#include "../Errors.hpp"
+#include "../util.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+static bool preloadEnabled = true;
+static std::unordered_map<std::string, std::string_view> bundledModules; // filled before anything runs, read only after
+
+void set_module_preload_enabled(bool enabled) {
+  preloadEnabled = enabled;
+}
+
+// Threads are only started with the first job, a script without imports never pays for them
+class ThreadPool {
+  private:
+    size_t threadCount;
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex lock;
+    std::condition_variable wakeup;
+    bool stopping = false;
+
+    void work() {
+      while (true) {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> guard(lock);
+          wakeup.wait(guard, [this]() { return stopping || !jobs.empty(); });
+          if (stopping) return; // whatever is still queued isn't needed anymore
+          job = std::move(jobs.front());
+          jobs.pop_front();
+        }
+        job();
+      }
+    }
+
+  public:
+    ThreadPool(size_t threads) {
+      threadCount = threads;
+    }
+
+    // lets running jobs finish, so nothing is torn down under a worker on exit
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+      }
+      wakeup.notify_all();
+      for (std::thread& worker : workers) worker.join();
+    }
+
+    void submit(std::function<void()> job) {
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.push_back(std::move(job));
+        while (workers.size() < threadCount) {
+          workers.emplace_back([this]() { work(); });
+        }
+      }
+      wakeup.notify_one();
+    }
+};
+
+// One per module path. Whoever claims it first (a worker, or the main thread when it can't
+// wait) does the parsing, everybody else waits on the future
+struct ModuleJob {
+  std::string path;
+  std::string dir;
+  std::atomic<bool> claimed{false};
+  std::promise<Program*> promise;
+  std::shared_future<Program*> result = promise.get_future().share();
+};
+
+class ModuleLoader {
+  private:
+    std::mutex lock;
+    std::unordered_map<std::string, std::shared_ptr<ModuleJob>> modules;
+    ThreadPool pool;
+
+    static size_t thread_count() {
+      size_t cores = std::thread::hardware_concurrency();
+      return cores == 0 ? 1 : cores;
+    }
+
+  public:
+    ModuleLoader(): pool(thread_count()) {}
+
+    std::shared_ptr<ModuleJob> find_or_add(const std::string& path, const std::string& dir, bool& added) {
+      std::lock_guard<std::mutex> guard(lock);
+      auto& job = modules[path];
+      added = job == nullptr;
+      if (added) {
+        job = std::make_shared<ModuleJob>();
+        job->path = path;
+        job->dir = dir;
+      }
+      return job;
+    }
+
+    void preload(const std::string& path, const std::string& dir) {
+      bool added;
+      std::shared_ptr<ModuleJob> job = find_or_add(path, dir, added);
+      if (!added) return;
+
+      pool.submit([this, job]() {
+        if (job->claimed.exchange(true)) return;
+        job->promise.set_value(parse_in_background(*job));
+      });
+    }
+
+    void preload_imports(Program* program, const std::string& dir);
+    Program* parse_in_background(ModuleJob& job);
+};
+
+static ModuleLoader& loader() {
+  static ModuleLoader modules;
+  return modules;
+}
+
+// literal @import("x") / @include("x") calls anywhere in the tree, including callable bodies.
+// Those might never run, but parsing a file nobody asks for costs nothing on the main thread
+static void find_imports(Stmt* node, std::vector<SpecialExpr*>& found) {
+  if (node == nullptr) return;
+
+  if (node->kind == NodeType::SpecialExpr) {
+    SpecialExpr* special = static_cast<SpecialExpr*>(node);
+    if (
+      (special->identifier == SYM_IMPORT || special->identifier == SYM_INCLUDE)
+      && special->isFunction
+      && !special->args.empty()
+      && special->args[0]->kind == NodeType::StringLiteral
+    ) {
+      found.push_back(special);
+    }
+  }
+
+  for_each_child(node, [&](Stmt* child) {
+    find_imports(child, found);
+  });
+}
+
+std::vector<std::pair<std::string, std::string>> static_imports(Program* program, const std::string& dir) {
+  std::vector<SpecialExpr*> imports;
+  find_imports(program, imports);
+
+  std::vector<std::pair<std::string, std::string>> found;
+  for (SpecialExpr* special : imports) {
+    std::string_view name = static_cast<StringLiteral*>(special->args[0])->value;
+    if (name.empty() || name[0] == '<') continue; // built-in module
+
+    // same paths eval_special_expr builds: imports run with @path set to their own folder,
+    // includes keep the @path of whoever included them
+    std::string path = dir + "/" + std::string(name);
+    found.push_back({ path, special->identifier == SYM_IMPORT ? path_of_file(path) : dir });
+  }
+  return found;
+}
+
+void ModuleLoader::preload_imports(Program* program, const std::string& dir) {
+  for (auto& [path, importDir] : static_imports(program, dir)) {
+    preload(path, importDir);
+  }
+}
+
+void add_bundled_module(const std::string& path, std::string_view image) {
+  bundledModules[path] = image;
+}
+
+static Program* parse_bundled(const std::string& path, std::string_view image) {
+  Program* program = deserialize_program(image);
+  if (program == nullptr) {
+    raise_error("The bundled copy of " + path + " is damaged");
+  }
+  return program;
+}
+
+// everything a module goes through before it can run
+static Program* parse_module(const std::string& path) {
+  Program* program;
+  auto bundled = bundledModules.find(path);
+  if (bundled != bundledModules.end()) {
+    program = parse_bundled(path, bundled->second);
+  } else {
+    // through raise_error, so a background parse gives up instead of ending the process
+    MappedFile sourceFile;
+    if (!sourceFile.open(path.c_str())) raise_error("Could not open file " + path);
+    program = parse_file(path, sourceFile.view());
+  }
+  optimize_program(program);
+  resolve_program(program);
+  return program;
+}
+
+Program* ModuleLoader::parse_in_background(ModuleJob& job) {
+  std::error_code error;
+  if (bundledModules.find(job.path) == bundledModules.end() && !std::filesystem::is_regular_file(job.path, error)) return nullptr;
+
+  Program* program;
+  try {
+    ErrorCapture capture;
+    program = parse_module(job.path);
+  } catch (...) { // EastError, or whatever else the main thread will run into again
+    return nullptr;
+  }
+
+  preload_imports(program, job.dir);
+  return program;
+}
+
+Program* load_module(const std::string& path, const std::string& dir) {
+  if (!preloadEnabled) {
+    return parse_module(path);
+  }
+
+  ModuleLoader& modules = loader();
+  bool added;
+  std::shared_ptr<ModuleJob> job = modules.find_or_add(path, dir, added);
+
+  Program* program = nullptr;
+  if (!job->claimed.exchange(true)) {
+    // nobody got to it yet, no point in waiting for a worker
+    program = parse_module(path);
+    modules.preload_imports(program, dir);
+    job->promise.set_value(program);
+  } else {
+    program = job->result.get();
+  }
+
+  if (program == nullptr) {
+    // the background parse failed, do it again here so the error is raised like usual
+    program = parse_module(path);
+  }
+  return program;
+}
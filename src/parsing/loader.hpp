@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ast.hpp"
+
+/*
+Module loader.
+Once a file is parsed its @import("...") / @include("...") calls with a literal path are
+already known, so they get parsed on a thread pool (and their imports after them, and so on)
+while the importing program starts running. By the time the interpreter reaches an import the
+tree is usually sitting there ready.
+Anything that goes wrong in the background (missing file, syntax error) is forgotten, the file
+is loaded again on the main thread when it's actually needed and fails there like it always did.
+*/
+
+void set_module_preload_enabled(bool enabled);
+
+// `dir` is what @path will be while the module runs, imports in it are resolved against that.
+// Same path, same Program: each file is only parsed once
+Program* load_module(const std::string& path, const std::string& dir);
+
+// makes `path` load from an .eastc image instead of the file system, has to be called
+// before anything is loaded and the image has to stay alive (see bundle.hpp)
+void add_bundled_module(const std::string& path, std::string_view image);
+
+// the files a program imports or includes by literal path, as (path, @path while it runs)
+std::vector<std::pair<std::string, std::string>> static_imports(Program* program, const std::string& dir);
@@ -8,12 +8,14 @@ Orders Of Precedence https://en.cppreference.com/w/cpp/language/operator_precede
   - AdditiveExpr
   - MultiplicitaveExpr
   - Call   - ~~Member~~ // no members as of now `a().b.c()` - Subscript
-  - PrimaryExpr // callable, if, while definitions (because if everything is an expression, these need to be evaled first)
+  - PrimaryExpr // callable, if, while, for definitions (because if everything is an expression, these need to be evaled first)
+
+  The binary levels (logic down to multiplicative) are one precedence climbing loop
+  in parse_binary_expr driven by the OPERATOR_PRECEDENCE table
 
 TODOs:
 
   - OOP (far future)
-  - Pattern matching (maybe a new type)
   - Maybe objects
   - Maybe FFI
   - some sort of way to interact with RuntimeVal's (maybe methods `"".join(list)` or modules for it `string.join("", list)`)
@@ -27,26 +29,28 @@ TODOs:
 #include "../util.hpp"
 
 bool Parser::not_eof() {
-  return tokens[0].type != TokenType::EndOfFile;
+  return tokens.peek().type != TokenType::EndOfFile;
 }
 
-Token Parser::curr() {
-  return tokens[0];
+std::string_view Parser::text(const Token& token) {
+  if (token.type == TokenType::EndOfFile) return "EOF";
+  return token.text(source);
 }
 
-Token Parser::look_ahead(int n) {
-  return tokens[n];
+const Token& Parser::curr() {
+  return tokens.peek();
 }
 
-Token Parser::advance() {
-  Token value = tokens.front();
-  tokens.pop_front();
+const Token& Parser::look_ahead(int n) {
+  return tokens.peek(n);
+}
 
-  return value;
+const Token& Parser::advance() {
+  return tokens.advance();
 }
 
-Token Parser::expect(TokenType expected_token, std::string error_message) {
-  Token value = advance();
+const Token& Parser::expect(TokenType expected_token, const char* error_message) {
+  const Token& value = advance();
 
   if (value.type != expected_token) {
     raise_error(error_message);
@@ -55,59 +59,50 @@ Token Parser::expect(TokenType expected_token, std::string error_message) {
   return value;
 }
 
-OperatorType Parser::get_math_operator(std::string operatorLiteral) {
-  if (operatorLiteral == "+") {
-    return OperatorType::add;
-  } else if (operatorLiteral == "-") {
-    return OperatorType::substract;
-  } else if (operatorLiteral == "*") {
-    return OperatorType::multiply;
-  } else if (operatorLiteral == "/") {
-    return OperatorType::divide;
-  } else if (operatorLiteral == "%") {
-    return OperatorType::modulo;
-  } else {
-    raise_error("Unexpected operator, " + operatorLiteral);
-  }
-}
-
-LogicalOperatorType Parser::get_logical_operator(std::string operatorLiteral) {
-  if (operatorLiteral == "and") {
-    return LogicalOperatorType::And;
-  } else if (operatorLiteral == "or") {
-    return LogicalOperatorType::Or;
-  } else if (operatorLiteral == "xor") {
-    return LogicalOperatorType::Xor;
-  } else {
-    raise_error("Unexpected logical operator, " + operatorLiteral);
-  }
-}
-
-ComparisonOperatorType Parser::get_comparison_operator(std::string operatorLiteral) {
-  if (operatorLiteral == "==") {
-    return ComparisonOperatorType::equal;
-  } else if (operatorLiteral == ">") {
-    return ComparisonOperatorType::greater;
-  } else if (operatorLiteral == ">=") {
-    return ComparisonOperatorType::greater_equal;
-  } else if (operatorLiteral == "<") {
-    return ComparisonOperatorType::less;
-  } else if (operatorLiteral == "<=") {
-    return ComparisonOperatorType::less_equal;
-  } else if (operatorLiteral == "!=") {
-    return ComparisonOperatorType::not_equal;
-  } else {
-    raise_error("Unexpected logical operator, " + operatorLiteral);
-  }
-}
-
-Program* Parser::parse_ast(std::string& sourceCode) {
-  tokens = tokenize(sourceCode);
+// binding power of the binary operators, higher binds tighter and every level is left associative
+enum Precedence {
+  PREC_NONE = 0,
+  PREC_LOGICAL,
+  PREC_COMPARISON,
+  PREC_SHIFT,
+  PREC_ADDITIVE,
+  PREC_MULTIPLICATIVE,
+};
+
+static const int OPERATOR_PRECEDENCE[] = {
+  PREC_NONE,           // None
+  PREC_ADDITIVE,       // +
+  PREC_ADDITIVE,       // -
+  PREC_MULTIPLICATIVE, // *
+  PREC_MULTIPLICATIVE, // /
+  PREC_MULTIPLICATIVE, // %
+  PREC_SHIFT,          // <<
+  PREC_SHIFT,          // >>
+  PREC_COMPARISON,     // ==
+  PREC_COMPARISON,     // !=
+  PREC_COMPARISON,     // >
+  PREC_COMPARISON,     // >=
+  PREC_COMPARISON,     // <
+  PREC_COMPARISON,     // <=
+  PREC_LOGICAL,        // and
+  PREC_LOGICAL,        // or
+  PREC_LOGICAL,        // xor
+};
+static_assert(sizeof(OPERATOR_PRECEDENCE) / sizeof(int) == static_cast<size_t>(Operator::Count), "every operator needs a precedence");
+
+Program* Parser::parse_ast(std::string_view sourceCode) {
+  source = sourceCode;
+  tokens = TokenStream(sourceCode);
   Program* program = new Program();
+  arena = &program->arena;
+
+  size_t mark = scratch.size();
   while (not_eof()) {
-    program->body.push_back(parse_expr()); // everything is an expression :clueless:
+    scratch.push_back(parse_expr()); // everything is an expression :clueless:
   }
+  program->body = take_list<Stmt*>(mark);
 
+  arena = nullptr;
   return program;
 }
 
@@ -125,9 +120,9 @@ Expr* Parser::parse_assignment_expr() {
     }
     expect(TokenType::Equals, "an Equal sign is needed after a const declaration"); // remove the equal sign
 
-    VariableDeclaration* var = new VariableDeclaration();
+    VariableDeclaration* var = make<VariableDeclaration>();
     var->constant = true;
-    var->identifier = static_cast<Identifier*>(iden)->value;
+    var->identifier = static_cast<Identifier*>(iden)->symbol;
     var->value = parse_expr();
     return var;
   } else if (curr().type == TokenType::Local) {
@@ -144,25 +139,25 @@ Expr* Parser::parse_assignment_expr() {
       advance();
       value = parse_expr();
     } else {
-      Identifier* empty = new Identifier();
-      empty->value = "empty";
+      Identifier* empty = make<Identifier>();
+      empty->symbol = SYM_EMPTY;
 
       value = empty;
     }
 
-    AssignmentExpr* var = new AssignmentExpr();
+    AssignmentExpr* var = make<AssignmentExpr>();
     var->local = true;
     var->identifier = iden;
     var->value = value;
     return var;
   }
-  Expr* left = parse_logical_expr();
+  Expr* left = parse_binary_expr(PREC_LOGICAL);
 
   if (curr().type == TokenType::Equals) {
     advance(); // eat the curr equal sign
     Expr* right = parse_expr();
 
-    AssignmentExpr* assign = new AssignmentExpr();
+    AssignmentExpr* assign = make<AssignmentExpr>();
     assign->identifier = left;
     assign->value = right;
     return assign;
@@ -170,95 +165,85 @@ Expr* Parser::parse_assignment_expr() {
   return left;
 }
 
-Expr* Parser::parse_logical_expr() {
-  if (curr().type == TokenType::Not) {
+Expr* Parser::parse_binary_expr(int min_precedence) {
+  // `not` negates the whole logical expression after it, so it's only allowed where one can start
+  if (min_precedence <= PREC_LOGICAL && curr().type == TokenType::Not) {
     advance();
-    Expr* negatedExpr = parse_logical_expr();
-
-    NegateExpr* neg = new NegateExpr();
-    neg->expr = negatedExpr;
+    NegateExpr* neg = make<NegateExpr>();
+    neg->expr = parse_binary_expr(PREC_LOGICAL);
     return neg;
   }
 
-  Expr* left = parse_comparison_expr();
-  while (curr().type == TokenType::LogicalExpr) {
-    LogicalExpr* logicExpr = new LogicalExpr();
+  Expr* left = parse_call_member_expr();
+  while (true) {
+    Operator op = curr().op;
+    int precedence = OPERATOR_PRECEDENCE[static_cast<size_t>(op)];
+    if (precedence == PREC_NONE || precedence < min_precedence) break;
 
-    logicExpr->op = get_logical_operator(curr().value);
     advance();
-    logicExpr->left = left;
-    logicExpr->right = parse_comparison_expr();
-
-
-    left = logicExpr;
+    Expr* right = parse_binary_expr(precedence + 1);
+    left = make_binary_expr(op, left, right);
   }
   return left;
 }
 
-Expr* Parser::parse_comparison_expr() {
-  Expr* left = parse_bitwise_shift_expr();
-  while (curr().type == TokenType::ComparisonExpr) {
-    ComparisonExpr* compExpr = new ComparisonExpr();
-
-    compExpr->op = get_comparison_operator(curr().value);
-    advance();
-    compExpr->left = left;
-    compExpr->right = parse_bitwise_shift_expr();
-
-    left = compExpr;
-  }
-  return left;
+static BinaryExpr* make_math_expr(AstArena& arena, OperatorType op, Expr* left, Expr* right) {
+  BinaryExpr* binary = arena.make<BinaryExpr>();
+  binary->expr_operator = op;
+  binary->left = left;
+  binary->right = right;
+  return binary;
 }
 
-Expr* Parser::parse_bitwise_shift_expr() {
-  Expr* left = parse_additive_expr();
-  while (curr().type == TokenType::BitwiseShift) {
-    BitShiftExpr* bitShiftExpr = new BitShiftExpr();
-
-    if (advance().value == ">>") {
-      bitShiftExpr->shiftRight = true;
-    } else {
-      bitShiftExpr->shiftRight = false;
-    }
-
-    bitShiftExpr->left = left;
-    bitShiftExpr->right = parse_additive_expr();
+static ComparisonExpr* make_comparison_expr(AstArena& arena, ComparisonOperatorType op, Expr* left, Expr* right) {
+  ComparisonExpr* compExpr = arena.make<ComparisonExpr>();
+  compExpr->op = op;
+  compExpr->left = left;
+  compExpr->right = right;
+  return compExpr;
+}
 
-    left = bitShiftExpr;
-  }
-  return left;
+static LogicalExpr* make_logical_expr(AstArena& arena, LogicalOperatorType op, Expr* left, Expr* right) {
+  LogicalExpr* logicExpr = arena.make<LogicalExpr>();
+  logicExpr->op = op;
+  logicExpr->left = left;
+  logicExpr->right = right;
+  return logicExpr;
 }
 
-Expr* Parser::parse_additive_expr() {
-  Expr* left = parse_multiplicative_expr();
-  while (curr().value == "+" || curr().value == "-") {
-    std::string operatorType = advance().value;
-    Expr* right = parse_multiplicative_expr();
+static BitShiftExpr* make_bit_shift_expr(AstArena& arena, bool shiftRight, Expr* left, Expr* right) {
+  BitShiftExpr* bitShiftExpr = arena.make<BitShiftExpr>();
+  bitShiftExpr->shiftRight = shiftRight;
+  bitShiftExpr->left = left;
+  bitShiftExpr->right = right;
+  return bitShiftExpr;
+}
 
-    BinaryExpr* binary = new BinaryExpr();
-    binary->expr_operator = get_math_operator(operatorType);
-    binary->left = left;
-    binary->right = right;
+Expr* Parser::make_binary_expr(Operator op, Expr* left, Expr* right) {
+  switch (op) {
+    case Operator::Add: return make_math_expr(*arena, OperatorType::add, left, right);
+    case Operator::Substract: return make_math_expr(*arena, OperatorType::substract, left, right);
+    case Operator::Multiply: return make_math_expr(*arena, OperatorType::multiply, left, right);
+    case Operator::Divide: return make_math_expr(*arena, OperatorType::divide, left, right);
+    case Operator::Modulo: return make_math_expr(*arena, OperatorType::modulo, left, right);
 
-    left = binary;
-  }
-  return left;
-}
+    case Operator::ShiftLeft: return make_bit_shift_expr(*arena, false, left, right);
+    case Operator::ShiftRight: return make_bit_shift_expr(*arena, true, left, right);
 
-Expr* Parser::parse_multiplicative_expr() {
-  Expr* left = parse_call_member_expr();
-  while (curr().value == "*" || curr().value == "/" || curr().value == "%") {
-    std::string operatorType = advance().value;
-    Expr* right = parse_call_member_expr();
+    case Operator::Equal: return make_comparison_expr(*arena, ComparisonOperatorType::equal, left, right);
+    case Operator::NotEqual: return make_comparison_expr(*arena, ComparisonOperatorType::not_equal, left, right);
+    case Operator::Greater: return make_comparison_expr(*arena, ComparisonOperatorType::greater, left, right);
+    case Operator::GreaterEqual: return make_comparison_expr(*arena, ComparisonOperatorType::greater_equal, left, right);
+    case Operator::Less: return make_comparison_expr(*arena, ComparisonOperatorType::less, left, right);
+    case Operator::LessEqual: return make_comparison_expr(*arena, ComparisonOperatorType::less_equal, left, right);
 
-    BinaryExpr* binary = new BinaryExpr();
-    binary->expr_operator = get_math_operator(operatorType);
-    binary->left = left;
-    binary->right = right;
+    case Operator::And: return make_logical_expr(*arena, LogicalOperatorType::And, left, right);
+    case Operator::Or: return make_logical_expr(*arena, LogicalOperatorType::Or, left, right);
+    case Operator::Xor: return make_logical_expr(*arena, LogicalOperatorType::Xor, left, right);
 
-    left = binary;
+    default:
+      raise_error("Unexpected operator");
   }
-  return left;
 }
 
 Expr* Parser::parse_call_member_expr() {
@@ -285,7 +270,7 @@ Expr* Parser::parse_subscript_expr(Expr* left) {
   if (curr().type != TokenType::OpenBracket) return left;
   advance();
 
-  SubscriptExpr* sub = new SubscriptExpr();
+  SubscriptExpr* sub = make<SubscriptExpr>();
   sub->left = left;
   sub->value = parse_expr();
 
@@ -299,15 +284,15 @@ Expr* Parser::parse_member_expr(Expr* left) {
   if (iden->kind != NodeType::Identifier)
     raise_error("expected an identifier after the dot expr");
 
-  MemberExpr* memberExpr = new MemberExpr();
+  MemberExpr* memberExpr = make<MemberExpr>();
   memberExpr->left = left;
-  memberExpr->identifier = static_cast<Identifier*>(iden)->value;
+  memberExpr->identifier = static_cast<Identifier*>(iden)->symbol;
 
   return memberExpr;
 }
 
 Expr* Parser::parse_call_expr(Expr* caller) {
-  CallExpr* callExpr = new CallExpr();
+  CallExpr* callExpr = make<CallExpr>();
   callExpr->caller = caller;
   callExpr->args = parse_call_args();
 
@@ -317,38 +302,51 @@ Expr* Parser::parse_call_expr(Expr* caller) {
   return callExpr;
 }
 
-std::vector<Expr*> Parser::parse_call_args() {
+ExprList Parser::parse_call_args() {
   advance(); // eat the open paren
-  std::vector<Expr*> args = {};
+  size_t mark = scratch.size();
   if (curr().type != TokenType::ClosedParen) {
-    Expr* arg = parse_expr();
-    args.push_back(arg);
+    scratch.push_back(parse_expr());
 
     while (curr().type == TokenType::Comma) {
       advance(); // eat the comma
-      Expr* arg = parse_expr();
-      args.push_back(arg);
+      scratch.push_back(parse_expr());
     }
   }
   expect(TokenType::ClosedParen, "Expected a closing paren"); // eat the closing paren
-  return args;
+  return take_list<Expr*>(mark);
 }
 
-std::vector<Expr*> Parser::parse_list_elements() {
+ExprList Parser::parse_list_elements() {
   advance(); // eat the open braket
-  std::vector<Expr*> args;
+  size_t mark = scratch.size();
   if (curr().type != TokenType::ClosedBracket) {
-    Expr* arg = parse_expr();
-    args.push_back(arg);
+    scratch.push_back(parse_expr());
 
     while (curr().type == TokenType::Comma) {
       advance(); // eat the comma
-      Expr* arg = parse_expr();
-      args.push_back(arg);
+      scratch.push_back(parse_expr());
     }
   }
   expect(TokenType::ClosedBracket, "Expected a closing bracket"); // eat the closing bracket
-  return args;
+  return take_list<Expr*>(mark);
+}
+
+StmtList Parser::parse_body(const char* name) {
+  // the messages are only built when something is actually wrong
+  if (curr().type != TokenType::OpenBrace)
+    raise_error(std::string("Expected an open Brace for ") + name + " body declaration");
+  advance();
+
+  size_t mark = scratch.size();
+  while (not_eof() && curr().type != TokenType::ClosedBrace) {
+    scratch.push_back(parse_expr());
+  }
+  if (curr().type != TokenType::ClosedBrace)
+    raise_error(std::string("Expected a closing brace to close the ") + name + " body definition");
+  advance();
+
+  return take_list<Stmt*>(mark);
 }
 
 Expr* Parser::parse_special_expr() {
@@ -357,8 +355,8 @@ Expr* Parser::parse_special_expr() {
 
   Identifier* iden = static_cast<Identifier*>(parse_primary_expr());
 
-  SpecialExpr* specialExpr = new SpecialExpr();
-  specialExpr->identifier = iden->value;
+  SpecialExpr* specialExpr = make<SpecialExpr>();
+  specialExpr->identifier = iden->symbol;
 
   if (curr().type != TokenType::OpenParen) {
     return specialExpr;
@@ -367,35 +365,95 @@ Expr* Parser::parse_special_expr() {
 
   specialExpr->isFunction = true;
 
+  size_t mark = scratch.size();
   while (not_eof() && curr().type != TokenType::ClosedParen) {
-    specialExpr->args.push_back(parse_expr());
+    scratch.push_back(parse_expr());
     if (curr().type == TokenType::Comma) advance();
   }
+  specialExpr->args = take_list<Expr*>(mark);
 
-  expect(TokenType::ClosedParen, "Missing closing paren for special function " + iden->value);
+  if (curr().type != TokenType::ClosedParen)
+    raise_error("Missing closing paren for special function " + symbol_name(iden->symbol));
+  advance();
 
   return specialExpr;
 }
 
+// numbers, strings and arrays of patterns, names only inside arrays
+MatchPattern Parser::parse_pattern(bool nested) {
+  MatchPattern pattern;
+  switch (curr().type) {
+    case TokenType::Number: {
+      pattern.kind = PatternKind::Number;
+      pattern.number = std::stod(std::string(text(advance())));
+      return pattern;
+    }
+    case TokenType::BinaryOperator: { // a negative number
+      if (curr().op != Operator::Substract || look_ahead(1).type != TokenType::Number) break;
+      advance();
+      pattern.kind = PatternKind::Number;
+      pattern.number = -std::stod(std::string(text(advance())));
+      return pattern;
+    }
+    case TokenType::String: {
+      pattern.kind = PatternKind::String;
+      std::string_view raw = text(advance());
+      if (raw.find('\\') == std::string_view::npos) {
+        pattern.string = arena->copy_string(raw);
+      } else {
+        pattern.string = arena->copy_string(unescape_string(raw));
+      }
+      return pattern;
+    }
+    case TokenType::Identifier: {
+      if (!nested) break;
+      pattern.kind = PatternKind::Bind;
+      pattern.binding = advance().symbol;
+      return pattern;
+    }
+    case TokenType::OpenBracket: {
+      advance(); // eat the open bracket
+      std::vector<MatchPattern> elements;
+      while (not_eof() && curr().type != TokenType::ClosedBracket) {
+        elements.push_back(parse_pattern(true));
+        if (curr().type != TokenType::Comma) break;
+        advance(); // eat the comma
+      }
+      expect(TokenType::ClosedBracket, "Expected a closing bracket to close the array pattern");
+      pattern.kind = PatternKind::Array;
+      pattern.elements = arena->copy_list(elements);
+      return pattern;
+    }
+    default:
+      break;
+  }
+  raise_error("Expected a number, string or array pattern in match, got: " + std::string(text(curr())));
+}
+
 Expr* Parser::parse_primary_expr() {
   TokenType token = curr().type;
 
   switch (token) {
     case TokenType::Identifier: {
-      Identifier* iden = new Identifier();
-      iden->value = advance().value;
+      Identifier* iden = make<Identifier>();
+      iden->symbol = advance().symbol;
 
       return iden;
     }
     case TokenType::Number: {
-      NumberLiteral* numLit = new NumberLiteral();
-      numLit->value = std::stod(advance().value);
+      NumberLiteral* numLit = make<NumberLiteral>();
+      numLit->value = std::stod(std::string(text(advance())));
 
       return numLit;
     }
     case TokenType::String: {
-      StringLiteral* strLit = new StringLiteral();
-      strLit->value = advance().value;
+      StringLiteral* strLit = make<StringLiteral>();
+      std::string_view raw = text(advance());
+      if (raw.find('\\') == std::string_view::npos) {
+        strLit->value = arena->copy_string(raw);
+      } else {
+        strLit->value = arena->copy_string(unescape_string(raw));
+      }
 
       return strLit;
     }
@@ -410,66 +468,40 @@ Expr* Parser::parse_primary_expr() {
       if (curr().type != TokenType::OpenParen)
         raise_error("Expected open paren after callable keyword");
 
-      std::vector<std::string> params = {};
-      std::vector<Expr*> args = parse_call_args();
-      for (auto arg : args) {
-        if (arg->kind != NodeType::Identifier) // check if every param is an identifier
+      ExprList args = parse_call_args();
+      NodeList<Symbol> params = arena->make_list<Symbol>(args.size());
+      for (size_t i = 0; i < args.size(); i++) {
+        if (args[i]->kind != NodeType::Identifier) // check if every param is an identifier
           raise_error("Only identifiers in callable definition");
-        params.push_back(static_cast<Identifier*>(arg)->value);
+        params[i] = static_cast<Identifier*>(args[i])->symbol;
       }
 
-      FunctionDeclaration* func = new FunctionDeclaration();
+      FunctionDeclaration* func = make<FunctionDeclaration>();
       func->parameters = params;
-
-      expect(TokenType::OpenBrace, "Expected an open Brace for callable body declaration");
-
-      while (not_eof() && curr().type != TokenType::ClosedBrace) {
-        Stmt* stmt = parse_expr();
-        func->body.push_back(stmt);
-      }
-      expect(TokenType::ClosedBrace, "Expected a closing brace to close the callable body definition");
+      func->body = parse_body("callable");
 
       return func;
     }
     case TokenType::If: {
       advance();
-      IfStatement* IfExpr = new IfStatement();
+      IfStatement* IfExpr = make<IfStatement>();
       IfExpr->check = parse_expr();
+      IfExpr->body = parse_body("if");
 
-      expect(TokenType::OpenBrace, "Expected an open Brace for if body declaration");
-
-      while (not_eof() && curr().type != TokenType::ClosedBrace) {
-        Stmt* stmt = parse_expr();
-        IfExpr->body.push_back(stmt);
-      }
-      expect(TokenType::ClosedBrace, "Expected a closing brace to close the if body definition");
-
+      std::vector<ElseIfBranch> else_if_chain;
       while (curr().type == TokenType::ElseIf) {
         advance();
 
-        Expr* check = parse_expr();
-        std::vector<Stmt*> else_if_body;
-
-        expect(TokenType::OpenBrace, "Expected an open Brace for else_if body declaration");
-
-        while (not_eof() && curr().type != TokenType::ClosedBrace) {
-          Stmt* stmt = parse_expr();
-          else_if_body.push_back(stmt);
-        }
-        expect(TokenType::ClosedBrace, "Expected a closing brace to close the else_if body definition");
-
-        IfExpr->else_if_chain.push_back({check, else_if_body});
+        ElseIfBranch branch;
+        branch.check = parse_expr();
+        branch.body = parse_body("else_if");
+        else_if_chain.push_back(branch);
       }
+      IfExpr->else_if_chain = arena->copy_list(else_if_chain);
 
       if (curr().type == TokenType::Else) {
         advance();
-        expect(TokenType::OpenBrace, "Expected an open Brace for else body declaration");
-
-        while (not_eof() && curr().type != TokenType::ClosedBrace) {
-          Stmt* stmt = parse_expr();
-          IfExpr->else_body.push_back(stmt);
-        }
-        expect(TokenType::ClosedBrace, "Expected a closing brace to close the else body definition");
+        IfExpr->else_body = parse_body("else");
       }
 
       return IfExpr;
@@ -477,22 +509,71 @@ Expr* Parser::parse_primary_expr() {
     case TokenType::While: {
       advance();
       Expr* check = parse_expr();
-      WhileStatement* WhileExpr = new WhileStatement();
+      WhileStatement* WhileExpr = make<WhileStatement>();
 
       WhileExpr->check = check;
+      WhileExpr->body = parse_body("while");
+
+      return WhileExpr;
+    }
+    case TokenType::For: {
+      advance();
+      ForStatement* forStmt = make<ForStatement>();
+      forStmt->identifier = expect(TokenType::Identifier, "Expected a name after for").symbol;
+      expect(TokenType::In, "Expected in after the name of a for loop");
 
-      expect(TokenType::OpenBrace, "Expected an open Brace for if body declaration");
+      // range is only special right here, anywhere else it's a name like any other
+      if (curr().type == TokenType::Identifier && curr().symbol == SYM_RANGE && look_ahead(1).type == TokenType::OpenParen) {
+        advance();
+        ExprList args = parse_call_args();
+        if (args.empty() || args.size() > 3) raise_error("range takes an end, a start and an end, or a start, an end and a step");
+        if (args.size() == 1) {
+          forStmt->end = args[0];
+        } else {
+          forStmt->start = args[0];
+          forStmt->end = args[1];
+          if (args.size() == 3) forStmt->step = args[2];
+        }
+      } else {
+        forStmt->iterable = parse_expr();
+      }
+      forStmt->body = parse_body("for");
+
+      return forStmt;
+    }
+    case TokenType::Match: {
+      advance();
+      MatchExpr* match = make<MatchExpr>();
+      match->value = parse_expr();
+      expect(TokenType::OpenBrace, "Expected an open Brace after the match value");
 
+      std::vector<MatchCase> cases;
       while (not_eof() && curr().type != TokenType::ClosedBrace) {
-        Stmt* stmt = parse_expr();
-        WhileExpr->body.push_back(stmt);
+        if (curr().type == TokenType::Else) { // has to be the last one
+          advance();
+          match->else_body = parse_body("match else");
+          break;
+        }
+
+        std::vector<MatchPattern> patterns;
+        patterns.push_back(parse_pattern(false));
+        while (curr().type == TokenType::Comma) {
+          advance(); // eat the comma
+          patterns.push_back(parse_pattern(false));
+        }
+
+        MatchCase matchCase;
+        matchCase.patterns = arena->copy_list(patterns);
+        matchCase.body = parse_body("match case");
+        cases.push_back(matchCase);
       }
-      expect(TokenType::ClosedBrace, "Expected a closing brace to close the if body definition");
+      match->cases = arena->copy_list(cases);
+      expect(TokenType::ClosedBrace, "Expected a closing brace to close the match");
 
-      return WhileExpr;
+      return match;
     }
     case TokenType::OpenBracket: {
-      ArrayLiteral* array = new ArrayLiteral();
+      ArrayLiteral* array = make<ArrayLiteral>();
       array->elements = parse_list_elements();
       return array;
     }
@@ -502,6 +583,6 @@ Expr* Parser::parse_primary_expr() {
     }
     default:
       print_token_type(token);
-      raise_error("Unexpected token: " + curr().value);
+      raise_error("Unexpected token: " + std::string(text(curr())));
   }
 }
\ No newline at end of file
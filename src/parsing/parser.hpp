@@ -1,37 +1,57 @@
+#pragma once
 #include "ast.hpp"
 #include "lexer.hpp"
-#include <deque>
+#include <string_view>
+#include <vector>
 
 class Parser {
   private:
-    std::deque<Token> tokens;
-    bool not_eof();
-    Token curr();
-    Token look_ahead(int n);
-    Token advance();
-    Token expect(TokenType expected_token, std::string error_message);
+    std::string_view source;
+    TokenStream tokens;
+    AstArena* arena = nullptr; // arena of the program being parsed
+    // list items pile up here and get copied into the arena once the list is closed
+    std::vector<Stmt*> scratch;
+
+    template <typename T>
+    T* make() {
+      return arena->make<T>();
+    }
 
-    OperatorType get_math_operator(std::string operatorLiteral);
-    LogicalOperatorType get_logical_operator(std::string operatorLiteral);
-    ComparisonOperatorType get_comparison_operator(std::string operatorLiteral);
+    // moves everything pushed to the scratch since `mark` into the arena
+    template <typename T>
+    NodeList<T> take_list(size_t mark) {
+      NodeList<T> list = arena->make_list<T>(scratch.size() - mark);
+      for (size_t i = 0; i < list.size(); i++) {
+        list[i] = static_cast<T>(scratch[mark + i]);
+      }
+      scratch.resize(mark);
+      return list;
+    }
+
+    bool not_eof();
+    std::string_view text(const Token& token);
+    const Token& curr();
+    const Token& look_ahead(int n);
+    const Token& advance();
+    const Token& expect(TokenType expected_token, const char* error_message);
 
   public:
-    Program* parse_ast(std::string& sourceCode);
+    // the source has to stay alive until parse_ast returns, the AST doesn't point into it
+    Program* parse_ast(std::string_view sourceCode);
 
   private:
     Expr* parse_expr();
     Expr* parse_assignment_expr();
-    Expr* parse_logical_expr();
-    Expr* parse_comparison_expr();
-    Expr* parse_bitwise_shift_expr();
-    Expr* parse_additive_expr();
-    Expr* parse_multiplicative_expr();
+    Expr* parse_binary_expr(int min_precedence);
+    Expr* make_binary_expr(Operator op, Expr* left, Expr* right);
     Expr* parse_call_member_expr();
     Expr* parse_subscript_expr(Expr* iden);
     Expr* parse_member_expr(Expr* iden);
     Expr* parse_call_expr(Expr* caller);
-    std::vector<Expr*> parse_call_args();
-    std::vector<Expr*> parse_list_elements();
+    ExprList parse_call_args();
+    ExprList parse_list_elements();
+    StmtList parse_body(const char* name);
+    MatchPattern parse_pattern(bool nested);
     Expr* parse_special_expr();
     Expr* parse_primary_expr();
 };
\ No newline at end of file
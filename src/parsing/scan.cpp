@@ -0,0 +1,236 @@
+#include "scan.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  #define EASTLANG_SCAN_X86 1
+  #include <immintrin.h>
+#endif
+
+struct ScanKernels {
+  const char * name;
+  size_t (*identifier)(const char *, size_t, size_t);
+  size_t (*number)(const char *, size_t, size_t);
+  size_t (*whitespace)(const char *, size_t, size_t);
+  size_t (*until)(const char *, size_t, size_t, char, char);
+};
+
+/*
+SCALAR
+*/
+static inline bool is_identifier_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool is_number_char(char c) {
+  return (c >= '0' && c <= '9') || c == '.';
+}
+
+static inline bool is_whitespace_char(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static size_t scalar_identifier(const char * data, size_t pos, size_t size) {
+  while (pos < size && is_identifier_char(data[pos])) pos++;
+  return pos;
+}
+
+static size_t scalar_number(const char * data, size_t pos, size_t size) {
+  while (pos < size && is_number_char(data[pos])) pos++;
+  return pos;
+}
+
+static size_t scalar_whitespace(const char * data, size_t pos, size_t size) {
+  while (pos < size && is_whitespace_char(data[pos])) pos++;
+  return pos;
+}
+
+static size_t scalar_until(const char * data, size_t pos, size_t size, char a, char b) {
+  while (pos < size && data[pos] != a && data[pos] != b) pos++;
+  return pos;
+}
+
+#ifdef EASTLANG_SCAN_X86
+/*
+SSE2 (always there on x86-64)
+The classes only cover ascii, bytes >= 0x80 compare as negative and fall out of every range
+*/
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+  return _mm_and_si128(
+    _mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+    _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), v)
+  );
+}
+
+static inline unsigned sse2_identifier_mask(__m128i v) {
+  __m128i letter = sse2_in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'); // 0x20 folds the case
+  __m128i digit = sse2_in_range(v, '0', '9');
+  __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), underscore));
+}
+
+static inline unsigned sse2_number_mask(__m128i v) {
+  __m128i digit = sse2_in_range(v, '0', '9');
+  __m128i dot = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+  return _mm_movemask_epi8(_mm_or_si128(digit, dot));
+}
+
+static inline unsigned sse2_whitespace_mask(__m128i v) {
+  __m128i space = _mm_or_si128(
+    _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+    _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))
+  );
+  __m128i newline = _mm_or_si128(
+    _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+    _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))
+  );
+  return _mm_movemask_epi8(_mm_or_si128(space, newline));
+}
+
+#define SSE2_SCAN_WHILE(mask_fn) \
+  while (pos + 16 <= size) { \
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos)); \
+    unsigned stop = ~mask_fn(v) & 0xFFFFu; \
+    if (stop != 0) return pos + __builtin_ctz(stop); \
+    pos += 16; \
+  }
+
+static size_t sse2_identifier(const char * data, size_t pos, size_t size) {
+  SSE2_SCAN_WHILE(sse2_identifier_mask)
+  return scalar_identifier(data, pos, size);
+}
+
+static size_t sse2_number(const char * data, size_t pos, size_t size) {
+  SSE2_SCAN_WHILE(sse2_number_mask)
+  return scalar_number(data, pos, size);
+}
+
+static size_t sse2_whitespace(const char * data, size_t pos, size_t size) {
+  SSE2_SCAN_WHILE(sse2_whitespace_mask)
+  return scalar_whitespace(data, pos, size);
+}
+
+static size_t sse2_until(const char * data, size_t pos, size_t size, char a, char b) {
+  __m128i va = _mm_set1_epi8(a);
+  __m128i vb = _mm_set1_epi8(b);
+  while (pos + 16 <= size) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    unsigned stop = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+    if (stop != 0) return pos + __builtin_ctz(stop);
+    pos += 16;
+  }
+  return scalar_until(data, pos, size, a, b);
+}
+
+/*
+AVX2, only called after the cpu check
+*/
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+  return _mm256_and_si256(
+    _mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+    _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v)
+  );
+}
+
+AVX2 static inline unsigned avx2_identifier_mask(__m256i v) {
+  __m256i letter = avx2_in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+  __m256i digit = avx2_in_range(v, '0', '9');
+  __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+  return _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore));
+}
+
+AVX2 static inline unsigned avx2_number_mask(__m256i v) {
+  __m256i digit = avx2_in_range(v, '0', '9');
+  __m256i dot = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'));
+  return _mm256_movemask_epi8(_mm256_or_si256(digit, dot));
+}
+
+AVX2 static inline unsigned avx2_whitespace_mask(__m256i v) {
+  __m256i space = _mm256_or_si256(
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))
+  );
+  __m256i newline = _mm256_or_si256(
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))
+  );
+  return _mm256_movemask_epi8(_mm256_or_si256(space, newline));
+}
+
+// the tail goes through sse2 so there is at most 15 bytes of scalar work
+#define AVX2_SCAN_WHILE(mask_fn) \
+  while (pos + 32 <= size) { \
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos)); \
+    unsigned stop = ~mask_fn(v); \
+    if (stop != 0) return pos + __builtin_ctz(stop); \
+    pos += 32; \
+  }
+
+AVX2 static size_t avx2_identifier(const char * data, size_t pos, size_t size) {
+  AVX2_SCAN_WHILE(avx2_identifier_mask)
+  return sse2_identifier(data, pos, size);
+}
+
+AVX2 static size_t avx2_number(const char * data, size_t pos, size_t size) {
+  AVX2_SCAN_WHILE(avx2_number_mask)
+  return sse2_number(data, pos, size);
+}
+
+AVX2 static size_t avx2_whitespace(const char * data, size_t pos, size_t size) {
+  AVX2_SCAN_WHILE(avx2_whitespace_mask)
+  return sse2_whitespace(data, pos, size);
+}
+
+AVX2 static size_t avx2_until(const char * data, size_t pos, size_t size, char a, char b) {
+  __m256i va = _mm256_set1_epi8(a);
+  __m256i vb = _mm256_set1_epi8(b);
+  while (pos + 32 <= size) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+    unsigned stop = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+    if (stop != 0) return pos + __builtin_ctz(stop);
+    pos += 32;
+  }
+  return sse2_until(data, pos, size, a, b);
+}
+#endif
+
+static ScanKernels select_kernels() {
+#ifdef EASTLANG_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return { "avx2", avx2_identifier, avx2_number, avx2_whitespace, avx2_until };
+  }
+  return { "sse2", sse2_identifier, sse2_number, sse2_whitespace, sse2_until };
+#else
+  return { "scalar", scalar_identifier, scalar_number, scalar_whitespace, scalar_until };
+#endif
+}
+
+static const ScanKernels& kernels() {
+  static const ScanKernels selected = select_kernels();
+  return selected;
+}
+
+size_t scan_identifier(const char * data, size_t pos, size_t size) {
+  // most identifiers are short, don't pay for a vector load when the run is already over
+  if (pos < size && !is_identifier_char(data[pos])) return pos;
+  return kernels().identifier(data, pos, size);
+}
+
+size_t scan_number(const char * data, size_t pos, size_t size) {
+  if (pos < size && !is_number_char(data[pos])) return pos;
+  return kernels().number(data, pos, size);
+}
+
+size_t scan_whitespace(const char * data, size_t pos, size_t size) {
+  if (pos < size && !is_whitespace_char(data[pos])) return pos;
+  return kernels().whitespace(data, pos, size);
+}
+
+size_t scan_until(const char * data, size_t pos, size_t size, char a, char b) {
+  return kernels().until(data, pos, size, a, b);
+}
+
+const char * scan_kernel_name() {
+  return kernels().name;
+}
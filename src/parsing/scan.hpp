@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+/*
+Scanning kernels for the lexer's inner loops. Every kernel starts at `pos` and returns the
+index of the first byte that ends the run (or `size` when the buffer runs out).
+
+They look at 16 (SSE2) or 32 (AVX2) bytes per step on x86-64, picked at runtime from what
+the cpu supports, everything else uses the scalar versions.
+*/
+
+// [A-Za-z0-9_]*
+size_t scan_identifier(const char * data, size_t pos, size_t size);
+
+// [0-9.]*
+size_t scan_number(const char * data, size_t pos, size_t size);
+
+// spaces, tabs and newlines
+size_t scan_whitespace(const char * data, size_t pos, size_t size);
+
+// stops on the first `a` or `b` (string bodies stop on the quote or a backslash)
+size_t scan_until(const char * data, size_t pos, size_t size, char a, char b);
+
+// name of the kernel set in use: "avx2", "sse2" or "scalar"
+const char * scan_kernel_name();
@@ -0,0 +1,52 @@
+#include "symbols.hpp"
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+
+// modules get parsed on worker threads too, so every access goes through the mutex
+class SymbolTable {
+  public:
+    std::mutex lock;
+    // a deque never moves its elements, so the views used as keys stay valid
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, Symbol> ids;
+
+    SymbolTable() {
+      // same order as BuiltinSymbol
+      for (auto name : {
+        "empty", "true", "false", "break", "continue", "argv",
+        "@name", "@path", "import", "include", "name", "path", "range",
+      }) {
+        add(name);
+      }
+    }
+
+    Symbol add(std::string_view name) {
+      Symbol symbol = static_cast<Symbol>(names.size());
+      names.emplace_back(name);
+      ids.emplace(names.back(), symbol);
+      return symbol;
+    }
+};
+
+static SymbolTable& table() {
+  static SymbolTable symbols;
+  return symbols;
+}
+
+Symbol intern(std::string_view name) {
+  SymbolTable& symbols = table();
+  std::lock_guard<std::mutex> guard(symbols.lock);
+
+  auto itt = symbols.ids.find(name);
+  if (itt != symbols.ids.end()) {
+    return itt->second;
+  }
+  return symbols.add(name);
+}
+
+const std::string& symbol_name(Symbol symbol) {
+  SymbolTable& symbols = table();
+  std::lock_guard<std::mutex> guard(symbols.lock);
+  return symbols.names[symbol];
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Every name is interned once into a global table, past the lexer names are
+// compared and hashed as plain integers
+using Symbol = uint32_t;
+
+// names the interpreter asks for directly, interned first so their ids are known up front
+enum BuiltinSymbol : Symbol {
+  SYM_EMPTY,
+  SYM_TRUE,
+  SYM_FALSE,
+  SYM_BREAK,
+  SYM_CONTINUE,
+  SYM_ARGV,
+  SYM_AT_NAME, // @name
+  SYM_AT_PATH, // @path
+  SYM_IMPORT,
+  SYM_INCLUDE,
+  SYM_NAME,
+  SYM_PATH,
+  SYM_RANGE, // for i in range(...)
+};
+
+// both are safe to call from any thread
+Symbol intern(std::string_view name);
+
+const std::string& symbol_name(Symbol symbol);
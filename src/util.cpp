@@ -1,9 +1,19 @@
 #include "util.hpp"
 
-#include <sstream>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <random>
+
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
 
 std::string pwd() {
   std::filesystem::path cwd = std::filesystem::current_path();
@@ -17,18 +27,66 @@ std::string path_of_file(const std::string& fname) {
          : fname.substr(0, pos);
 }
 
-std::string read_file(const char * path) {
-  std::ifstream file(path);
-  if (!file) {
-    std::cerr << "Could not open file " << path << "\n";
-    std::exit(1);
+std::string temp_path_for(const std::string& path) {
+#ifdef _WIN32
+  unsigned long pid = static_cast<unsigned long>(_getpid());
+#else
+  unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+  std::random_device random;
+  char suffix[48];
+  std::snprintf(suffix, sizeof(suffix), ".%lu-%08x.tmp", pid, static_cast<unsigned>(random()));
+  return path + suffix;
+}
+
+bool MappedFile::open(const char * path) {
+#ifndef _WIN32
+  int fd = ::open(path, O_RDONLY);
+  if (fd == -1) return false;
+  struct stat info;
+  if (fstat(fd, &info) == 0) {
+    if (!S_ISREG(info.st_mode)) {
+      close(fd);
+      return false;
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size == 0) { // mmap doesn't take empty files
+      close(fd);
+      return true;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      close(fd);
+      data = static_cast<const char *>(addr);
+      mapped = true;
+      return true;
+    }
   }
+  close(fd);
+#endif
+  // no mmap, read the file straight into one buffer
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file || file.tellg() < 0) return false;
 
-  std::ostringstream buffer;
-  buffer << file.rdbuf();
+  fallback.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  if (!file.read(fallback.data(), fallback.size())) return false;
 
-  std::string fileContent = buffer.str();
-  return fileContent;
+  data = fallback.data();
+  size = fallback.size();
+  return true;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (mapped) {
+    munmap(const_cast<char *>(data), size);
+  }
+#endif
+}
+
+std::string_view MappedFile::view() const {
+  return std::string_view(data, size);
 }
 
 void print_token_type(TokenType tk) {
@@ -90,6 +148,15 @@ void print_token_type(TokenType tk) {
     case TokenType::While:
       std::cout << "While Token\n";
       break;
+    case TokenType::For:
+      std::cout << "For Token\n";
+      break;
+    case TokenType::In:
+      std::cout << "In Token\n";
+      break;
+    case TokenType::Match:
+      std::cout << "Match Token\n";
+      break;
     case TokenType::BitwiseShift:
       std::cout << "BitwiseShift Token\n";
       break;
@@ -148,6 +215,21 @@ void print_node_type(NodeType node) {
     case NodeType::WhileStatement:
       std::cout << "WhileStmt node\n";
       break;
+    case NodeType::ForStatement:
+      std::cout << "ForStmt node\n";
+      break;
+    case NodeType::BlockExpr:
+      std::cout << "Block node\n";
+      break;
+    case NodeType::BooleanLiteral:
+      std::cout << "Boolean node\n";
+      break;
+    case NodeType::InvariantExpr:
+      std::cout << "Invariant node\n";
+      break;
+    case NodeType::MatchExpr:
+      std::cout << "Match node\n";
+      break;
     case NodeType::ArrayLiteral:
       std::cout << "Array node\n";
       break;
@@ -1,14 +1,38 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include "parsing/lexer.hpp"
 #include "parsing/ast.hpp"
 
 std::string pwd();
 
-std::string read_file(const char * path);
+// Read-only view of a whole file. Memory-mapped where the platform allows it,
+// otherwise read into a single buffer. The view dies with the object.
+// Opening never exits, whoever opens decides whether it's an error (raise_error).
+class MappedFile {
+  private:
+    const char * data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string fallback;
+
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file can't be opened or read, open it only once
+    bool open(const char * path);
+    std::string_view view() const;
+};
 
 std::string path_of_file(const std::string& fname);
 
+// a name next to `path` nobody else writes to, for writing a file to the side and renaming it
+// into place. Two processes writing the same file each get their own
+std::string temp_path_for(const std::string& path);
+
 void print_token_type(TokenType tk);
 
 void print_node_type(NodeType node);
\ No newline at end of file
@@ -0,0 +1,51 @@
+x = 10
+y = 3
+print(x + y, x - y, x * y, x / y, x % y)
+print(1 << 4, 256 >> 2)
+print(1 == 1, 1 != 2, 1 <= 2, 3 > 4, "a" == "a", "a" != "b")
+print(1 and 0, 1 or 0, 1 xor 0, not 1 or 0, ! 1 or 0)
+print("hello \n World!", "t\tab", "\x41\102")
+s = "abc" + "def"
+print(s, s[2])
+const add = callable(a, b) { a + b }
+print(add(5, 4))
+fact = callable(n) { if n <= 1 { 1 } else { n * fact(n - 1) } }
+print(fact(10))
+fib = callable(n) { if n < 2 { n } else_if n == 2 { 1 } else { fib(n - 1) + fib(n - 2) } }
+print(fib(20))
+i = 0
+total = 0
+while i < 100 { total = total + i i = i + 1 }
+print(total, i)
+j = 0
+while true { j = j + 1 if j == 5 { continue } if j > 8 { break } print(j) }
+arr = [1, 2, 3, [4, 5]]
+arr[1] = 20
+print(arr, arr[3][1])
+const array = @import("<array>")
+array.append(arr, 9, 10)
+print(array.len(arr), array.pop(arr), arr)
+const regex = @import("<regex>")
+p = regex.compile("a(b+)c")
+print(regex.match(p, "xxabbbcyy"), regex.replace("b+", "abbbc", "X"))
+print(type(1), type("s"), type(arr), type(add), type(print), type(empty), type(true), type(array))
+x = 5
+if true { local x = 15 print(x) }
+print(x)
+cnt = callable() { c = 0 c = c + 1 c }
+print(cnt(), cnt())
+mk = callable(n) { callable(m) { n + m } }
+print(mk(3)(4))
+`comment here with stuff 1 + 2 `
+print(@name, @name())
+print(2 * 3 + 4 * 5 - 6 / 2, (2 + 3) * 4, 10 - 3 - 2, 2 * 3 % 4)
+print(1 < 2 and 3 < 4, not true, not 0, not empty)
+q = if 1 > 2 { "a" } else_if 2 > 1 { "b" }
+print(q)
+w = while false { 1 }
+print(w)
+print(3.25 * 2)
+k = 0
+z = while k < 3 { k = k + 1 }
+print(z)
+print(ord("A"), chr(66))
@@ -0,0 +1,17 @@
+xs = [1, 2, 3]
+s = "abc"
+print(xs[0], xs[2], s[0], s[2])
+i = 0
+while i < 3 {
+  xs[i] = xs[i] * 10
+  i = i + 1
+}
+print(xs[0], xs[1], xs[2])
+set = callable() {
+  i = 2
+  7
+}
+i = 0
+xs[i] = set()
+print(xs[0], xs[1], xs[2], i)
+print(s[3])
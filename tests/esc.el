@@ -0,0 +1,6 @@
+print("a\"b", 'c\'d', "e\\f", "g\qh", "\101\x42", "tab\there")
+print("", '')
+print("x" + 'y')
+x1_y = 4
+print(x1_y)
+print(1.5 + 2.25)
@@ -0,0 +1,40 @@
+print(1 + 2 * 3, 10 % 4, 7 / 2, "a" + "b", "a" - "b", "x" * "y")
+print(1 < 2, 2 <= 1, 3 == 3, "a" == "a", "a" != "b", 1 == "1", 1 != "1")
+print(1 < 2 and 2 < 3, 1 > 2 or 0, 1 xor 1, "" or 0, not 0, not "s", not (1 == 2))
+print(1 << 4, 256 >> 2, "hello"[1])
+if 1 == 2 {
+  print("no")
+} else_if 2 == 2 {
+  print("yes")
+} else {
+  print("no2")
+}
+if 1 > 2 {
+  print("no")
+} else_if 1 > 3 {
+  print("no")
+}
+x = 5
+if 2 > 1 {
+  local x = 7
+  print(x)
+}
+print(x)
+if x == 5 {
+  print("x5")
+} else_if 1 == 2 {
+  print("never")
+} else_if 3 == 3 {
+  print("always")
+} else {
+  print("dead")
+}
+while 1 > 2 { print("loop") }
+f = callable(a) { 1 2 3 a * (2 + 3) }
+print(f(2))
+i = 0
+r = while i < 3 { i = i + 1 5 if i == 2 { continue } i }
+print(r)
+print(if 1 == 1 { "block" })
+y = if 1 == 2 { 1 }
+print(y)
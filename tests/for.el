@@ -0,0 +1,37 @@
+array = @import("<array>")
+arr2 = [0]
+for i in range(5) {
+  print(i)
+}
+for i in range(2, 4) { print(i) }
+for i in range(10, 0, 0 - 3) { print(i) }
+for i in range(0, 1, 0.25) { print(i) }
+for x in [1, "a", true] { print(x) }
+s = 0
+for i in range(100) {
+  if (i == 50) { break }
+  if (i % 2 == 0) { continue }
+  s = s + i
+}
+print(s)
+fs = []
+for i in range(3) { i = i * 10
+  array.append(fs, callable(){ i }) }
+for f in fs { print(f()) }
+for x in arr2 { if (x < 5) { array.append(arr2, x + 10) } }
+print(arr2)
+for i in range(3) { array.append(arr2, i) }
+arr = [1,2,3]
+for x in arr { if (x < 4) { arr = arr } print(x) }
+n = 0
+while (n < 3) {
+  for j in range(n) { print(n * 10 + j) }
+  n = n + 1
+}
+range = 4
+print(range)
+i = "outer"
+for i in range(2) {}
+print(i)
+r = for k in range(3) { k * 2 }
+print(r)
@@ -0,0 +1,4 @@
+m = @import("mod.el", 1, "two")
+print(m.helper(21), m.value)
+inc = @include("mod.el")
+print(inc.value)
@@ -0,0 +1,16 @@
+const double = callable(v) { v * 2 }
+const pick = callable(a, b) { if a > b { a } else { b } }
+const greet = callable(name) { "hi " + name }
+const self = callable(n) { if n == 0 { 0 } else { self(n - 1) + 1 } }
+const side = callable(v) { print("side", v) v }
+x = 7
+print(double(x), double(double(3)), pick(3, 9), pick(x, 2), greet("you"))
+print(self(5))
+print(double(side(4)), pick(side(1), side(2)))
+v = 1
+const shadow = callable(a) { v = a + 1 v }
+print(shadow(10), v)
+i = 0
+s = 0
+while i < 50 { s = s + double(i) i = i + 1 }
+print(s)
@@ -0,0 +1,37 @@
+const array = @import("<array>")
+xs = [1, 2, 3]
+i = 0
+total = 0
+while i < 6 {
+  total = total + array.len(xs) * 10
+  if i == 2 { array.append(xs, 4) }
+  i = i + 1
+}
+print(total, xs)
+k = 5
+i = 0
+s = 0
+while i < 4 {
+  s = s + k * 2 + 1
+  if i == 1 { k = 50 }
+  i = i + 1
+}
+print(s)
+bump = callable() { k = k + 1 }
+i = 0
+s = 0
+while i < 3 {
+  s = s + (k + 1) * 2
+  bump()
+  i = i + 1
+}
+print(s, k)
+ys = [1, 2]
+i = 0
+s = 0
+while i < 3 {
+  s = s + ys[0] * 100
+  ys[0] = ys[0] + 1
+  i = i + 1
+}
+print(s, ys)
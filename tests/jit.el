@@ -0,0 +1,89 @@
+const array = @import("<array>")
+m = @import("mod.el")
+
+jloop = callable(n) {
+  i = 0
+  total = 0
+  s = ""
+  while i < n {
+    i = i + 1
+    if i % 3 == 0 { continue }
+    if i > 40 { break }
+    total = total + i * 2 - 1 / 2
+    s = s + "x"
+  }
+  result = [total, s, i]
+  result
+}
+
+jmix = callable(a, b) {
+  c = a + b
+  d = a == b
+  ne = a != b
+  f = not d
+  g = a < 5
+  result = [c, d, ne, f, g, 1 << 3, 256 >> 2, 7 % 4, true and false, a - 1 >= 0, a <= 2]
+  result
+}
+
+jstr = callable(a, b) {
+  result = [a + b, a == b, a != b, a + 1]
+  result
+}
+
+jcounter = callable() {
+  n = 0
+  callable() {
+    n = n + 1
+    n
+  }
+}
+
+jstore = callable(xs, k) {
+  xs[k] = k * 10
+  xs
+}
+
+jkinds = callable(v) {
+  match v {
+    1 { "one" }
+    "s" { "ess" }
+    else { "other" }
+  }
+}
+
+jinv = callable(xs) {
+  j = 0
+  acc = 0
+  while j < 5 {
+    acc = acc + array.len(xs) * 2
+    j = j + 1
+  }
+  acc
+}
+
+jnan = callable(x) {
+  y = x / x
+  result = [y == y, y != y, y < 1, y >= 1]
+  result
+}
+
+k = 0
+while k < 30 {
+  r1 = jloop(k * 2)
+  r2 = jmix(k, 3)
+  r3 = jstr("a", "b")
+  cnt = jcounter()
+  cnt()
+  r4 = cnt()
+  r5 = jstore([1, 2, 3, 4], k % 4)
+  r6 = jkinds(k % 3)
+  r7 = jkinds("s")
+  r8 = jinv([1, 2, k])
+  r9 = jnan(0)
+  r10 = m.helper(k)
+  if k % 10 == 0 {
+    print(r1, r2, r3, r4, r5, r6, r7, r8, r9, r10)
+  }
+  k = k + 1
+}
@@ -0,0 +1,36 @@
+const regex = @import("<regex>")
+describe = callable(v) {
+  match v {
+    0 { "zero" }
+    1, 2, 3 { "small" }
+    -1 { "minus one" }
+    2.5 { "two and a half" }
+    1000000 { "million" }
+    "hi", "hello" { "greeting" }
+    "a\tb" { "tab" }
+    [] { "empty array" }
+    [x] { "one: " + type(x) }
+    [0, y] { "starts with zero" }
+    [x, [a, b]] { "nested" }
+    [x, y] { "pair" }
+    else { "other" }
+  }
+}
+print(describe(0), describe(2), describe(0 - 1), describe(2.5), describe(1000000), describe(7))
+print(describe("hi"), describe("hello"), describe("a\tb"), describe("nope"))
+print(describe([]), describe([5]), describe([0, 1]), describe([1, [2, 3]]), describe([1, 2]), describe([1, 2, 3]))
+print(describe(true), describe(describe))
+pick = callable(v) { match v { [a, b] { a + b } [a, b, c] { a * b * c } } }
+print(pick([2, 3]), pick([2, 3, 4]), pick(9))
+i = 0
+s = 0
+while i < 40 {
+  s = s + match i % 8 { 0 { 1 } 1 { 2 } 2 { 3 } 3 { 4 } 4 { 5 } 5 { 6 } 6 { 7 } else { 100 } }
+  i = i + 1
+}
+print(s)
+print(regex.match("a+", "caab"))
+r = match 5 { 5 { q = 1 q + 1 } }
+print(r)
+sparse = callable(v) { match v { 1 { "one" } 1000 { "thousand" } 1 { "never" } } }
+print(sparse(1), sparse(1000), sparse(2))
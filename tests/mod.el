@@ -0,0 +1,3 @@
+helper = callable(x) { x * 2 }
+print("module loaded", @name, argv)
+const value = 42
@@ -0,0 +1,22 @@
+i = 0
+total = 0
+s = ""
+while i < 5000 {
+  total = total + i % 7
+  if i % 1000 == 0 { s = s + "k" }
+  i = i + 1
+}
+print(total, s, i)
+f = callable(n) {
+  j = 0
+  acc = []
+  while j < n {
+    if j % 1500 == 0 { acc = [acc, j] }
+    j = j + 1
+  }
+  acc
+}
+print(f(4000))
+w = 0
+r = while w < 3000 { w = w + 1 if w == 2500 { break } w }
+print(r, w)
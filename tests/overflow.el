@@ -0,0 +1,7 @@
+deeper = callable(k, n) {
+  if k == 0 { @include("overflow_step.el") } else { deeper(k - 1, n) + 0 }
+}
+f = callable(n) { deeper(50, n) }
+print("start")
+f(1000000)
+print("never")
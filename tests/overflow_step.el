@@ -0,0 +1 @@
+f(n - 1)
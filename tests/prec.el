@@ -0,0 +1,7 @@
+print(1 + 2 << 1, 8 >> 1 + 1, 1 < 2 == true, 2 * 3 + 1 < 8 and 1 or 0)
+print(10 - 2 - 3, 100 / 10 / 5, 7 % 4 * 2, 1 + 2 * 3 << 1 >> 2)
+print(not 1 == 2 and 3, 1 xor 1 xor 1, (1 + 2) * (3 + 4))
+a = [1, 2, 3]
+print(a[0] + a[1] * a[2])
+f = callable(x) { callable(y) { x * y } }
+print(f(3)(4) + 1)
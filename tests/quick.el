@@ -0,0 +1,15 @@
+add = callable(a, b) { a + b }
+eq = callable(a, b) { a == b }
+lt = callable(a, b) { a < b }
+i = 0
+while i < 12 {
+  print(add(i, 1))
+  print(add("x", "y"))
+  print(eq(i, 3))
+  print(eq("a", "a"))
+  print(eq(true, false))
+  print(add(i, "s"))
+  print(lt(i, 5))
+  print(1 << i)
+  i = i + 1
+}
@@ -0,0 +1,37 @@
+# Runs one script from tests/ and compares what it prints with its .out file, registered by
+# CMakeLists.txt once for every execution mode:
+#   cmake -DEAST=<interpreter> -DDIR=<tests dir> -DNAME=<script without .el> -DFLAGS=<options> -DCACHE_DIR=<dir> -P run_test.cmake
+# The script runs twice, the second run loads what the first one wrote to the .eastc cache.
+# A script may end with an error (exit code 1), its message is part of the .out.
+# Options a script needs in every mode go in <name>.flags next to it
+
+set(ENV{EASTLANG_CACHE_DIR} "${CACHE_DIR}")
+file(REMOVE_RECURSE "${CACHE_DIR}")
+file(MAKE_DIRECTORY "${CACHE_DIR}")
+
+file(READ "${DIR}/${NAME}.out" expected)
+string(REPLACE "\r" "" expected "${expected}")
+
+if(EXISTS "${DIR}/${NAME}.flags")
+  file(READ "${DIR}/${NAME}.flags" scriptFlags)
+  separate_arguments(scriptFlags)
+  list(APPEND FLAGS ${scriptFlags})
+endif()
+
+foreach(run parsed cached)
+  # relative to the tests, argv and @name show the path the way it was given
+  execute_process(
+    COMMAND "${EAST}" ${FLAGS} "${NAME}.el"
+    WORKING_DIRECTORY "${DIR}"
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result
+  )
+  string(REPLACE "\r" "" output "${output}${errors}")
+  if(NOT result EQUAL 0 AND NOT result EQUAL 1)
+    message(FATAL_ERROR "${NAME}.el (${run}) exited with ${result}\n${output}")
+  endif()
+  if(NOT output STREQUAL expected)
+    message(FATAL_ERROR "${NAME}.el (${run}) printed\n${output}\ninstead of\n${expected}")
+  endif()
+endforeach()
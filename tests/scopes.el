@@ -0,0 +1,21 @@
+x = 1
+f = callable() { x = x + 1 x }
+print(f(), f(), x)
+g = callable() { local x = 100 x = x + 1 x }
+print(g(), x)
+if true { local y = 5 x = x + y }
+print(x)
+outer = callable(a) {
+  inner = callable(b) { a + b + x }
+  a = a * 10
+  inner(1)
+}
+print(outer(2))
+n = 0
+while n < 3 { local m = n n = n + 1 }
+print(n)
+later = callable() { z }
+z = "defined after"
+print(later())
+h = callable(p, p2) { p = p + p2 q = p q }
+print(h(1, 2), h("a", "b"))
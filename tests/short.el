@@ -0,0 +1,36 @@
+calls = 0
+side = callable(v) {
+  calls = calls + 1
+  v
+}
+xs = [1, 2, 0, 4]
+n = 4
+i = 0
+while i < n and xs[i] != 0 {
+  i = i + 1
+}
+print(i)
+print(false and side(true), true or side(false), true and side(true), false or side(5))
+print(calls)
+if 1 and "x" { print("truthy") }
+if (not 1 > 2) { print("not cmp") }
+if (not 0) { print("not zero") }
+if i > 10 or side(true) { print("or right") }
+if i < 10 xor i < 5 { print("xor") }
+k = 0
+while (not k >= 3) or false { k = k + 1 }
+print(k)
+print(calls)
+g = callable(a, b) { a and b }
+print(g(false, side(true)))
+print(calls)
+s = "ab"
+if s == "ab" and s != "cd" { print("strings") }
+r = 0
+while r < 2000 {
+  if (r % 3 == 0 or r % 5 == 0) and (r <= 1500 or (not side(true))) { calls = calls + 1 }
+  r = r + 1
+}
+print(calls)
+h = callable(x) { x > 2 and x < 8 or x == 20 }
+print(h(1), h(5), h(20), h(9))
@@ -0,0 +1,42 @@
+sum = callable(n, acc) { if n == 0 { acc } else { sum(n - 1, acc + n) } }
+print(sum(1000000, 0))
+
+count = callable(n) {
+  if n == 0 {
+    "done"
+  } else_if n % 2 == 0 {
+    x = n - 1
+    count(x)
+  } else {
+    count(n - 1)
+  }
+}
+print(count(500000))
+
+even = callable(n) { if n == 0 { true } else { odd(n - 1) } }
+odd = callable(n) { if n == 0 { false } else { even(n - 1) } }
+print(even(300001))
+print(odd(300001))
+
+blocky = callable(n) { if true { if n > 0 { blocky(n - 1) } else { n } } }
+print(blocky(200000))
+
+adder = callable(n, k) {
+  f = callable(x) { x + k }
+  if n == 0 { f(0) } else { adder(n - 1, k + 1) }
+}
+print(adder(3000, 0))
+
+const array = @import("<array>")
+xs = [1, 2, 3]
+lenOf = callable(a) { array.len(a) }
+print(lenOf(xs))
+last = callable(n) { if n > 0 { last(n - 1) } else { print("bottom") } }
+last(10)
+notail = callable(n) { if n == 0 { 0 } else { 1 + notail(n - 1) } }
+print(notail(1000))
+keep = callable(n) {
+  g = 5
+  if n == 0 { g } else { keep(n - 1) }
+}
+print(keep(100000))
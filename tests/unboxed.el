@@ -0,0 +1,59 @@
+x = 1
+x = x + 1
+y = x
+arr = [x, 0]
+f = callable() { x }
+x = x + 10
+x = x * 2
+print(y)
+print(arr[0])
+print(f())
+print(x)
+z = 5
+g = callable() { z = z + 100 }
+w = z + g()
+print(w)
+z = z + 1
+print(z)
+k = 0
+s = 0
+while k < 10 {
+  k = k + 1
+  if k == 3 { continue }
+  s = s + k
+  if s > 30 { break }
+}
+print(k)
+print(s)
+q = 1
+q = "a"
+q = q + "b"
+print(q)
+m = 2
+m = m << 3
+print(m)
+a = [1, 2, 3]
+i = 0
+t = 0
+while i < 3 {
+  t = t + a[i]
+  i = i + 1
+}
+print(t)
+c = 3
+c = c + c
+print(c)
+h = callable(n) { r = 0 r = r + n r }
+print(h(4))
+print(h(5))
+f = callable(n) {
+  total = 0
+  i = 0
+  while i < n {
+    total = total + i * 2
+    i = i + 1
+  }
+  total
+}
+print(f(300000))
+print(f(10))
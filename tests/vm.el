@@ -0,0 +1,62 @@
+const array = @import("<array>")
+i = 0
+total = 0
+while i < 10 {
+  i = i + 1
+  if i % 2 == 0 { continue }
+  if i > 7 { break }
+  total = total + i
+}
+print("total", total, i)
+
+counter = callable() {
+  n = 0
+  callable() {
+    n = n + 1
+    n
+  }
+}
+c = counter()
+c()
+c()
+print("counter", c())
+
+fib = callable(n) {
+  if n < 2 { n } else { fib(n - 1) + fib(n - 2) }
+}
+print("fib", fib(20))
+
+xs = [1, 2, 3]
+xs[1] = 20
+print(xs, xs[1], "abc"[1])
+
+w = 0
+r = while w < 3 { w = w + 1 w * 10 }
+print("while value", r)
+
+s = "a"
+j = 0
+while j < 3 {
+  local k = j
+  s = s + "b"
+  j = j + 1
+}
+print(s, j)
+
+find = callable(arr, x) {
+  idx = 0
+  found = 0 - 1
+  while idx < array.len(arr) {
+    if arr[idx] == x { found = idx break }
+    idx = idx + 1
+  }
+  found
+}
+print("find", find([5, 6, 7], 7), find([5, 6, 7], 9))
+
+if 1 > 0 { inner = 5 print("block", inner + 1) }
+print(1 << 4, 256 >> 2, !0, !true, "x" + "y", 1 - "a")
+m = match 3 { 1 { "one" } 3 { "three" } else { "other" } }
+print(m)
+q = 0
+while (q = q + 1) < 4 { print("q", q) }